@@ -1,9 +1,28 @@
 #include "src/MicroCore.h"
 #include "src/CmdLineOptions.h"
 #include "src/tools.h"
+#include "src/SyntheticChain.h"
+#include "src/ChainFollower.h"
+#include "src/QueryServer.h"
+#include "src/BatchChecker.h"
+#include "src/WalletReport.h"
+#include "src/ChainVisitors.h"
+#include "src/ScanCoordinator.h"
+#include "src/PaymentIdIndex.h"
+#include "src/RingMemberIndex.h"
+#include "src/ChainReaction.h"
+#include "src/RingVerifier.h"
+#include "src/OwnSpends.h"
 
 #include "ext/format.h"
 
+#include <boost/algorithm/string.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+
 using namespace std;
 using namespace fmt;
 
@@ -19,15 +38,14 @@ namespace epee {
 }
 
 
-struct for_signatures
-{
-    crypto::hash tx_hash ;
-    crypto::key_image kimg ;
-    std::vector<crypto::public_key> outs_pub_keys;
-    cryptonote::keypair in_ephemeral;
-    size_t real_output {0};
-};
+// set on ctrl+c to finish follow or serve mode
+std::atomic<bool> stop_requested {false};
 
+void
+on_sigint(int)
+{
+    stop_requested = true;
+}
 
 
 
@@ -52,6 +70,42 @@ int main(int ac, const char* av[]) {
     auto bc_path_opt = opts.get_option<string>("bc-path");
     bool testnet     = *(opts.get_option<bool>("testnet"));
     bool find_tx     = *(opts.get_option<bool>("find-tx"));
+    size_t prefetch_window = *(opts.get_option<size_t>("prefetch-window"));
+    size_t synthetic_blocks = *(opts.get_option<size_t>("synthetic-blocks"));
+    size_t synthetic_seed   = *(opts.get_option<size_t>("synthetic-seed"));
+    bool synthetic_signatures = *(opts.get_option<bool>("synthetic-signatures"));
+    auto sidecar_path_opt   = opts.get_option<string>("sidecar-path");
+    bool build_sidecar      = *(opts.get_option<bool>("build-sidecar"));
+    auto block_summary_opt  = opts.get_option<string>("block-summary-path");
+    bool build_block_summary = *(opts.get_option<bool>("build-block-summary"));
+    bool follow             = *(opts.get_option<bool>("follow"));
+    bool serve              = *(opts.get_option<bool>("serve"));
+    string socket_path      = *(opts.get_option<string>("socket-path"));
+    size_t serve_threads    = *(opts.get_option<size_t>("serve-threads"));
+    size_t search_timeout   = *(opts.get_option<size_t>("search-timeout"));
+    auto batch_opt          = opts.get_option<string>("batch");
+    bool report             = *(opts.get_option<bool>("report"));
+    bool chain_stats        = *(opts.get_option<bool>("chain-stats"));
+    bool chain_reaction     = *(opts.get_option<bool>("chain-reaction"));
+    bool verify             = *(opts.get_option<bool>("verify"));
+    size_t from_height      = *(opts.get_option<size_t>("from-height"));
+    size_t to_height        = *(opts.get_option<size_t>("to-height"));
+    auto wallets_opt        = opts.get_option<string>("wallets");
+    auto worker_unit_opt    = opts.get_option<string>("worker-unit");
+    auto unit_output_opt    = opts.get_option<string>("unit-output");
+    size_t no_of_workers    = *(opts.get_option<size_t>("workers"));
+    auto worker_hosts_opt   = opts.get_option<string>("worker-hosts");
+    string work_dir         = *(opts.get_option<string>("work-dir"));
+    size_t unit_blocks      = *(opts.get_option<size_t>("unit-blocks"));
+    auto payment_id_index_opt = opts.get_option<string>("payment-id-index");
+    bool build_payment_id_index = *(opts.get_option<bool>("build-payment-id-index"));
+    auto payment_ids_opt    = opts.get_option<string>("payment-ids");
+    auto output_key_index_opt = opts.get_option<string>("output-key-index");
+    bool build_output_key_index = *(opts.get_option<bool>("build-output-key-index"));
+    auto output_keys_opt    = opts.get_option<string>("output-keys");
+    auto ring_member_index_opt = opts.get_option<string>("ring-member-index");
+    bool build_ring_member_index = *(opts.get_option<bool>("build-ring-member-index"));
+    auto ring_uses_opt      = opts.get_option<string>("ring-uses");
 
     // get the program command line options, or
     // some default values for quick check
@@ -109,33 +163,584 @@ int main(int ac, const char* av[]) {
         return 1;
     }
 
-    path blockchain_path;
+    // enable basic monero log output
+    xmreg::enable_monero_log();
+
+    // create instance of our MicroCore
+    xmreg::MicroCore mcore;
+
+    // options for worker processes to open the same blockchain
+    vector<string> worker_args;
 
-    if (!xmreg::get_blockchain_path(bc_path_opt, blockchain_path))
+    if (testnet)
     {
-        // if problem obtaining blockchain path, finish.
-        return 1;
+        worker_args.push_back("--testnet");
     }
 
-    print("Blockchain path      : {}\n", blockchain_path);
+    if (synthetic_blocks > 0)
+    {
+        worker_args.push_back("--synthetic-blocks");
+        worker_args.push_back(std::to_string(synthetic_blocks));
+        worker_args.push_back("--synthetic-seed");
+        worker_args.push_back(std::to_string(synthetic_seed));
 
-    // enable basic monero log output
-    xmreg::enable_monero_log();
+        // use synthetic blockchain kept in memory instead of the
+        // lmdb one, together with its test wallet and the first tx
+        // with an output to it.
+        xmreg::synthetic_chain_config chain_cfg;
 
-    // create instance of our MicroCore
-    xmreg::MicroCore mcore;
+        chain_cfg.no_of_blocks = synthetic_blocks;
+        chain_cfg.seed         = synthetic_seed;
+
+        // random signature bytes would fail verify and the
+        // own spend check of find-tx. real ones have random
+        // nonces, so workers, which make their own chain,
+        // dont get this option.
+        chain_cfg.valid_signatures = synthetic_signatures || verify || find_tx;
+
+        xmreg::synthetic_chain chain;
+
+        xmreg::MemoryBlockchainDB* memory_db = new xmreg::MemoryBlockchainDB();
+
+        memory_db->open("");
+
+        print("Generating synthetic blockchain of {} blocks ...\n", synthetic_blocks);
+
+        if (!xmreg::generate_synthetic_chain(chain_cfg, *memory_db, chain)
+            || chain.wallet_outputs.empty())
+        {
+            cerr << "Cant generate synthetic blockchain with test wallet outputs" << endl;
+            delete memory_db;
+            return 1;
+        }
+
+        // mcore takes ownership of memory_db
+        if (!mcore.init(memory_db))
+        {
+            cerr << "Error accessing blockchain." << endl;
+            return 1;
+        }
 
-    // initialize the core using the blockchain path
-    if (!mcore.init(blockchain_path.string()))
+        tx_hash           = chain.wallet_outputs.front().tx_hash;
+        private_view_key  = chain.wallet.m_view_secret_key;
+        private_spend_key = chain.wallet.m_spend_secret_key;
+        address           = chain.wallet.m_account_address;
+    }
+    else
     {
-        cerr << "Error accessing blockchain." << endl;
-        return 1;
+        path blockchain_path;
+
+        if (!xmreg::get_blockchain_path(bc_path_opt, blockchain_path))
+        {
+            // if problem obtaining blockchain path, finish.
+            return 1;
+        }
+
+        print("Blockchain path      : {}\n", blockchain_path);
+
+        worker_args.push_back("--bc-path");
+        worker_args.push_back(blockchain_path.string());
+
+        // initialize the core using the blockchain path
+        if (!mcore.init(blockchain_path.string()))
+        {
+            cerr << "Error accessing blockchain." << endl;
+            return 1;
+        }
     }
 
+    mcore.set_prefetch_window(prefetch_window);
+
     // get the high level cryptonote::Blockchain object to interact
     // with the blockchain lmdb database
     cryptonote::Blockchain& core_storage = mcore.get_core();
 
+    // scan sidecar, if given, is used to find txs with spent
+    // key images, and our outputs for report, without reading txs
+    xmreg::ScanSidecar sidecar;
+
+    bool use_sidecar {false};
+
+    if (sidecar_path_opt)
+    {
+        if (build_sidecar)
+        {
+            uint64_t chain_height = core_storage.get_current_blockchain_height();
+
+            print("Building scan sidecar up to height {} ...\n", chain_height);
+
+            if (!xmreg::ScanSidecar::build(mcore, *sidecar_path_opt, chain_height, true))
+            {
+                cerr << "Cant build scan sidecar in " << *sidecar_path_opt << endl;
+                return 1;
+            }
+        }
+
+        use_sidecar = sidecar.open(*sidecar_path_opt, mcore);
+
+        if (use_sidecar)
+        {
+            print("Scan sidecar         : {} (height {})\n",
+                  *sidecar_path_opt, sidecar.height());
+        }
+    }
+
+    // block summary, if given, is used to split
+    // parallel scans into parts of equal work
+    if (block_summary_opt)
+    {
+        if (build_block_summary)
+        {
+            uint64_t chain_height = core_storage.get_current_blockchain_height();
+
+            print("Building block summary up to height {} ...\n", chain_height);
+
+            if (!xmreg::BlockSummary::build(mcore, *block_summary_opt, chain_height, true))
+            {
+                cerr << "Cant build block summary in " << *block_summary_opt << endl;
+                return 1;
+            }
+        }
+
+        if (mcore.open_block_summary(*block_summary_opt))
+        {
+            print("Block summary        : {} (height {})\n",
+                  *block_summary_opt, mcore.get_block_summary().height());
+
+            worker_args.push_back("--block-summary-path");
+            worker_args.push_back(boost::filesystem::absolute(*block_summary_opt).string());
+        }
+    }
+
+    // output key index, if given, is used to find
+    // txs of output keys without their height
+    bool use_output_key_index {false};
+
+    if (output_key_index_opt)
+    {
+        if (build_output_key_index)
+        {
+            uint64_t chain_height = core_storage.get_current_blockchain_height();
+
+            print("Building output key index up to height {} ...\n", chain_height);
+
+            if (!xmreg::OutputKeyIndex::build(mcore, *output_key_index_opt,
+                                              chain_height, true))
+            {
+                cerr << "Cant build output key index in " << *output_key_index_opt << endl;
+                return 1;
+            }
+        }
+
+        use_output_key_index = mcore.open_output_key_index(*output_key_index_opt);
+
+        if (use_output_key_index)
+        {
+            print("Output key index     : {} (height {})\n",
+                  *output_key_index_opt, mcore.get_output_key_index().height());
+        }
+    }
+
+    if (serve)
+    {
+        xmreg::QueryServer server {mcore, use_sidecar ? &sidecar : nullptr, serve_threads};
+
+        std::signal(SIGINT, on_sigint);
+
+        print("Serving queries on {} with {} workers (ctrl+c to stop) ...\n",
+              socket_path, serve_threads);
+
+        if (!server.run(socket_path, stop_requested))
+        {
+            return 1;
+        }
+
+        cout << "\nEnd of program." << endl;
+
+        return 0;
+    }
+
+    if (batch_opt)
+    {
+        // keys from command line are used
+        // for lines without their own keys
+        cryptonote::account_keys default_keys {address,
+                                               private_spend_key,
+                                               private_view_key};
+
+        xmreg::BatchChecker checker {mcore, default_keys, testnet};
+
+        bool read_ok;
+
+        if (*batch_opt == "-")
+        {
+            read_ok = checker.read_entries(cin);
+        }
+        else
+        {
+            ifstream batch_file {*batch_opt};
+
+            if (!batch_file)
+            {
+                cerr << "Cant open batch file: " << *batch_opt << endl;
+                return 1;
+            }
+
+            read_ok = checker.read_entries(batch_file);
+        }
+
+        if (!read_ok || !checker.run(cout))
+        {
+            cerr << "Batch check failed" << endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (report)
+    {
+        cryptonote::account_keys wallet_keys {address,
+                                              private_spend_key,
+                                              private_view_key};
+
+        // spending txs are looked for if find-tx is also given
+        xmreg::WalletReport wallet_report {mcore, wallet_keys, find_tx, true,
+                                           use_sidecar ? &sidecar : nullptr};
+
+        vector<xmreg::report_row> rows;
+
+        bool report_ok = wallet_report.run(0, core_storage.get_current_blockchain_height(),
+                                           rows);
+
+        xmreg::WalletReport::print_csv(rows, cout);
+
+        if (!report_ok)
+        {
+            cerr << "Wallet report is not complete" << endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (chain_stats)
+    {
+        // both analyses are done in one pass over the blockchain
+        xmreg::ChainStatsVisitor stats;
+        xmreg::OwnedOutputsVisitor owned {private_view_key,
+                                          address.m_spend_public_key};
+
+        uint64_t chain_height = core_storage.get_current_blockchain_height();
+
+        if (!mcore.visit_chain({&stats, &owned}, 0, chain_height, true).complete)
+        {
+            cerr << "Cant visit blockchain" << endl;
+            return 1;
+        }
+
+        print("blocks           : {}\n", stats.no_of_blocks);
+        print("txs              : {}\n", stats.no_of_txs);
+        print("inputs           : {}\n", stats.no_of_inputs);
+        print("outputs          : {}\n", stats.no_of_outputs);
+        print("tx bytes         : {}\n", stats.tx_bytes);
+        print("our outputs      : {}\n", owned.outputs.size());
+
+        for (const xmreg::owned_output& output: owned.outputs)
+        {
+            print(" - block {}, tx {:s}, output {}, amount {:0.6f}\n",
+                  output.height, output.tx_hash, output.index_in_tx,
+                  output.amount / 1e12);
+        }
+
+        print("scan threads     : {}\n", mcore.get_executor().no_of_threads());
+
+        mcore.get_executor().print_stats(cout);
+
+        return 0;
+    }
+
+    if (chain_reaction)
+    {
+        xmreg::ChainReaction reaction;
+
+        uint64_t chain_height = core_storage.get_current_blockchain_height();
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        if (!reaction.load(mcore, 0, chain_height, true)
+            || !reaction.run(mcore.get_executor())
+            || !reaction.export_csv(mcore, cout))
+        {
+            cerr << "Chain reaction failed" << endl;
+            return 1;
+        }
+
+        double seconds = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start_time).count();
+
+        const xmreg::ChainReaction::reaction_stats& stats = reaction.stats();
+
+        // csv goes to stdout, so summary to stderr
+        cerr << "rings            : " << stats.no_of_rings << "\n"
+             << "ring members     : " << stats.no_of_ring_members << "\n"
+             << "outputs          : " << stats.no_of_outputs << "\n"
+             << "zero mixin rings : " << stats.no_of_zero_mixin << "\n"
+             << "deduced rings    : " << stats.no_of_deduced << "\n"
+             << "rounds           : " << stats.no_of_rounds << "\n"
+             << "conflicts        : " << stats.no_of_conflicts << "\n"
+             << "time             : " << seconds << " s" << endl;
+
+        return 0;
+    }
+
+    if (verify)
+    {
+        uint64_t verify_h1 = to_height > 0
+                             ? to_height
+                             : core_storage.get_current_blockchain_height();
+
+        xmreg::RingVerifier verifier {mcore, true};
+
+        vector<xmreg::verify_failure> failures;
+
+        bool verify_ok = verifier.verify(from_height, verify_h1, failures);
+
+        const xmreg::verify_stats& stats = verifier.stats();
+
+        double seconds = std::max(stats.seconds, 1e-6);
+
+        print("blocks           : {}\n", stats.no_of_blocks);
+        print("txs              : {}\n", stats.no_of_txs);
+        print("inputs           : {}\n", stats.no_of_inputs);
+        print("ring members     : {}\n", stats.no_of_ring_members);
+        print("failures         : {}\n", failures.size());
+        print("time             : {:0.2f} s\n", stats.seconds);
+        print("inputs/s         : {:0.0f}\n", stats.no_of_inputs / seconds);
+        print("ring members/s   : {:0.0f}\n", stats.no_of_ring_members / seconds);
+
+        if (!failures.empty())
+        {
+            xmreg::RingVerifier::print_failures(failures, cout);
+        }
+
+        if (!verify_ok)
+        {
+            cerr << "Verification is not complete" << endl;
+            return 1;
+        }
+
+        return failures.empty() ? 0 : 1;
+    }
+
+    if (wallets_opt)
+    {
+        vector<xmreg::scan_wallet> wallets;
+
+        if (!xmreg::ScanCoordinator::read_wallets(*wallets_opt, testnet, wallets))
+        {
+            return 1;
+        }
+
+        // we are a worker started by a coordinator
+        if (worker_unit_opt)
+        {
+            uint64_t unit_h0, unit_h1;
+
+            if (!xmreg::ScanCoordinator::parse_unit(*worker_unit_opt, unit_h0, unit_h1)
+                || !unit_output_opt)
+            {
+                cerr << "Worker needs unit as h0:h1 and unit-output" << endl;
+                return 1;
+            }
+
+            return xmreg::ScanCoordinator::run_unit(mcore, wallets,
+                                                    unit_h0, unit_h1,
+                                                    *unit_output_opt) ? 0 : 1;
+        }
+
+        vector<string> worker_hosts;
+
+        if (worker_hosts_opt)
+        {
+            boost::split(worker_hosts, *worker_hosts_opt, boost::is_any_of(","),
+                         boost::token_compress_on);
+        }
+
+        // workers on other hosts find the wallets file
+        // at the same path, e.g., in shared work folder
+        worker_args.push_back("--wallets");
+        worker_args.push_back(boost::filesystem::absolute(*wallets_opt).string());
+
+        boost::system::error_code ec;
+
+        path executable = boost::filesystem::read_symlink("/proc/self/exe", ec);
+
+        xmreg::ScanCoordinator coordinator {ec ? string(av[0]) : executable.string(),
+                                            worker_args,
+                                            boost::filesystem::absolute(work_dir).string(),
+                                            no_of_workers,
+                                            worker_hosts,
+                                            wallets};
+
+        if (!coordinator.run(mcore.get_block_summary(),
+                             0, core_storage.get_current_blockchain_height(),
+                             unit_blocks, cout))
+        {
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (payment_id_index_opt)
+    {
+        if (build_payment_id_index)
+        {
+            uint64_t chain_height = core_storage.get_current_blockchain_height();
+
+            print("Building payment id index up to height {} ...\n", chain_height);
+
+            if (!xmreg::PaymentIdIndex::build(mcore, *payment_id_index_opt,
+                                              chain_height, true))
+            {
+                cerr << "Cant build payment id index in " << *payment_id_index_opt << endl;
+                return 1;
+            }
+        }
+
+        if (payment_ids_opt)
+        {
+            xmreg::PaymentIdIndex payment_id_index;
+
+            if (!payment_id_index.open(*payment_id_index_opt, mcore))
+            {
+                return 1;
+            }
+
+            bool query_ok;
+
+            // short payment ids are decrypted with our view key
+            if (*payment_ids_opt == "-")
+            {
+                query_ok = payment_id_index.query_batch(cin, private_view_key, cout);
+            }
+            else
+            {
+                ifstream payment_ids_file {*payment_ids_opt};
+
+                if (!payment_ids_file)
+                {
+                    cerr << "Cant open payment ids file: " << *payment_ids_opt << endl;
+                    return 1;
+                }
+
+                query_ok = payment_id_index.query_batch(payment_ids_file,
+                                                        private_view_key, cout);
+            }
+
+            if (!query_ok)
+            {
+                cerr << "Payment id query failed" << endl;
+                return 1;
+            }
+
+            return 0;
+        }
+    }
+
+    if (output_keys_opt)
+    {
+        if (!use_output_key_index)
+        {
+            cerr << "Output keys need an output-key-index" << endl;
+            return 1;
+        }
+
+        const xmreg::OutputKeyIndex& output_key_index = mcore.get_output_key_index();
+
+        bool query_ok;
+
+        if (*output_keys_opt == "-")
+        {
+            query_ok = output_key_index.query_batch(cin, cout);
+        }
+        else
+        {
+            ifstream output_keys_file {*output_keys_opt};
+
+            if (!output_keys_file)
+            {
+                cerr << "Cant open output keys file: " << *output_keys_opt << endl;
+                return 1;
+            }
+
+            query_ok = output_key_index.query_batch(output_keys_file, cout);
+        }
+
+        if (!query_ok)
+        {
+            cerr << "Output key query failed" << endl;
+            return 1;
+        }
+
+        return 0;
+    }
+
+    if (ring_member_index_opt)
+    {
+        if (build_ring_member_index)
+        {
+            uint64_t chain_height = core_storage.get_current_blockchain_height();
+
+            print("Building ring member index up to height {} ...\n", chain_height);
+
+            if (!xmreg::RingMemberIndex::build(mcore, *ring_member_index_opt,
+                                               chain_height, true))
+            {
+                cerr << "Cant build ring member index in " << *ring_member_index_opt << endl;
+                return 1;
+            }
+        }
+
+        if (ring_uses_opt)
+        {
+            xmreg::RingMemberIndex ring_member_index;
+
+            if (!ring_member_index.open(*ring_member_index_opt, mcore))
+            {
+                return 1;
+            }
+
+            bool query_ok;
+
+            if (*ring_uses_opt == "-")
+            {
+                query_ok = ring_member_index.query_batch(mcore, cin, cout);
+            }
+            else
+            {
+                ifstream ring_uses_file {*ring_uses_opt};
+
+                if (!ring_uses_file)
+                {
+                    cerr << "Cant open outputs file: " << *ring_uses_opt << endl;
+                    return 1;
+                }
+
+                query_ok = ring_member_index.query_batch(mcore, ring_uses_file, cout);
+            }
+
+            if (!query_ok)
+            {
+                cerr << "Ring member query failed" << endl;
+                return 1;
+            }
+
+            return 0;
+        }
+    }
+
     cryptonote::transaction tx;
 
     try
@@ -154,17 +759,17 @@ int main(int ac, const char* av[]) {
                                            private_spend_key,
                                            private_view_key};
 
-    // find block in which the given transaction is located
-    cryptonote::block blk ;
+    // find height of the block in which the given transaction is located
+    uint64_t tx_blk_height;
 
-    if (!mcore.get_block_by_tx_hash(tx_hash, blk))
+    if (!mcore.get_tx_height(tx_hash, tx_blk_height))
     {
         cerr << "Cant find block for the given transaction" << endl;
         return false;
     }
 
     print("\n\ntx hash          : {} in block no. {}\n\n",
-          tx_hash, cryptonote::get_block_height(blk));
+          tx_hash, tx_blk_height);
 
     // lets check our keys
     print("private view key : {}\n", private_view_key);
@@ -186,10 +791,13 @@ int main(int ac, const char* av[]) {
     print("money received   : {:0.6f}\n\n\n", money_transfered / 1e12);
 
     // get tx public key from extras field
-    crypto::public_key pub_tx_key = cryptonote::get_tx_pub_key_from_extra(tx);
+    crypto::public_key pub_tx_key = xmreg::scan_tx_pub_key(tx.extra);
 
     vector<crypto::key_image> key_images_found;
 
+    // outputs of key_images_found, for follow mode
+    vector<xmreg::owned_output> outputs_found;
+
     if (outputs_ids.size())
     {
         print("We found our outputs: \n");
@@ -241,6 +849,10 @@ int main(int ac, const char* av[]) {
 
             key_images_found.push_back(key_image);
 
+            outputs_found.push_back(
+                    xmreg::owned_output {tx_blk_height, tx_hash, ouput_i,
+                                         tx_output.amount, tx_out_to_key.key});
+
 
             print(" - key image generated: {:s}\n", key_image);
 
@@ -249,7 +861,11 @@ int main(int ac, const char* av[]) {
     else
     {
         print("No our outputs were found in this transaction\n");
-        return 0;
+
+        if (!follow)
+        {
+            return 0;
+        }
     }
 
     cout << endl;
@@ -286,7 +902,52 @@ int main(int ac, const char* av[]) {
 
         unordered_map<crypto::key_image, crypto::hash> txs_found;
 
-        txs_found = mcore.find_txs_with_key_images(spent_key_images, true);
+        vector<crypto::key_image> key_images_to_scan = spent_key_images;
+
+        if (use_sidecar)
+        {
+            txs_found = mcore.find_txs_with_key_images(sidecar, spent_key_images);
+
+            // key images spent in blocks newer than the sidecar
+            // are still searched for in the blockchain
+            key_images_to_scan.erase(
+                    std::remove_if(key_images_to_scan.begin(), key_images_to_scan.end(),
+                                   [&](const crypto::key_image& key_img)
+                                   {
+                                       return txs_found.count(key_img) > 0;
+                                   }),
+                    key_images_to_scan.end());
+        }
+
+        if (!key_images_to_scan.empty())
+        {
+            // outputs cant be spent before the tx
+            // they are in, nor in blocks the sidecar has
+            uint64_t search_from = std::max(tx_blk_height,
+                                            use_sidecar ? sidecar.height() : 0);
+
+            uint64_t search_to = core_storage.get_current_blockchain_height();
+
+            xmreg::ScanDeadline deadline {std::chrono::milliseconds(search_timeout)};
+            xmreg::ScanDeadline no_deadline;
+
+            xmreg::key_image_search_result result
+                    = mcore.find_txs_with_key_images(key_images_to_scan,
+                                                     search_from, search_to,
+                                                     search_timeout > 0 ? deadline : no_deadline,
+                                                     true);
+
+            txs_found.insert(result.txs_found.begin(), result.txs_found.end());
+
+            if (!result.complete)
+            {
+                print("\nSearch {}. Blocks {} to {} were checked,"
+                      " the rest can be checked from block {}\n",
+                      search_timeout > 0 && deadline.expired()
+                      ? "time limit reached" : "stopped on error",
+                      result.h0, result.h1, result.h1);
+            }
+        }
 
 
         if (txs_found.empty())
@@ -306,24 +967,171 @@ int main(int ac, const char* av[]) {
             // key_tx.first is the key_image
             // key_tx.second is the tx hash with the key
 
-            cryptonote::block blk;
+            uint64_t blk_height;
 
-            if (!mcore.get_block_by_tx_hash(key_tx.second, blk))
+            if (!mcore.get_tx_height(key_tx.second, blk_height))
             {
                 cerr << "Cant find block for the given transaction" << endl;
                 return false;
             }
 
-            uint64_t blk_height = cryptonote::get_block_height(blk);
-
             print(" - Key image, tx (block height) found: {:s}, {:s} ({:d})\n",
                   key_tx.first, key_tx.second, blk_height);
 
         }
 
+        // prove that the spends found are ours: our output is in
+        // the ring of the input with its key image, and its ring
+        // signature verifies
+        vector<xmreg::for_signatures> spends;
+
+        crypto::key_derivation derivation;
+
+        if (!generate_key_derivation(pub_tx_key, private_view_key, derivation))
+        {
+            cerr << "Cant get derived key for tx: " << tx_hash << endl;
+            return 1;
+        }
+
+        for (size_t i = 0; i < key_images_found.size(); ++i)
+        {
+            auto key_tx = txs_found.find(key_images_found[i]);
+
+            if (key_tx == txs_found.end())
+            {
+                continue;
+            }
+
+            xmreg::for_signatures spend;
+
+            spend.tx_hash = key_tx->second;
+            spend.kimg    = key_tx->first;
+
+            size_t output_i = outputs_found[i].index_in_tx;
+
+            if (!crypto::derive_public_key(derivation, output_i,
+                                           address.m_spend_public_key,
+                                           spend.in_ephemeral.pub))
+            {
+                cerr << "Cant derive key of output: " << output_i << endl;
+                continue;
+            }
+
+            crypto::derive_secret_key(derivation, output_i,
+                                      private_spend_key,
+                                      spend.in_ephemeral.sec);
+
+            spends.push_back(spend);
+        }
+
+        vector<xmreg::own_spend_check> checks;
+
+        // failed verification is only reported, so
+        // exit code is that of the search, as before
+        if (!xmreg::verify_own_spends(mcore, spends, checks))
+        {
+            print("\nOur spends could not be verified\n");
+        }
+        else
+        {
+            print("\nOur spends verified:\n");
+
+            bool all_ok {true};
+
+            for (size_t i = 0; i < spends.size(); ++i)
+            {
+                const xmreg::own_spend_check& check = checks[i];
+
+                if (!check.input_found)
+                {
+                    print(" - Key image {:s}: no input with it in tx {:s}\n",
+                          spends[i].kimg, spends[i].tx_hash);
+                }
+                else
+                {
+                    print(" - Key image {:s}: input {} of tx {:s}, ring position {} of {},"
+                          " ours {}, key image ok {}, signature ok {}\n",
+                          spends[i].kimg, check.input_index, spends[i].tx_hash,
+                          spends[i].real_output, spends[i].outs_pub_keys.size(),
+                          check.in_ring, check.key_image_ok, check.signature_ok);
+                }
+
+                all_ok = all_ok && check.ok();
+            }
+
+            if (!all_ok)
+            {
+                print("\nNot all spends could be verified as ours\n");
+            }
+        }
+
     }
 
 
+    if (follow)
+    {
+        // start from the current top of the blockchain, as
+        // seen by the reader, not by the core_storage
+        xmreg::ChainReader::ReadTxn txn;
+
+        if (!mcore.get_reader().begin_read(txn))
+        {
+            cerr << "Cant read blockchain height" << endl;
+            return 1;
+        }
+
+        uint64_t start_height = txn.height();
+
+        txn.close();
+
+        xmreg::ChainFollower follower {mcore.get_reader(), account_keys, start_height};
+
+        // spends of our unspent outputs in the given tx
+        // are reported as well
+        for (size_t i = 0; i < key_images_found.size(); ++i)
+        {
+            if (std::find(spent_key_images.begin(), spent_key_images.end(),
+                          key_images_found[i]) == spent_key_images.end())
+            {
+                follower.watch(key_images_found[i], outputs_found[i]);
+            }
+        }
+
+        std::signal(SIGINT, on_sigint);
+
+        print("\nFollowing blockchain from height {} (ctrl+c to stop) ...\n", start_height);
+
+        bool followed = follower.run(
+                [](const xmreg::follow_event& event)
+                {
+                    switch (event.type)
+                    {
+                        case xmreg::follow_event::kind::received:
+                            print("Block {}: received output {:s}, amount {:0.6f} in tx {:s}\n",
+                                  event.height, event.output.pubkey,
+                                  event.output.amount / 1e12, event.tx_hash);
+                            break;
+                        case xmreg::follow_event::kind::spent:
+                            print("Block {}: spent output {:s}, key image {:s} in tx {:s}\n",
+                                  event.height, event.output.pubkey,
+                                  event.k_image, event.tx_hash);
+                            break;
+                        case xmreg::follow_event::kind::reorg:
+                            print("Block {}: blocks from this height were replaced\n",
+                                  event.height);
+                            break;
+                    }
+                },
+                stop_requested);
+
+        if (!followed)
+        {
+            cerr << "Error following blockchain at height "
+                 << follower.height() << endl;
+            return 1;
+        }
+    }
+
     cout << "\nEnd of program." << endl;
 
     return 0;
@@ -0,0 +1,373 @@
+#include "BatchChecker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace xmreg
+{
+
+namespace
+{
+    const char* const CSV_HEADER {
+            "tx_hash,height,timestamp,our_outputs,received,spent_outputs,spent"};
+
+    bool
+    hash_less(const crypto::hash& a, const crypto::hash& b)
+    {
+        return memcmp(&a, &b, sizeof(crypto::hash)) < 0;
+    }
+}
+
+
+    BatchChecker::BatchChecker(MicroCore& mcore,
+                               const account_keys& default_keys,
+                               bool testnet)
+            : m_mcore {mcore},
+              m_default_keys {default_keys},
+              m_testnet {testnet}
+    {}
+
+
+    /**
+     * Read all lines of input. Empty lines and lines
+     * starting with # are skipped. Invalid lines get
+     * "invalid" as their result.
+     */
+    bool
+    BatchChecker::read_entries(istream& in)
+    {
+        string line;
+
+        size_t line_no {0};
+
+        while (getline(in, line))
+        {
+            ++line_no;
+
+            istringstream iss {line};
+
+            string tx_hash_str, address_str, viewkey_str, spendkey_str;
+
+            if (!(iss >> tx_hash_str) || tx_hash_str[0] == '#')
+            {
+                continue;
+            }
+
+            iss >> address_str >> viewkey_str >> spendkey_str;
+
+            batch_entry entry;
+
+            entry.keys           = m_default_keys;
+            entry.have_spend_key = true;
+            entry.height         = 0;
+            entry.found          = false;
+
+            bool valid = parse_str_secret_key(tx_hash_str, entry.tx_hash);
+
+            if (valid && !address_str.empty())
+            {
+                // keys in the line are of a different wallet,
+                // so its spend key is not known unless given
+                valid = !viewkey_str.empty()
+                        && parse_str_address(address_str,
+                                             entry.keys.m_account_address,
+                                             m_testnet)
+                        && parse_str_secret_key(viewkey_str,
+                                                entry.keys.m_view_secret_key);
+
+                entry.have_spend_key = !spendkey_str.empty();
+
+                if (valid && entry.have_spend_key)
+                {
+                    valid = parse_str_secret_key(spendkey_str,
+                                                 entry.keys.m_spend_secret_key);
+                }
+            }
+
+            if (!valid)
+            {
+                cerr << "Invalid batch line " << line_no << ": " << line << endl;
+
+                entry.result = tx_hash_str + ",invalid";
+            }
+
+            m_entries.push_back(std::move(entry));
+        }
+
+        return !in.bad();
+    }
+
+
+    bool
+    BatchChecker::run(ostream& out)
+    {
+        BlockchainDB& db = m_mcore.get_core().get_db();
+
+        // entries still to check
+        vector<size_t> order;
+
+        for (size_t i = 0; i < m_entries.size(); ++i)
+        {
+            if (m_entries[i].result.empty())
+            {
+                order.push_back(i);
+            }
+        }
+
+        // first resolve heights, in order of tx hashes,
+        // which is also the key order of tx heights table
+        std::sort(order.begin(), order.end(),
+                  [&](size_t a, size_t b)
+                  {
+                      return hash_less(m_entries[a].tx_hash, m_entries[b].tx_hash);
+                  });
+
+        for (size_t j = 0; j < order.size(); ++j)
+        {
+            batch_entry& entry = m_entries[order[j]];
+
+            // same tx as the previous entry
+            if (j > 0 && entry.tx_hash == m_entries[order[j - 1]].tx_hash)
+            {
+                entry.height = m_entries[order[j - 1]].height;
+                entry.found  = m_entries[order[j - 1]].found;
+                entry.result = m_entries[order[j - 1]].result;
+                continue;
+            }
+
+            try
+            {
+                entry.height = db.get_tx_block_height(entry.tx_hash);
+                entry.found  = true;
+            }
+            catch (const TX_DNE&)
+            {
+                entry.found = false;
+            }
+            catch (const exception& e)
+            {
+                cerr << "Cant get height of tx " << entry.tx_hash
+                     << ": " << e.what() << endl;
+
+                entry.result = epee::string_tools::pod_to_hex(entry.tx_hash)
+                               + ",cant read tx";
+            }
+        }
+
+        // then process txs in height order
+        std::stable_sort(order.begin(), order.end(),
+                         [&](size_t a, size_t b)
+                         {
+                             return m_entries[a].height < m_entries[b].height;
+                         });
+
+        ChainReader::ReadTxn txn;
+
+        if (!m_mcore.get_reader().begin_read(txn))
+        {
+            return false;
+        }
+
+        // reused for each block and tx
+        block blk;
+        transaction_prefix tx;
+
+        // what was read last, so that each block
+        // and each tx is read only once
+        uint64_t blk_height {0};
+        bool have_blk {false};
+        bool blk_read {false};
+
+        crypto::hash miner_tx_hash = null_hash;
+
+        crypto::hash tx_hash_read = null_hash;
+        bool have_tx {false};
+        bool tx_read {false};
+
+        for (size_t i: order)
+        {
+            batch_entry& entry = m_entries[i];
+
+            // failed already, when its height was looked up
+            if (!entry.result.empty())
+            {
+                continue;
+            }
+
+            string tx_hash_str = epee::string_tools::pod_to_hex(entry.tx_hash);
+
+            if (!entry.found)
+            {
+                entry.result = tx_hash_str + ",not found";
+                continue;
+            }
+
+            if (!have_blk || blk_height != entry.height)
+            {
+                blob_view blk_blob;
+                blob_view miner_tx_blob;
+
+                blk_height = entry.height;
+                have_blk   = true;
+
+                // block gives timestamp, and coinbase tx,
+                // which does not need to be read again
+                blk_read = txn.get_block_blob(blk_height, blk_blob)
+                           && parse_block_from_view(blk_blob, blk, &miner_tx_blob);
+
+                if (!blk_read)
+                {
+                    cerr << "Cant get block of height: " << blk_height << endl;
+                }
+                else
+                {
+                    miner_tx_hash = get_tx_hash_from_view(miner_tx_blob);
+                }
+            }
+
+            if (!blk_read)
+            {
+                entry.result = tx_hash_str + ",cant read block";
+                continue;
+            }
+
+            if (!have_tx || tx_hash_read != entry.tx_hash)
+            {
+                tx_hash_read = entry.tx_hash;
+                have_tx      = true;
+
+                blob_view tx_blob;
+
+                if (entry.tx_hash == miner_tx_hash)
+                {
+                    tx      = blk.miner_tx;
+                    tx_read = true;
+                }
+                else
+                {
+                    tx_read = txn.get_tx_blob(entry.tx_hash, tx_blob)
+                              && parse_tx_prefix_from_view(tx_blob, tx);
+                }
+            }
+
+            if (!tx_read)
+            {
+                entry.result = tx_hash_str + ",cant read tx";
+                continue;
+            }
+
+            if (!check_tx(txn, tx, blk.timestamp, entry))
+            {
+                entry.result = tx_hash_str + ",cant check spent";
+            }
+        }
+
+        out << CSV_HEADER << "\n";
+
+        for (const batch_entry& entry: m_entries)
+        {
+            out << entry.result << "\n";
+        }
+
+        out.flush();
+
+        return static_cast<bool>(out);
+    }
+
+
+    bool
+    BatchChecker::check_tx(ChainReader::ReadTxn& txn,
+                           const transaction_prefix& tx,
+                           const uint64_t& timestamp,
+                           batch_entry& entry)
+    {
+        const public_key& public_spend_key
+                = entry.keys.m_account_address.m_spend_public_key;
+
+        size_t no_of_outputs {0};
+        size_t no_of_spent {0};
+
+        uint64_t received {0};
+        uint64_t spent {0};
+
+        public_key pub_tx_key = scan_tx_pub_key(tx.extra);
+
+        key_derivation derivation;
+
+        if (pub_tx_key != null_pkey
+            && generate_key_derivation(pub_tx_key, entry.keys.m_view_secret_key, derivation))
+        {
+            for (size_t i = 0; i < tx.vout.size(); ++i)
+            {
+                if (tx.vout[i].target.type() != typeid(txout_to_key))
+                {
+                    continue;
+                }
+
+                public_key pubkey;
+
+                derive_public_key(derivation, i, public_spend_key, pubkey);
+
+                if (boost::get<txout_to_key>(tx.vout[i].target).key != pubkey)
+                {
+                    continue;
+                }
+
+                ++no_of_outputs;
+                received += tx.vout[i].amount;
+
+                if (!entry.have_spend_key)
+                {
+                    continue;
+                }
+
+                // the same derivation gives the key image
+                key_image k_image;
+
+                bool is_spent {false};
+
+                if (!generate_key_image(derivation, i,
+                                        entry.keys.m_spend_secret_key,
+                                        public_spend_key,
+                                        k_image))
+                {
+                    continue;
+                }
+
+                if (!txn.is_spent(k_image, is_spent))
+                {
+                    return false;
+                }
+
+                if (is_spent)
+                {
+                    ++no_of_spent;
+                    spent += tx.vout[i].amount;
+                }
+            }
+        }
+
+        ostringstream oss;
+
+        oss << epee::string_tools::pod_to_hex(entry.tx_hash)
+            << "," << entry.height
+            << "," << timestamp_to_str(timestamp)
+            << "," << no_of_outputs
+            << "," << print_money(received);
+
+        if (entry.have_spend_key)
+        {
+            oss << "," << no_of_spent << "," << print_money(spent);
+        }
+        else
+        {
+            oss << ",-,-";
+        }
+
+        entry.result = oss.str();
+
+        return true;
+    }
+
+}
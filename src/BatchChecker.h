@@ -0,0 +1,87 @@
+#ifndef XMREG01_BATCHCHECKER_H
+#define XMREG01_BATCHCHECKER_H
+
+#include "MicroCore.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    /**
+     * Checks outputs of many txs in one go.
+     *
+     * Each input line is
+     *
+     *   tx_hash [address private_view_key [private_spend_key]]
+     *
+     * with keys of the default wallet used if not given. Without
+     * spend key, outputs are found but not checked for being spent.
+     *
+     * Heights of all txs are resolved first, and txs are processed
+     * in height order, so reads follow the order of the blockchain
+     * on disk. Each block and tx is read and parsed once, however
+     * many lines have it, in one read transaction, and tx's key
+     * derivation is used both for finding our outputs and for their
+     * key images. A tx or block which can not be read fails only
+     * lines having it.
+     *
+     * Results are written as csv, one line per input line,
+     * in the input order.
+     */
+    class BatchChecker
+    {
+    public:
+
+        BatchChecker(MicroCore& mcore,
+                     const account_keys& default_keys,
+                     bool testnet);
+
+        bool
+        read_entries(istream& in);
+
+        bool
+        run(ostream& out);
+
+        size_t
+        no_of_entries() const { return m_entries.size(); }
+
+    private:
+
+        struct batch_entry
+        {
+            crypto::hash tx_hash;
+            account_keys keys;
+            bool have_spend_key;
+
+            uint64_t height;
+            bool found;
+
+            // csv line of the result
+            string result;
+        };
+
+        // false if spent status could not be read
+        bool
+        check_tx(ChainReader::ReadTxn& txn,
+                 const transaction_prefix& tx,
+                 const uint64_t& timestamp,
+                 batch_entry& entry);
+
+        MicroCore& m_mcore;
+
+        account_keys m_default_keys;
+
+        bool m_testnet;
+
+        vector<batch_entry> m_entries;
+    };
+
+}
+
+#endif //XMREG01_BATCHCHECKER_H
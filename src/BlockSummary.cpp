@@ -0,0 +1,410 @@
+#include "BlockSummary.h"
+#include "MicroCore.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+namespace xmreg
+{
+
+namespace
+{
+    namespace bf = boost::filesystem;
+
+    // rough costs of scanning a block, its txs, outputs and
+    // ring members, as numbers of tx bytes parsed in the same time
+    const uint64_t BLOCK_WORK       {1024};
+    const uint64_t TX_WORK          {4096};
+    const uint64_t OUTPUT_WORK      {2048};
+    const uint64_t RING_MEMBER_WORK {64};
+
+    // last blocks whose average work is the work
+    // of blocks past the end of the summary
+    const uint64_t TAIL_BLOCKS {1000};
+
+    // how often, in blocks, records are written while building
+    const uint64_t COMMIT_INTERVAL {10000};
+
+
+    /**
+     * Makes block_summary records of visited blocks.
+     */
+    class SummaryVisitor : public ChainVisitor
+    {
+    public:
+
+        vector<block_summary> summaries;
+
+        uint32_t
+        fields() const override { return VISIT_BLOCK | VISIT_TX_BLOB | VISIT_TX_PREFIX; }
+
+        unique_ptr<ChainVisitor>
+        fork() const override
+        {
+            return unique_ptr<ChainVisitor> {new SummaryVisitor()};
+        }
+
+        void
+        merge(ChainVisitor& range_visitor) override
+        {
+            SummaryVisitor& other = static_cast<SummaryVisitor&>(range_visitor);
+
+            summaries.insert(summaries.end(),
+                             other.summaries.begin(), other.summaries.end());
+        }
+
+        void
+        visit_block(const uint64_t& height, const block& blk) override
+        {
+            summaries.push_back(block_summary {0, 0, 0, 0, 0});
+        }
+
+        void
+        visit_tx(const tx_visit& tx) override
+        {
+            block_summary& summary = summaries.back();
+
+            ++summary.no_of_txs;
+
+            summary.no_of_outputs += tx.prefix->vout.size();
+            summary.blob_bytes    += tx.blob->size;
+
+            for (const txin_v& in: tx.prefix->vin)
+            {
+                if (in.type() == typeid(txin_to_key))
+                {
+                    ++summary.no_of_inputs;
+
+                    summary.no_of_ring_members
+                            += boost::get<txin_to_key>(in).key_offsets.size();
+                }
+            }
+        }
+    };
+
+} // namespace
+
+
+
+    BlockSummary::BlockSummary()
+            : m_work {0},
+              m_tail_work {block_work(block_summary {0, 0, 0, 0, 0})}
+    {}
+
+
+    /**
+     * Map the summary file and sum up work of its blocks.
+     * A partly written last record is ignored.
+     */
+    bool
+    BlockSummary::open(const string& summary_path)
+    {
+        if (!m_file.open(summary_path))
+        {
+            return false;
+        }
+
+        uint64_t no_of_blocks = m_file.size() / sizeof(block_summary);
+
+        const block_summary* summaries = m_file.as<block_summary>();
+
+        m_work.assign(1, 0);
+        m_work.reserve(no_of_blocks + 1);
+
+        for (uint64_t height = 0; height < no_of_blocks; ++height)
+        {
+            m_work.push_back(m_work.back() + block_work(summaries[height]));
+        }
+
+        uint64_t tail = std::min(no_of_blocks, TAIL_BLOCKS);
+
+        if (tail > 0)
+        {
+            m_tail_work = std::max<uint64_t>(
+                    (m_work.back() - m_work[no_of_blocks - tail]) / tail, 1);
+        }
+
+        return true;
+    }
+
+
+    uint64_t
+    BlockSummary::work(const uint64_t& h0, const uint64_t& h1) const
+    {
+        return h0 < h1 ? work_before(h1) - work_before(h0) : 0;
+    }
+
+
+    /**
+     * Split blocks [h0, h1) into at most no_of_parts
+     * consecutive ranges of about equal work.
+     */
+    vector<BlockSummary::height_range>
+    BlockSummary::split(uint64_t h0, uint64_t h1, size_t no_of_parts) const
+    {
+        vector<height_range> parts;
+
+        if (h0 >= h1)
+        {
+            return parts;
+        }
+
+        no_of_parts = std::max<uint64_t>(std::min<uint64_t>(no_of_parts, h1 - h0), 1);
+
+        uint64_t start_work = work_before(h0);
+        uint64_t total_work = work(h0, h1);
+
+        uint64_t part_h0 = h0;
+
+        for (size_t i = 1; i < no_of_parts; ++i)
+        {
+            uint64_t cut_work = start_work + static_cast<uint64_t>(
+                    static_cast<double>(total_work) * i / no_of_parts);
+
+            // block having the cut goes to the next part
+            uint64_t cut = std::min(std::max(height_at_work(cut_work), part_h0), h1);
+
+            if (cut > part_h0)
+            {
+                parts.push_back(height_range {part_h0, cut});
+                part_h0 = cut;
+            }
+        }
+
+        parts.push_back(height_range {part_h0, h1});
+
+        return parts;
+    }
+
+
+    uint64_t
+    BlockSummary::cut(uint64_t h0, uint64_t h1, uint64_t w) const
+    {
+        if (h0 >= h1)
+        {
+            return h1;
+        }
+
+        if (w == 0)
+        {
+            return h0 + 1;
+        }
+
+        // block having the last unit of the work
+        uint64_t h = height_at_work(work_before(h0) + w - 1) + 1;
+
+        return std::min(std::max(h, h0 + 1), h1);
+    }
+
+
+    uint64_t
+    BlockSummary::block_work(const block_summary& summary)
+    {
+        return BLOCK_WORK
+               + summary.blob_bytes
+               + TX_WORK          * summary.no_of_txs
+               + OUTPUT_WORK      * summary.no_of_outputs
+               + RING_MEMBER_WORK * summary.no_of_ring_members;
+    }
+
+
+    /**
+     * Create summary file in summary_path, or append to
+     * existing one, with blocks up to, but not including, to_height.
+     */
+    bool
+    BlockSummary::build(MicroCore& mcore,
+                        const string& summary_path,
+                        uint64_t to_height,
+                        bool show_progress)
+    {
+        uint64_t height {0};
+
+        if (bf::exists(summary_path))
+        {
+            height = bf::file_size(summary_path) / sizeof(block_summary);
+
+            // drop partly written record of a build that did not finish
+            bf::resize_file(summary_path, height * sizeof(block_summary));
+        }
+
+        ofstream out(summary_path, ios::binary | ios::app);
+
+        if (!out)
+        {
+            cerr << "Cant open " << summary_path << " for writing" << endl;
+            return false;
+        }
+
+        while (height < to_height)
+        {
+            SummaryVisitor visitor;
+
+            uint64_t h1 = std::min(height + COMMIT_INTERVAL, to_height);
+
+            if (!mcore.visit_chain({&visitor}, height, h1).complete)
+            {
+                return false;
+            }
+
+            // blockchain is shorter than to_height
+            if (visitor.summaries.empty())
+            {
+                break;
+            }
+
+            out.write(reinterpret_cast<const char*>(visitor.summaries.data()),
+                      visitor.summaries.size() * sizeof(block_summary));
+
+            if (!out.flush())
+            {
+                cerr << "Cant write " << summary_path << endl;
+                return false;
+            }
+
+            height += visitor.summaries.size();
+
+            if (show_progress)
+            {
+                cout << "\r - block summary height: "
+                     << height << "/" << to_height << flush;
+            }
+        }
+
+        if (show_progress)
+        {
+            cout << endl;
+        }
+
+        return true;
+    }
+
+
+    uint64_t
+    BlockSummary::work_before(const uint64_t& h) const
+    {
+        if (h <= height())
+        {
+            return m_work[h];
+        }
+
+        return m_work.back() + (h - height()) * m_tail_work;
+    }
+
+
+    uint64_t
+    BlockSummary::height_at_work(const uint64_t& w) const
+    {
+        if (w < m_work.back())
+        {
+            return std::upper_bound(m_work.begin(), m_work.end(), w)
+                   - m_work.begin() - 1;
+        }
+
+        return height() + (w - m_work.back()) / m_tail_work;
+    }
+
+
+
+    ScanProgress::ScanProgress(const BlockSummary& summary,
+                               uint64_t h0, uint64_t h1,
+                               const string& what,
+                               bool show_progress)
+            : m_summary {summary},
+              m_what {what},
+              m_show_progress {show_progress},
+              m_total_work {summary.work(h0, h1)},
+              m_start {chrono::steady_clock::now()},
+              m_last_print {m_start}
+    {}
+
+
+    /**
+     * Count blocks [h0, h1) as done. Progress is
+     * printed, to cerr so that it does not mix with
+     * results, at most once a second.
+     */
+    void
+    ScanProgress::done(const uint64_t& h0, const uint64_t& h1)
+    {
+        m_done_work += m_summary.work(h0, h1);
+
+        if (!m_show_progress)
+        {
+            return;
+        }
+
+        unique_lock<mutex> lock {m_print_mutex, std::try_to_lock};
+
+        if (lock.owns_lock()
+            && chrono::steady_clock::now() - m_last_print >= chrono::seconds(1))
+        {
+            print();
+        }
+    }
+
+
+    void
+    ScanProgress::skip(const uint64_t& h0, const uint64_t& h1)
+    {
+        m_total_work -= std::min(m_summary.work(h0, h1), m_total_work);
+    }
+
+
+    double
+    ScanProgress::fraction_done() const
+    {
+        if (m_total_work == 0)
+        {
+            return 1.0;
+        }
+
+        return std::min(static_cast<double>(m_done_work) / m_total_work, 1.0);
+    }
+
+
+    double
+    ScanProgress::eta() const
+    {
+        double fraction = fraction_done();
+
+        if (fraction <= 0.0)
+        {
+            return 0.0;
+        }
+
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - m_start;
+
+        return elapsed.count() * (1.0 - fraction) / fraction;
+    }
+
+
+    void
+    ScanProgress::finish()
+    {
+        if (m_show_progress)
+        {
+            lock_guard<mutex> lock {m_print_mutex};
+
+            print();
+
+            cerr << endl;
+        }
+    }
+
+
+    void
+    ScanProgress::print()
+    {
+        uint64_t eta_s = static_cast<uint64_t>(eta());
+
+        cerr << "\r - " << m_what << ": "
+             << static_cast<int>(fraction_done() * 100) << "%, eta "
+             << eta_s / 60 << "m " << eta_s % 60 << "s   " << flush;
+
+        m_last_print = chrono::steady_clock::now();
+    }
+
+}
@@ -0,0 +1,165 @@
+#ifndef XMREG01_BLOCKSUMMARY_H
+#define XMREG01_BLOCKSUMMARY_H
+
+#include "MappedFile.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace std;
+
+    class MicroCore;
+
+    /**
+     * Sizes of a block, i.e., of all its txs
+     * together with its coinbase tx.
+     */
+    struct block_summary
+    {
+        uint32_t no_of_txs;
+        uint32_t no_of_inputs;
+        uint32_t no_of_outputs;
+        uint32_t no_of_ring_members;
+        uint64_t blob_bytes;
+    };
+
+
+    /**
+     * File of block_summary records, one for each block in
+     * height order, used to split height ranges into parts of
+     * about equal work, rather than of equal number of blocks.
+     * Early blocks are nearly empty, while recent ones have
+     * most of the txs.
+     *
+     * Work of a block is an estimate of how long scans take
+     * on it. Blocks past the end of the file, e.g., if it was not
+     * updated for some time, are taken to be like its last ones.
+     * Without a file, all blocks have the same work.
+     */
+    class BlockSummary
+    {
+    public:
+
+        // [h0, h1) range of blocks
+        struct height_range
+        {
+            uint64_t h0;
+            uint64_t h1;
+        };
+
+        BlockSummary();
+
+        BlockSummary(const BlockSummary&) = delete;
+        BlockSummary& operator=(const BlockSummary&) = delete;
+
+        bool
+        open(const string& summary_path);
+
+        uint64_t
+        height() const { return m_work.size() - 1; }
+
+        const block_summary&
+        at(const uint64_t& height) const { return m_file.as<block_summary>()[height]; }
+
+        uint64_t
+        work(const uint64_t& h0, const uint64_t& h1) const;
+
+        vector<height_range>
+        split(uint64_t h0, uint64_t h1, size_t no_of_parts) const;
+
+        // first height h in (h0, h1] for which
+        // blocks [h0, h) have at least work w
+        uint64_t
+        cut(uint64_t h0, uint64_t h1, uint64_t w) const;
+
+        static uint64_t
+        block_work(const block_summary& summary);
+
+        static bool
+        build(MicroCore& mcore,
+              const string& summary_path,
+              uint64_t to_height,
+              bool show_progress = false);
+
+    private:
+
+        // work of blocks [0, h)
+        uint64_t
+        work_before(const uint64_t& h) const;
+
+        // first height h for which work_before(h + 1) > w
+        uint64_t
+        height_at_work(const uint64_t& w) const;
+
+        MappedFile m_file;
+
+        // work_before for heights [0, height()]
+        vector<uint64_t> m_work;
+
+        // work of each block past height()
+        uint64_t m_tail_work;
+    };
+
+
+    /**
+     * Progress of a scan of blocks [h0, h1), by work of
+     * blocks done so far rather than their number. Ranges
+     * can be done in any order, by any thread.
+     */
+    class ScanProgress
+    {
+    public:
+
+        ScanProgress(const BlockSummary& summary,
+                     uint64_t h0, uint64_t h1,
+                     const string& what,
+                     bool show_progress);
+
+        void
+        done(const uint64_t& h0, const uint64_t& h1);
+
+        // not to be done by this scan, e.g., done before.
+        // only before any done() call.
+        void
+        skip(const uint64_t& h0, const uint64_t& h1);
+
+        double
+        fraction_done() const;
+
+        // seconds left, estimated from the rate so far
+        double
+        eta() const;
+
+        void
+        finish();
+
+    private:
+
+        void
+        print();
+
+        const BlockSummary& m_summary;
+
+        string m_what;
+
+        bool m_show_progress;
+
+        uint64_t m_total_work;
+
+        std::atomic<uint64_t> m_done_work {0};
+
+        chrono::steady_clock::time_point m_start;
+        chrono::steady_clock::time_point m_last_print;
+
+        mutex m_print_mutex;
+    };
+
+}
+
+#endif //XMREG01_BLOCKSUMMARY_H
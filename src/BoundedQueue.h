@@ -0,0 +1,110 @@
+#ifndef XMREG01_BOUNDEDQUEUE_H
+#define XMREG01_BOUNDEDQUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace xmreg
+{
+    using namespace std;
+
+    /**
+     * Queue between stages of a pipeline running in different
+     * threads. push blocks while the queue is full, so a fast
+     * stage can not run away from a slow one, and pop blocks
+     * while it is empty.
+     *
+     * When all producers are done, close() lets consumers
+     * take what is left, after which pop returns false.
+     */
+    template <typename T>
+    class BoundedQueue
+    {
+        mutex m_mutex;
+
+        condition_variable m_not_full;
+        condition_variable m_not_empty;
+
+        deque<T> m_items;
+
+        size_t m_capacity;
+
+        bool m_closed {false};
+
+    public:
+
+        explicit BoundedQueue(size_t capacity)
+                : m_capacity {capacity > 0 ? capacity : 1}
+        {}
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        /**
+         * Returns false if the queue was closed,
+         * in which case item is not added.
+         */
+        bool
+        push(T item)
+        {
+            unique_lock<mutex> lock {m_mutex};
+
+            m_not_full.wait(lock, [&]{ return m_closed || m_items.size() < m_capacity; });
+
+            if (m_closed)
+            {
+                return false;
+            }
+
+            m_items.push_back(std::move(item));
+
+            lock.unlock();
+
+            m_not_empty.notify_one();
+
+            return true;
+        }
+
+        /**
+         * Returns false if the queue is
+         * closed and nothing is left in it.
+         */
+        bool
+        pop(T& item)
+        {
+            unique_lock<mutex> lock {m_mutex};
+
+            m_not_empty.wait(lock, [&]{ return m_closed || !m_items.empty(); });
+
+            if (m_items.empty())
+            {
+                return false;
+            }
+
+            item = std::move(m_items.front());
+            m_items.pop_front();
+
+            lock.unlock();
+
+            m_not_full.notify_one();
+
+            return true;
+        }
+
+        void
+        close()
+        {
+            {
+                lock_guard<mutex> lock {m_mutex};
+                m_closed = true;
+            }
+
+            m_not_full.notify_all();
+            m_not_empty.notify_all();
+        }
+    };
+
+}
+
+#endif //XMREG01_BOUNDEDQUEUE_H
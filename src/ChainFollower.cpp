@@ -0,0 +1,325 @@
+#include "ChainFollower.h"
+
+#include <thread>
+
+namespace xmreg
+{
+
+namespace
+{
+    // how many last blocks are checked for being
+    // replaced by a reorganization
+    const size_t MAX_REORG_DEPTH {100};
+}
+
+
+    ChainFollower::ChainFollower(const ChainReader& reader,
+                                 const account_keys& keys,
+                                 uint64_t start_height,
+                                 bool have_spend_key)
+            : m_reader {reader},
+              m_keys {keys},
+              m_have_spend_key {have_spend_key},
+              m_next_height {start_height}
+    {}
+
+
+    void
+    ChainFollower::watch(const key_image& k_image, const owned_output& output)
+    {
+        m_watched[k_image] = watched_output {output, false, 0};
+    }
+
+
+    /**
+     * Process all blocks added since the last poll,
+     * calling f for each event found in them.
+     */
+    bool
+    ChainFollower::poll(const event_callback& f)
+    {
+        ChainReader::ReadTxn txn;
+
+        if (!m_reader.begin_read(txn))
+        {
+            return false;
+        }
+
+        if (!check_reorg(txn, f))
+        {
+            return false;
+        }
+
+        uint64_t chain_height = txn.height();
+
+        for (uint64_t height = m_next_height; height < chain_height; ++height)
+        {
+            if (!process_block(txn, height, f))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Poll every poll_interval until stop is set.
+     */
+    bool
+    ChainFollower::run(const event_callback& f,
+                       const std::atomic<bool>& stop,
+                       std::chrono::milliseconds poll_interval)
+    {
+        while (!stop)
+        {
+            if (!poll(f))
+            {
+                return false;
+            }
+
+            std::this_thread::sleep_for(poll_interval);
+        }
+
+        return true;
+    }
+
+
+    bool
+    ChainFollower::process_block(ChainReader::ReadTxn& txn,
+                                 const uint64_t& height,
+                                 const event_callback& f)
+    {
+        blob_view blk_blob;
+        blob_view miner_tx_blob;
+
+        if (!txn.get_block_blob(height, blk_blob)
+            || !parse_block_from_view(blk_blob, m_blk, &miner_tx_blob))
+        {
+            cerr << "Cant get block of height: " << height << endl;
+            return false;
+        }
+
+        if (!process_tx(height, get_tx_hash_from_view(miner_tx_blob), miner_tx_blob, f))
+        {
+            return false;
+        }
+
+        for (const crypto::hash& tx_hash: m_blk.tx_hashes)
+        {
+            blob_view tx_blob;
+
+            if (!txn.get_tx_blob(tx_hash, tx_blob))
+            {
+                cerr << "Cant get tx " << tx_hash
+                     << " in block: " << height << endl;
+                return false;
+            }
+
+            if (!process_tx(height, tx_hash, tx_blob, f))
+            {
+                return false;
+            }
+        }
+
+        m_recent_hashes.push_back(get_block_hash(m_blk));
+
+        if (m_recent_hashes.size() > MAX_REORG_DEPTH)
+        {
+            m_recent_hashes.pop_front();
+        }
+
+        m_next_height = height + 1;
+
+        return true;
+    }
+
+
+    bool
+    ChainFollower::process_tx(const uint64_t& height,
+                              const crypto::hash& tx_hash,
+                              const blob_view& tx_blob,
+                              const event_callback& f)
+    {
+        if (!parse_tx_prefix_from_view(tx_blob, m_tx))
+        {
+            cerr << "Cant parse tx " << tx_hash << endl;
+            return false;
+        }
+
+        // first check if the tx spends any of our outputs
+        for (const txin_v& in: m_tx.vin)
+        {
+            if (in.type() != typeid(txin_to_key))
+            {
+                continue;
+            }
+
+            const key_image& k_image = boost::get<txin_to_key>(in).k_image;
+
+            auto it = m_watched.find(k_image);
+
+            if (it == m_watched.end() || it->second.spent)
+            {
+                continue;
+            }
+
+            it->second.spent        = true;
+            it->second.spent_height = height;
+
+            f(follow_event {follow_event::kind::spent, height, tx_hash,
+                            it->second.output, k_image});
+        }
+
+        // then check if any of its outputs is ours
+        vector<public_key> output_keys;
+
+        output_keys.reserve(m_tx.vout.size());
+
+        for (const tx_out& out: m_tx.vout)
+        {
+            output_keys.push_back(out.target.type() == typeid(txout_to_key)
+                                  ? boost::get<txout_to_key>(out.target).key
+                                  : null_pkey);
+        }
+
+        public_key pub_tx_key = scan_tx_pub_key(m_tx.extra);
+
+        vector<size_t> our_indices = get_belonging_output_indices(
+                pub_tx_key,
+                output_keys.data(),
+                output_keys.size(),
+                m_keys.m_view_secret_key,
+                m_keys.m_account_address.m_spend_public_key);
+
+        if (our_indices.empty())
+        {
+            return true;
+        }
+
+        key_derivation derivation;
+
+        if (m_have_spend_key
+            && !generate_key_derivation(pub_tx_key, m_keys.m_view_secret_key, derivation))
+        {
+            cerr << "Cant get derived key for tx: " << tx_hash << endl;
+            return false;
+        }
+
+        for (size_t i: our_indices)
+        {
+            owned_output output {height, tx_hash, i,
+                                 m_tx.vout[i].amount, output_keys[i]};
+
+            key_image k_image;
+
+            if (m_have_spend_key)
+            {
+                if (!generate_key_image(derivation, i,
+                                        m_keys.m_spend_secret_key,
+                                        m_keys.m_account_address.m_spend_public_key,
+                                        k_image))
+                {
+                    cerr << "Cant generate key image for output: "
+                         << output_keys[i] << endl;
+                    return false;
+                }
+
+                watch(k_image, output);
+            }
+
+            f(follow_event {follow_event::kind::received, height, tx_hash,
+                            output, k_image});
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Check if the last processed blocks are still in the
+     * blockchain. If not, emit reorg event and rewind to the
+     * first replaced block, so that its replacement is processed.
+     */
+    bool
+    ChainFollower::check_reorg(ChainReader::ReadTxn& txn, const event_callback& f)
+    {
+        uint64_t chain_height = txn.height();
+
+        uint64_t fork_height = m_next_height;
+
+        // heights of m_recent_hashes are
+        // [m_next_height - size, m_next_height)
+        for (size_t i = m_recent_hashes.size(); i > 0; --i)
+        {
+            uint64_t height = m_next_height - (m_recent_hashes.size() - i) - 1;
+
+            if (height < chain_height)
+            {
+                block blk;
+
+                if (!txn.get_block(height, blk))
+                {
+                    cerr << "Cant get block of height: " << height << endl;
+                    return false;
+                }
+
+                if (get_block_hash(blk) == m_recent_hashes[i - 1])
+                {
+                    break;
+                }
+            }
+
+            fork_height = height;
+        }
+
+        if (fork_height == m_next_height)
+        {
+            return true;
+        }
+
+        rewind(fork_height);
+
+        follow_event event {};
+
+        event.type   = follow_event::kind::reorg;
+        event.height = fork_height;
+
+        f(event);
+
+        return true;
+    }
+
+
+    /**
+     * Forget what was found in blocks from height up.
+     */
+    void
+    ChainFollower::rewind(const uint64_t& height)
+    {
+        for (auto it = m_watched.begin(); it != m_watched.end();)
+        {
+            if (it->second.output.height >= height)
+            {
+                it = m_watched.erase(it);
+                continue;
+            }
+
+            if (it->second.spent && it->second.spent_height >= height)
+            {
+                it->second.spent = false;
+            }
+
+            ++it;
+        }
+
+        for (uint64_t h = height; h < m_next_height && !m_recent_hashes.empty(); ++h)
+        {
+            m_recent_hashes.pop_back();
+        }
+
+        m_next_height = height;
+    }
+
+}
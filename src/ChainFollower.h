@@ -0,0 +1,138 @@
+#ifndef XMREG01_CHAINFOLLOWER_H
+#define XMREG01_CHAINFOLLOWER_H
+
+#include "monero_headers.h"
+#include "tx_details.h"
+#include "ChainReader.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    /**
+     * Event emitted by ChainFollower for a new block.
+     */
+    struct follow_event
+    {
+        enum class kind
+        {
+            received,   // output to our address in a new block
+            spent,      // key image of our output in a new block
+            reorg       // blocks from height up were replaced
+        };
+
+        kind type;
+
+        uint64_t height;
+
+        // tx with the received output, or the spending tx
+        crypto::hash tx_hash;
+
+        owned_output output;
+
+        key_image k_image;
+    };
+
+
+    /**
+     * Follows the tip of the blockchain and checks only new
+     * blocks for outputs to the given address and for spends
+     * of the outputs we know of.
+     *
+     * The blockchain stays open between polls. New heights are
+     * taken from a fresh ChainReader read transaction, as
+     * Blockchain caches its height and does not see blocks added
+     * by the monero deamon writing to the same lmdb folder.
+     *
+     * Key images of received outputs are generated only if
+     * private spend key is given, otherwise only received events
+     * are emitted for them.
+     */
+    class ChainFollower
+    {
+    public:
+
+        using event_callback = std::function<void(const follow_event&)>;
+
+        ChainFollower(const ChainReader& reader,
+                      const account_keys& keys,
+                      uint64_t start_height,
+                      bool have_spend_key = true);
+
+        /**
+         * Watch for spend of an output found before following
+         * started, e.g., in the tx given in the command line.
+         */
+        void
+        watch(const key_image& k_image, const owned_output& output);
+
+        bool
+        poll(const event_callback& f);
+
+        bool
+        run(const event_callback& f,
+            const std::atomic<bool>& stop,
+            std::chrono::milliseconds poll_interval
+                    = std::chrono::milliseconds {250});
+
+        uint64_t
+        height() const { return m_next_height; }
+
+    private:
+
+        struct watched_output
+        {
+            owned_output output;
+
+            // height of spending block, if spent
+            bool spent;
+            uint64_t spent_height;
+        };
+
+        bool
+        process_block(ChainReader::ReadTxn& txn,
+                      const uint64_t& height,
+                      const event_callback& f);
+
+        bool
+        process_tx(const uint64_t& height,
+                   const crypto::hash& tx_hash,
+                   const blob_view& tx_blob,
+                   const event_callback& f);
+
+        bool
+        check_reorg(ChainReader::ReadTxn& txn, const event_callback& f);
+
+        void
+        rewind(const uint64_t& height);
+
+        const ChainReader& m_reader;
+
+        account_keys m_keys;
+
+        bool m_have_spend_key;
+
+        uint64_t m_next_height;
+
+        unordered_map<key_image, watched_output> m_watched;
+
+        // hashes of last processed blocks, to detect
+        // blocks replaced by a reorganization
+        deque<crypto::hash> m_recent_hashes;
+
+        // reused for each block and tx
+        block m_blk;
+        transaction_prefix m_tx;
+    };
+
+}
+
+#endif //XMREG01_CHAINFOLLOWER_H
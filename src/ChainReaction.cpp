@@ -0,0 +1,432 @@
+#include "ChainReaction.h"
+#include "MicroCore.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace xmreg
+{
+
+namespace
+{
+    // ring without deduced output
+    const uint32_t NO_OUTPUT {std::numeric_limits<uint32_t>::max()};
+
+    // average number of rings checked by a thread at a time
+    const uint64_t GRAIN_RINGS {4096};
+
+
+    /**
+     * Collects rings of key inputs of visited txs,
+     * with absolute global indices of their members.
+     */
+    class RingsVisitor : public ChainVisitor
+    {
+    public:
+
+        vector<key_image> key_images;
+        vector<uint64_t> heights;
+        vector<uint64_t> amounts;
+        vector<uint32_t> ring_sizes;
+        vector<uint64_t> members;
+
+        uint32_t
+        fields() const override { return VISIT_TX_PREFIX; }
+
+        unique_ptr<ChainVisitor>
+        fork() const override
+        {
+            return unique_ptr<ChainVisitor> {new RingsVisitor()};
+        }
+
+        void
+        merge(ChainVisitor& range_visitor) override
+        {
+            RingsVisitor& other = static_cast<RingsVisitor&>(range_visitor);
+
+            key_images.insert(key_images.end(), other.key_images.begin(), other.key_images.end());
+            heights.insert(heights.end(), other.heights.begin(), other.heights.end());
+            amounts.insert(amounts.end(), other.amounts.begin(), other.amounts.end());
+            ring_sizes.insert(ring_sizes.end(), other.ring_sizes.begin(), other.ring_sizes.end());
+            members.insert(members.end(), other.members.begin(), other.members.end());
+        }
+
+        void
+        visit_tx(const tx_visit& tx) override
+        {
+            for (const txin_v& in_v: tx.prefix->vin)
+            {
+                if (in_v.type() != typeid(txin_to_key))
+                {
+                    continue;
+                }
+
+                const txin_to_key& in = boost::get<txin_to_key>(in_v);
+
+                key_images.push_back(in.k_image);
+                heights.push_back(tx.height);
+                amounts.push_back(in.amount);
+                ring_sizes.push_back(in.key_offsets.size());
+
+                // key offsets are relative to the previous one
+                uint64_t global_index {0};
+
+                for (const uint64_t& offset: in.key_offsets)
+                {
+                    global_index += offset;
+                    members.push_back(global_index);
+                }
+            }
+        }
+    };
+
+} // namespace
+
+
+
+    /**
+     * Read rings and give their outputs dense ids: outputs of each
+     * amount, up to the biggest global index used in rings, get
+     * consecutive ids, with amounts in increasing order.
+     */
+    bool
+    ChainReaction::load(MicroCore& mcore, uint64_t h0, uint64_t h1,
+                        bool show_progress)
+    {
+        RingsVisitor visitor;
+
+        if (!mcore.visit_chain({&visitor}, h0, h1, show_progress).complete)
+        {
+            return false;
+        }
+
+        size_t no_of_rings = visitor.ring_sizes.size();
+
+        if (no_of_rings >= NO_OUTPUT)
+        {
+            cerr << "Too many rings: " << no_of_rings << endl;
+            return false;
+        }
+
+        // number of outputs of each amount used in rings
+        unordered_map<uint64_t, uint64_t> amount_outputs;
+
+        {
+            size_t member_i {0};
+
+            for (size_t r = 0; r < no_of_rings; ++r)
+            {
+                uint64_t& no_of_outputs = amount_outputs[visitor.amounts[r]];
+
+                member_i += visitor.ring_sizes[r];
+
+                // members are in increasing order, so last is the biggest
+                if (visitor.ring_sizes[r] > 0)
+                {
+                    no_of_outputs = std::max(no_of_outputs, visitor.members[member_i - 1] + 1);
+                }
+            }
+        }
+
+        m_amounts.clear();
+        m_amount_bases.clear();
+
+        for (const pair<const uint64_t, uint64_t>& a: amount_outputs)
+        {
+            m_amounts.push_back(a.first);
+        }
+
+        std::sort(m_amounts.begin(), m_amounts.end());
+
+        uint64_t no_of_outputs {0};
+
+        for (uint64_t& amount: m_amounts)
+        {
+            m_amount_bases.push_back(no_of_outputs);
+
+            uint64_t amount_base = no_of_outputs;
+
+            no_of_outputs += amount_outputs[amount];
+
+            // from now on, base of the amount's ids
+            amount_outputs[amount] = amount_base;
+        }
+
+        if (no_of_outputs >= NO_OUTPUT)
+        {
+            cerr << "Too many outputs in rings: " << no_of_outputs << endl;
+            return false;
+        }
+
+        m_ring_offsets.assign(1, 0);
+        m_ring_offsets.reserve(no_of_rings + 1);
+
+        m_ring_members.resize(visitor.members.size());
+
+        m_stats = reaction_stats {};
+
+        for (size_t r = 0; r < no_of_rings; ++r)
+        {
+            uint64_t amount_base = amount_outputs[visitor.amounts[r]];
+
+            uint64_t ring_begin = m_ring_offsets.back();
+            uint64_t ring_end   = ring_begin + visitor.ring_sizes[r];
+
+            for (uint64_t i = ring_begin; i < ring_end; ++i)
+            {
+                m_ring_members[i] = amount_base + visitor.members[i];
+            }
+
+            m_ring_offsets.push_back(ring_end);
+
+            if (ring_end - ring_begin == 1)
+            {
+                ++m_stats.no_of_zero_mixin;
+            }
+        }
+
+        m_key_images = std::move(visitor.key_images);
+        m_heights    = std::move(visitor.heights);
+
+        // not needed any more, and biggest of all
+        vector<uint64_t>().swap(visitor.members);
+
+        // rings of each output, by counting sort of ring members
+        m_output_offsets.assign(no_of_outputs + 1, 0);
+
+        for (const uint32_t& output_id: m_ring_members)
+        {
+            ++m_output_offsets[output_id + 1];
+        }
+
+        std::partial_sum(m_output_offsets.begin(), m_output_offsets.end(),
+                         m_output_offsets.begin());
+
+        m_output_rings.resize(m_ring_members.size());
+
+        {
+            vector<uint64_t> positions(m_output_offsets.begin(), m_output_offsets.end() - 1);
+
+            for (size_t r = 0; r < no_of_rings; ++r)
+            {
+                for (uint64_t i = m_ring_offsets[r]; i < m_ring_offsets[r + 1]; ++i)
+                {
+                    m_output_rings[positions[m_ring_members[i]]++] = r;
+                }
+            }
+        }
+
+        m_real_outputs.assign(no_of_rings, NO_OUTPUT);
+
+        m_stats.no_of_rings        = no_of_rings;
+        m_stats.no_of_ring_members = m_ring_members.size();
+        m_stats.no_of_outputs      = no_of_outputs;
+
+        return true;
+    }
+
+
+    /**
+     * In each round, rings to check are split between threads of the
+     * executor, which only read what is deduced so far. Outputs they
+     * find are added after the round, in ring order, so the result
+     * does not depend on the number of threads.
+     */
+    bool
+    ChainReaction::run(RangeExecutor& executor)
+    {
+        size_t no_of_rings = m_real_outputs.size();
+
+        // outputs deduced as real for some ring
+        vector<uint8_t> deduced(m_output_offsets.size() - 1, 0);
+
+        // all rings are checked in the first round
+        vector<uint32_t> candidates(no_of_rings);
+
+        std::iota(candidates.begin(), candidates.end(), 0);
+
+        // rings with their only possible output, found by each thread
+        vector<vector<pair<uint32_t, uint32_t>>> found(executor.no_of_threads());
+
+        vector<pair<uint32_t, uint32_t>> round_found;
+        vector<uint32_t> new_outputs;
+
+        while (!candidates.empty())
+        {
+            ++m_stats.no_of_rounds;
+
+            for (vector<pair<uint32_t, uint32_t>>& f: found)
+            {
+                f.clear();
+            }
+
+            bool run_ok = executor.run(
+                    0, candidates.size(), GRAIN_RINGS,
+                    [&](size_t worker_i, uint64_t i0, uint64_t i1) -> bool
+                    {
+                        for (uint64_t i = i0; i < i1; ++i)
+                        {
+                            uint32_t r = candidates[i];
+
+                            uint32_t possible {NO_OUTPUT};
+                            size_t no_of_possible {0};
+
+                            // same output twice in a ring is next to itself
+                            for (uint64_t k = m_ring_offsets[r];
+                                 k < m_ring_offsets[r + 1] && no_of_possible < 2; ++k)
+                            {
+                                uint32_t output_id = m_ring_members[k];
+
+                                if (deduced[output_id] || output_id == possible)
+                                {
+                                    continue;
+                                }
+
+                                possible = output_id;
+                                ++no_of_possible;
+                            }
+
+                            if (no_of_possible == 1)
+                            {
+                                found[worker_i].push_back(make_pair(r, possible));
+                            }
+                        }
+
+                        return true;
+                    });
+
+            if (!run_ok)
+            {
+                return false;
+            }
+
+            round_found.clear();
+
+            for (const vector<pair<uint32_t, uint32_t>>& f: found)
+            {
+                round_found.insert(round_found.end(), f.begin(), f.end());
+            }
+
+            std::sort(round_found.begin(), round_found.end());
+
+            new_outputs.clear();
+
+            for (const pair<uint32_t, uint32_t>& ring_output: round_found)
+            {
+                // real output of an earlier ring of the round, so the
+                // ring has none left and is counted as a conflict below
+                if (deduced[ring_output.second])
+                {
+                    continue;
+                }
+
+                deduced[ring_output.second] = 1;
+
+                m_real_outputs[ring_output.first] = ring_output.second;
+
+                new_outputs.push_back(ring_output.second);
+            }
+
+            m_stats.no_of_deduced += new_outputs.size();
+
+            // only rings of new outputs can have one possible output left
+            candidates.clear();
+
+            for (const uint32_t& output_id: new_outputs)
+            {
+                for (uint64_t k = m_output_offsets[output_id];
+                     k < m_output_offsets[output_id + 1]; ++k)
+                {
+                    if (m_real_outputs[m_output_rings[k]] == NO_OUTPUT)
+                    {
+                        candidates.push_back(m_output_rings[k]);
+                    }
+                }
+            }
+
+            std::sort(candidates.begin(), candidates.end());
+
+            candidates.erase(std::unique(candidates.begin(), candidates.end()),
+                             candidates.end());
+        }
+
+        // rings whose all outputs are real ones of other rings,
+        // the only place conflicts are counted
+        for (size_t r = 0; r < no_of_rings; ++r)
+        {
+            if (m_real_outputs[r] != NO_OUTPUT)
+            {
+                continue;
+            }
+
+            bool all_deduced {true};
+
+            for (uint64_t k = m_ring_offsets[r]; k < m_ring_offsets[r + 1]; ++k)
+            {
+                all_deduced = all_deduced && deduced[m_ring_members[k]];
+            }
+
+            if (all_deduced)
+            {
+                ++m_stats.no_of_conflicts;
+            }
+        }
+
+        return true;
+    }
+
+
+    bool
+    ChainReaction::export_csv(MicroCore& mcore, ostream& out) const
+    {
+        vector<size_t> rings;
+        vector<pair<uint64_t, uint64_t>> amount_indices;
+
+        for (size_t r = 0; r < m_real_outputs.size(); ++r)
+        {
+            if (m_real_outputs[r] != NO_OUTPUT)
+            {
+                rings.push_back(r);
+                amount_indices.push_back(output_of(m_real_outputs[r]));
+            }
+        }
+
+        // tx hashes and indices of all outputs in one go
+        vector<output_info> outputs;
+
+        if (!mcore.get_output_infos(amount_indices, outputs))
+        {
+            return false;
+        }
+
+        out << "key_image,spend_height,amount,global_index,tx_hash,output_index\n";
+
+        for (size_t i = 0; i < rings.size(); ++i)
+        {
+            out << epee::string_tools::pod_to_hex(m_key_images[rings[i]])
+                << "," << m_heights[rings[i]]
+                << "," << outputs[i].amount
+                << "," << outputs[i].global_index
+                << "," << epee::string_tools::pod_to_hex(outputs[i].tx_hash)
+                << "," << outputs[i].index_in_tx << "\n";
+        }
+
+        out.flush();
+
+        return static_cast<bool>(out);
+    }
+
+
+    pair<uint64_t, uint64_t>
+    ChainReaction::output_of(uint32_t output_id) const
+    {
+        size_t i = std::upper_bound(m_amount_bases.begin(), m_amount_bases.end(),
+                                    static_cast<uint64_t>(output_id))
+                   - m_amount_bases.begin() - 1;
+
+        return make_pair(m_amounts[i], output_id - m_amount_bases[i]);
+    }
+
+}
@@ -0,0 +1,104 @@
+#ifndef XMREG01_CHAINREACTION_H
+#define XMREG01_CHAINREACTION_H
+
+#include "monero_headers.h"
+
+#include <iostream>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    class MicroCore;
+    class RangeExecutor;
+
+    /**
+     * Finds real outputs spent by inputs whose rings give them away.
+     *
+     * An output can be spent only once, so when it is the real
+     * output of one ring, it is a decoy in all others. Rings of zero
+     * mixin inputs have their real output only, and each deduced
+     * output can leave other rings with one possible output left,
+     * and so on, till no more can be deduced.
+     *
+     * Rings are kept as CSR arrays over dense output ids, i.e.,
+     * members of all rings in one array, with offsets of each ring,
+     * and the same for rings of each output. Rings left with one
+     * possible output are looked for in parallel, in rounds, each
+     * checking only rings of outputs deduced in the previous one.
+     */
+    class ChainReaction
+    {
+    public:
+
+        struct reaction_stats
+        {
+            uint64_t no_of_rings {0};
+            uint64_t no_of_ring_members {0};
+            uint64_t no_of_outputs {0};
+            uint64_t no_of_zero_mixin {0};
+            uint64_t no_of_rounds {0};
+            uint64_t no_of_deduced {0};
+
+            // rings left with no possible outputs, e.g., when their
+            // only one is deduced for another ring, which a valid
+            // chain has not. Each such ring is counted once.
+            uint64_t no_of_conflicts {0};
+        };
+
+        // rings of all key inputs in blocks [h0, h1)
+        bool
+        load(MicroCore& mcore, uint64_t h0, uint64_t h1,
+             bool show_progress = false);
+
+        // deduce till fixed point
+        bool
+        run(RangeExecutor& executor);
+
+        /**
+         * Write deduced real outputs as csv of:
+         *
+         *   key_image,spend_height,amount,global_index,tx_hash,output_index
+         *
+         * in order of inputs in the blockchain.
+         */
+        bool
+        export_csv(MicroCore& mcore, ostream& out) const;
+
+        const reaction_stats&
+        stats() const { return m_stats; }
+
+    private:
+
+        // amount and global index of output id
+        pair<uint64_t, uint64_t>
+        output_of(uint32_t output_id) const;
+
+        // of rings of each key input
+        vector<key_image> m_key_images;
+        vector<uint64_t> m_heights;
+
+        // ring r has members [m_ring_offsets[r], m_ring_offsets[r + 1])
+        vector<uint64_t> m_ring_offsets;
+        vector<uint32_t> m_ring_members;
+
+        // output o is in rings [m_output_offsets[o], m_output_offsets[o + 1])
+        vector<uint64_t> m_output_offsets;
+        vector<uint32_t> m_output_rings;
+
+        // ids of outputs of m_amounts[i] start at m_amount_bases[i]
+        vector<uint64_t> m_amounts;
+        vector<uint64_t> m_amount_bases;
+
+        // deduced output of each ring, or NO_OUTPUT
+        vector<uint32_t> m_real_outputs;
+
+        reaction_stats m_stats;
+    };
+
+}
+
+#endif //XMREG01_CHAINREACTION_H
@@ -0,0 +1,563 @@
+#include "ChainReader.h"
+
+#include <cstring>
+
+namespace xmreg
+{
+
+namespace
+{
+    // address space of our map. it is bigger than the database,
+    // so it rarely needs to grow when monerod adds blocks.
+    const uint64_t READ_MAP_SIZE {1ull << 40};
+}
+
+
+    /**
+     * Open read-only lmdb environment in blockchain_path
+     * and get handles to the tables we read from.
+     *
+     * MDB_NOTLS is used so that read transactions are not
+     * tied to a thread, and a thread can hold more than one.
+     */
+    bool
+    ChainReader::open(const string& blockchain_path)
+    {
+        close();
+
+        int rc;
+
+        if ((rc = mdb_env_create(&m_env)))
+        {
+            cerr << "Cant create lmdb environment: " << mdb_strerror(rc) << endl;
+            m_env = nullptr;
+            return false;
+        }
+
+        // monero's database has less than 20 tables
+        mdb_env_set_maxdbs(m_env, 20);
+
+        mdb_env_set_mapsize(m_env, READ_MAP_SIZE);
+
+        if ((rc = mdb_env_open(m_env, blockchain_path.c_str(),
+                               MDB_RDONLY | MDB_NOTLS, 0644)))
+        {
+            cerr << "Cant open lmdb environment in " << blockchain_path
+                 << ": " << mdb_strerror(rc) << endl;
+            close();
+            return false;
+        }
+
+        MDB_txn* txn;
+
+        if ((rc = mdb_txn_begin(m_env, nullptr, MDB_RDONLY, &txn)))
+        {
+            cerr << "Cant begin lmdb read transaction: " << mdb_strerror(rc) << endl;
+            close();
+            return false;
+        }
+
+        // table names as used by BlockchainLMDB
+        if ((rc = mdb_dbi_open(txn, "blocks", MDB_INTEGERKEY, &m_blocks))
+            || (rc = mdb_dbi_open(txn, "txs", 0, &m_txs))
+            || (rc = mdb_dbi_open(txn, "spent_keys", 0, &m_spent_keys)))
+        {
+            cerr << "Cant open lmdb table: " << mdb_strerror(rc) << endl;
+            mdb_txn_abort(txn);
+            close();
+            return false;
+        }
+
+        // dbi handles opened in a transaction become
+        // available to other transactions only after commit
+        if ((rc = mdb_txn_commit(txn)))
+        {
+            cerr << "Cant commit lmdb read transaction: " << mdb_strerror(rc) << endl;
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Read from blockchain kept in memory, e.g., a synthetic one.
+     */
+    bool
+    ChainReader::open(const MemoryBlockchainDB& memory_db)
+    {
+        close();
+
+        m_memory_db = &memory_db;
+
+        return true;
+    }
+
+
+    /**
+     * Start new read transaction.
+     *
+     * If the database was resized by monerod since we opened
+     * it, pick up the new map size and try again.
+     */
+    bool
+    ChainReader::begin_read(ReadTxn& txn) const
+    {
+        txn.close();
+
+        if (m_memory_db)
+        {
+            txn.m_reader = this;
+            return true;
+        }
+
+        if (!m_env)
+        {
+            cerr << "ChainReader is not open" << endl;
+            return false;
+        }
+
+        lock_guard<mutex> lock {m_txns_mutex};
+
+        int rc = mdb_txn_begin(m_env, nullptr, MDB_RDONLY, &txn.m_txn);
+
+        // lmdb allows to change the map size only
+        // when no txn in the environment is active
+        if (rc == MDB_MAP_RESIZED && m_no_of_txns == 0)
+        {
+            if (!(rc = mdb_env_set_mapsize(m_env, 0)))
+            {
+                rc = mdb_txn_begin(m_env, nullptr, MDB_RDONLY, &txn.m_txn);
+            }
+        }
+
+        if (rc)
+        {
+            cerr << "Cant begin lmdb read transaction: " << mdb_strerror(rc) << endl;
+            txn.m_txn = nullptr;
+            return false;
+        }
+
+        ++m_no_of_txns;
+
+        txn.m_reader = this;
+
+        return true;
+    }
+
+
+    // all read transactions must be closed before
+    void
+    ChainReader::close()
+    {
+        if (m_env)
+        {
+            mdb_env_close(m_env);
+            m_env = nullptr;
+        }
+
+        m_memory_db = nullptr;
+    }
+
+
+    ChainReader::~ChainReader()
+    {
+        close();
+    }
+
+
+    /**
+     * Number of blocks in the blockchain, as seen
+     * by this read transaction.
+     */
+    uint64_t
+    ChainReader::ReadTxn::height()
+    {
+        if (m_reader->m_memory_db)
+        {
+            return m_reader->m_memory_db->height();
+        }
+
+        MDB_stat db_stats;
+
+        if (mdb_stat(m_txn, m_reader->m_blocks, &db_stats))
+        {
+            return 0;
+        }
+
+        return db_stats.ms_entries;
+    }
+
+
+    uint64_t
+    ChainReader::ReadTxn::no_of_txs()
+    {
+        if (m_reader->m_memory_db)
+        {
+            return m_reader->m_memory_db->get_txs().size();
+        }
+
+        MDB_stat db_stats;
+
+        if (mdb_stat(m_txn, m_reader->m_txs, &db_stats))
+        {
+            return 0;
+        }
+
+        return db_stats.ms_entries;
+    }
+
+
+    /**
+     * Position blocks cursor at the given height.
+     *
+     * If the cursor is already at height - 1,
+     * just move it to the next record.
+     */
+    bool
+    ChainReader::ReadTxn::get_block_val(const uint64_t& height, MDB_val& v)
+    {
+        int rc;
+
+        if (!m_blocks_cur)
+        {
+            if ((rc = mdb_cursor_open(m_txn, m_reader->m_blocks, &m_blocks_cur)))
+            {
+                cerr << "Cant open cursor for blocks: " << mdb_strerror(rc) << endl;
+                return false;
+            }
+        }
+
+        MDB_val k;
+
+        if (m_cur_valid && height == m_cur_height + 1)
+        {
+            rc = mdb_cursor_get(m_blocks_cur, &k, &v, MDB_NEXT);
+
+            // keys are heights, so we expect no gaps. but
+            // just in case, fall back to a seek below.
+            if (rc == 0 && *static_cast<const uint64_t*>(k.mv_data) != height)
+            {
+                rc = MDB_NOTFOUND;
+            }
+        }
+        else
+        {
+            rc = MDB_NOTFOUND;
+        }
+
+        if (rc)
+        {
+            uint64_t key = height;
+
+            k.mv_size = sizeof(key);
+            k.mv_data = &key;
+
+            rc = mdb_cursor_get(m_blocks_cur, &k, &v, MDB_SET);
+        }
+
+        if (rc)
+        {
+            m_cur_valid = false;
+
+            if (rc != MDB_NOTFOUND)
+            {
+                cerr << "Cant read block " << height << ": "
+                     << mdb_strerror(rc) << endl;
+            }
+
+            return false;
+        }
+
+        m_cur_height = height;
+        m_cur_valid  = true;
+
+        return true;
+    }
+
+
+    bool
+    ChainReader::ReadTxn::get_tx_val(const crypto::hash& tx_hash, MDB_val& v)
+    {
+        int rc;
+
+        if (!m_txs_cur)
+        {
+            if ((rc = mdb_cursor_open(m_txn, m_reader->m_txs, &m_txs_cur)))
+            {
+                cerr << "Cant open cursor for txs: " << mdb_strerror(rc) << endl;
+                return false;
+            }
+        }
+
+        MDB_val k {sizeof(tx_hash), const_cast<crypto::hash*>(&tx_hash)};
+
+        if ((rc = mdb_cursor_get(m_txs_cur, &k, &v, MDB_SET)))
+        {
+            if (rc != MDB_NOTFOUND)
+            {
+                cerr << "Cant read tx " << tx_hash << ": "
+                     << mdb_strerror(rc) << endl;
+            }
+
+            return false;
+        }
+
+        return true;
+    }
+
+
+    bool
+    ChainReader::ReadTxn::get_block_blob(const uint64_t& height, blob_view& blob)
+    {
+        if (m_reader->m_memory_db)
+        {
+            return m_reader->m_memory_db->get_block_blob(height, blob);
+        }
+
+        MDB_val v;
+
+        if (!get_block_val(height, v))
+        {
+            return false;
+        }
+
+        blob = blob_view {static_cast<const char*>(v.mv_data), v.mv_size};
+
+        return true;
+    }
+
+
+    bool
+    ChainReader::ReadTxn::get_tx_blob(const crypto::hash& tx_hash, blob_view& blob)
+    {
+        if (m_reader->m_memory_db)
+        {
+            return m_reader->m_memory_db->get_tx_blob(tx_hash, blob);
+        }
+
+        MDB_val v;
+
+        if (!get_tx_val(tx_hash, v))
+        {
+            return false;
+        }
+
+        blob = blob_view {static_cast<const char*>(v.mv_data), v.mv_size};
+
+        return true;
+    }
+
+
+    /**
+     * Walk the txs table in its key order, i.e., order of tx hashes,
+     * which is the order Blockchain::for_all_transactions uses.
+     *
+     * The first call returns the first tx. Note that get_tx_blob
+     * moves the same cursor.
+     *
+     * Returns false at the end of the table.
+     */
+    bool
+    ChainReader::ReadTxn::get_next_tx_blob(crypto::hash& tx_hash, blob_view& blob)
+    {
+        if (m_reader->m_memory_db)
+        {
+            const MemoryBlockchainDB::txs_map& txs = m_reader->m_memory_db->get_txs();
+
+            if (!m_mem_tx_it_valid)
+            {
+                m_mem_tx_it = txs.begin();
+                m_mem_tx_it_valid = true;
+            }
+            else if (m_mem_tx_it != txs.end())
+            {
+                ++m_mem_tx_it;
+            }
+
+            if (m_mem_tx_it == txs.end())
+            {
+                return false;
+            }
+
+            tx_hash = m_mem_tx_it->first;
+            blob    = blob_view {m_mem_tx_it->second.blob.data(),
+                                 m_mem_tx_it->second.blob.size()};
+
+            return true;
+        }
+
+        int rc;
+
+        if (!m_txs_cur)
+        {
+            if ((rc = mdb_cursor_open(m_txn, m_reader->m_txs, &m_txs_cur)))
+            {
+                cerr << "Cant open cursor for txs: " << mdb_strerror(rc) << endl;
+                return false;
+            }
+        }
+
+        MDB_val k, v;
+
+        // MDB_NEXT on a fresh cursor gives the first record
+        if ((rc = mdb_cursor_get(m_txs_cur, &k, &v, MDB_NEXT)))
+        {
+            if (rc != MDB_NOTFOUND)
+            {
+                cerr << "Cant read next tx: " << mdb_strerror(rc) << endl;
+            }
+
+            return false;
+        }
+
+        tx_hash = *static_cast<const crypto::hash*>(k.mv_data);
+        blob    = blob_view {static_cast<const char*>(v.mv_data), v.mv_size};
+
+        return true;
+    }
+
+
+    int
+    ChainReader::ReadTxn::compare_tx_hashes(const crypto::hash& a,
+                                            const crypto::hash& b) const
+    {
+        if (m_reader->m_memory_db)
+        {
+            return memcmp(&a, &b, sizeof(crypto::hash));
+        }
+
+        MDB_val va {sizeof(a), const_cast<crypto::hash*>(&a)};
+        MDB_val vb {sizeof(b), const_cast<crypto::hash*>(&b)};
+
+        return mdb_cmp(m_txn, m_reader->m_txs, &va, &vb);
+    }
+
+
+    /**
+     * Look up a key image with the transaction's cursor, so that many
+     * of them, e.g., sorted ones, are checked in one snapshot and
+     * without a new read transaction for each, as
+     * have_tx_keyimg_as_spent does.
+     */
+    bool
+    ChainReader::ReadTxn::is_spent(const key_image& k_image, bool& spent)
+    {
+        if (m_reader->m_memory_db)
+        {
+            spent = m_reader->m_memory_db->has_key_image(k_image);
+            return true;
+        }
+
+        int rc;
+
+        if (!m_spent_keys_cur)
+        {
+            if ((rc = mdb_cursor_open(m_txn, m_reader->m_spent_keys, &m_spent_keys_cur)))
+            {
+                cerr << "Cant open cursor for spent keys: " << mdb_strerror(rc) << endl;
+                return false;
+            }
+        }
+
+        MDB_val k {sizeof(k_image), const_cast<key_image*>(&k_image)};
+        MDB_val v;
+
+        rc = mdb_cursor_get(m_spent_keys_cur, &k, &v, MDB_SET);
+
+        if (rc && rc != MDB_NOTFOUND)
+        {
+            cerr << "Cant read key image " << k_image << ": "
+                 << mdb_strerror(rc) << endl;
+            return false;
+        }
+
+        spent = rc == 0;
+
+        return true;
+    }
+
+
+    bool
+    ChainReader::ReadTxn::get_block(const uint64_t& height, block& blk)
+    {
+        blob_view blob;
+
+        if (!get_block_blob(height, blob))
+        {
+            return false;
+        }
+
+        if (!parse_block_from_view(blob, blk))
+        {
+            cerr << "Cant parse block of height: " << height << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    bool
+    ChainReader::ReadTxn::get_tx(const crypto::hash& tx_hash, transaction& tx)
+    {
+        blob_view blob;
+
+        if (!get_tx_blob(tx_hash, blob))
+        {
+            return false;
+        }
+
+        if (!parse_tx_from_view(blob, tx))
+        {
+            cerr << "Cant parse tx: " << tx_hash << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    void
+    ChainReader::ReadTxn::close()
+    {
+        if (m_blocks_cur)
+        {
+            mdb_cursor_close(m_blocks_cur);
+            m_blocks_cur = nullptr;
+        }
+
+        if (m_txs_cur)
+        {
+            mdb_cursor_close(m_txs_cur);
+            m_txs_cur = nullptr;
+        }
+
+        if (m_spent_keys_cur)
+        {
+            mdb_cursor_close(m_spent_keys_cur);
+            m_spent_keys_cur = nullptr;
+        }
+
+        if (m_txn)
+        {
+            mdb_txn_abort(m_txn);
+            m_txn = nullptr;
+
+            lock_guard<mutex> lock {m_reader->m_txns_mutex};
+            --m_reader->m_no_of_txns;
+        }
+
+        m_reader = nullptr;
+        m_cur_valid = false;
+        m_mem_tx_it_valid = false;
+    }
+
+
+    ChainReader::ReadTxn::~ReadTxn()
+    {
+        close();
+    }
+
+}
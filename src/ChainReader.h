@@ -0,0 +1,161 @@
+#ifndef XMREG01_CHAINREADER_H
+#define XMREG01_CHAINREADER_H
+
+#include "monero_headers.h"
+#include "tools.h"
+#include "MemoryBlockchainDB.h"
+
+#include <iostream>
+#include <mutex>
+#include <string>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    /**
+     * Direct, read-only access to the tables of the
+     * lmdb blockchain database.
+     *
+     * BlockchainLMDB starts a new read transaction for every
+     * get_* call and looks up each key from the root of the tree.
+     * For bulk reads it is much cheaper to start one read transaction,
+     * keep cursors open on the tables and walk them in key order.
+     *
+     * ChainReader opens its own MDB_env on the lmdb folder in
+     * MDB_RDONLY mode, next to the one used by Blockchain. Closing
+     * an environment drops locks the process holds on its lock file,
+     * so ours must be closed only after the one of BlockchainLMDB.
+     *
+     * It can also read from MemoryBlockchainDB, so that
+     * everything built on it works with synthetic chains.
+     */
+    class ChainReader
+    {
+        MDB_env* m_env {nullptr};
+
+        const MemoryBlockchainDB* m_memory_db {nullptr};
+
+        MDB_dbi m_blocks;
+        MDB_dbi m_txs;
+        MDB_dbi m_spent_keys;
+
+        // map can be resized only when none of our txns is active
+        mutable mutex m_txns_mutex;
+        mutable size_t m_no_of_txns {0};
+
+    public:
+
+        /**
+         * A read transaction on the ChainReader's environment.
+         *
+         * Cursors are opened lazily and kept for the
+         * lifetime of the transaction. Reading blocks at
+         * consecutive heights moves the blocks cursor with MDB_NEXT
+         * rather than seeking from the root for every block.
+         *
+         * blob_views returned point into the lmdb memory map
+         * and are valid only until the transaction is closed.
+         */
+        class ReadTxn
+        {
+            friend class ChainReader;
+
+            const ChainReader* m_reader {nullptr};
+
+            MDB_txn* m_txn {nullptr};
+
+            MDB_cursor* m_blocks_cur {nullptr};
+            MDB_cursor* m_txs_cur {nullptr};
+            MDB_cursor* m_spent_keys_cur {nullptr};
+
+            // height of the last block read by the blocks cursor
+            uint64_t m_cur_height {0};
+            bool m_cur_valid {false};
+
+            // txs "cursor" for MemoryBlockchainDB
+            MemoryBlockchainDB::txs_map::const_iterator m_mem_tx_it;
+            bool m_mem_tx_it_valid {false};
+
+        public:
+            ReadTxn() = default;
+
+            ReadTxn(const ReadTxn&) = delete;
+            ReadTxn& operator=(const ReadTxn&) = delete;
+
+            bool
+            is_open() const { return m_reader != nullptr; }
+
+            uint64_t
+            height();
+
+            uint64_t
+            no_of_txs();
+
+            bool
+            get_block_blob(const uint64_t& height, blob_view& blob);
+
+            bool
+            get_tx_blob(const crypto::hash& tx_hash, blob_view& blob);
+
+            bool
+            get_next_tx_blob(crypto::hash& tx_hash, blob_view& blob);
+
+            // <0, 0 or >0 as a is before, at or after
+            // b in the key order of the txs table
+            int
+            compare_tx_hashes(const crypto::hash& a, const crypto::hash& b) const;
+
+            // spent is set if k_image is in the spent keys table.
+            // false is returned only if it could not be read.
+            bool
+            is_spent(const key_image& k_image, bool& spent);
+
+            bool
+            get_block(const uint64_t& height, block& blk);
+
+            bool
+            get_tx(const crypto::hash& tx_hash, transaction& tx);
+
+            void
+            close();
+
+            ~ReadTxn();
+
+        private:
+            bool
+            get_block_val(const uint64_t& height, MDB_val& v);
+
+            bool
+            get_tx_val(const crypto::hash& tx_hash, MDB_val& v);
+        };
+
+
+        ChainReader() = default;
+
+        ChainReader(const ChainReader&) = delete;
+        ChainReader& operator=(const ChainReader&) = delete;
+
+        bool
+        open(const string& blockchain_path);
+
+        bool
+        open(const MemoryBlockchainDB& memory_db);
+
+        bool
+        is_open() const { return m_env != nullptr || m_memory_db != nullptr; }
+
+        bool
+        begin_read(ReadTxn& txn) const;
+
+        void
+        close();
+
+        ~ChainReader();
+    };
+
+}
+
+#endif //XMREG01_CHAINREADER_H
@@ -0,0 +1,84 @@
+#ifndef XMREG01_CHAINVISITOR_H
+#define XMREG01_CHAINVISITOR_H
+
+#include "monero_headers.h"
+#include "tools.h"
+
+#include <memory>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    /**
+     * Parts of blocks and txs a ChainVisitor needs.
+     * Each is read or parsed only if some visitor needs it.
+     */
+    enum visit_field : uint32_t
+    {
+        VISIT_BLOCK     = 1 << 0,   // block header and its tx hashes
+        VISIT_TX_BLOB   = 1 << 1,   // tx blob view
+        VISIT_TX_PREFIX = 1 << 2,   // tx parsed without signatures
+        VISIT_TX        = 1 << 3    // tx parsed with signatures
+    };
+
+
+    /**
+     * What a visitor gets for each tx. Pointers to
+     * fields it did not ask for are nullptr.
+     *
+     * All of it is valid only during the visit_tx call.
+     */
+    struct tx_visit
+    {
+        uint64_t height;
+
+        const crypto::hash* tx_hash;
+
+        bool is_coinbase;
+
+        const blob_view* blob;
+
+        const transaction_prefix* prefix;
+
+        const transaction* tx;
+    };
+
+
+    /**
+     * Analysis run on a pass over the blockchain together
+     * with other ones, by MicroCore::visit_chain.
+     *
+     * The pass is split into height ranges visited in parallel.
+     * For each range, a new visitor is made with fork(), and when
+     * all are done, they are merged into the original one in
+     * height order, so merge can just append results.
+     */
+    class ChainVisitor
+    {
+    public:
+
+        // or-ed visit_field values
+        virtual uint32_t
+        fields() const = 0;
+
+        virtual unique_ptr<ChainVisitor>
+        fork() const = 0;
+
+        virtual void
+        merge(ChainVisitor& range_visitor) = 0;
+
+        virtual void
+        visit_block(const uint64_t& height, const block& blk) {}
+
+        virtual void
+        visit_tx(const tx_visit& tx) {}
+
+        virtual ~ChainVisitor() = default;
+    };
+
+}
+
+#endif //XMREG01_CHAINVISITOR_H
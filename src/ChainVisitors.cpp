@@ -0,0 +1,143 @@
+#include "ChainVisitors.h"
+
+namespace xmreg
+{
+
+    unique_ptr<ChainVisitor>
+    ChainStatsVisitor::fork() const
+    {
+        return unique_ptr<ChainVisitor> {new ChainStatsVisitor()};
+    }
+
+
+    void
+    ChainStatsVisitor::merge(ChainVisitor& range_visitor)
+    {
+        ChainStatsVisitor& other = static_cast<ChainStatsVisitor&>(range_visitor);
+
+        no_of_blocks  += other.no_of_blocks;
+        no_of_txs     += other.no_of_txs;
+        no_of_inputs  += other.no_of_inputs;
+        no_of_outputs += other.no_of_outputs;
+        tx_bytes      += other.tx_bytes;
+    }
+
+
+    void
+    ChainStatsVisitor::visit_block(const uint64_t& height, const block& blk)
+    {
+        ++no_of_blocks;
+    }
+
+
+    void
+    ChainStatsVisitor::visit_tx(const tx_visit& tx)
+    {
+        ++no_of_txs;
+
+        no_of_inputs  += tx.prefix->vin.size();
+        no_of_outputs += tx.prefix->vout.size();
+        tx_bytes      += tx.blob->size;
+    }
+
+
+
+    OwnedOutputsVisitor::OwnedOutputsVisitor(const secret_key& private_view_key,
+                                             const public_key& public_spend_key)
+            : m_private_view_key {private_view_key},
+              m_public_spend_key {public_spend_key}
+    {}
+
+
+    unique_ptr<ChainVisitor>
+    OwnedOutputsVisitor::fork() const
+    {
+        return unique_ptr<ChainVisitor> {
+                new OwnedOutputsVisitor(m_private_view_key, m_public_spend_key)};
+    }
+
+
+    void
+    OwnedOutputsVisitor::merge(ChainVisitor& range_visitor)
+    {
+        OwnedOutputsVisitor& other = static_cast<OwnedOutputsVisitor&>(range_visitor);
+
+        outputs.insert(outputs.end(), other.outputs.begin(), other.outputs.end());
+    }
+
+
+    void
+    OwnedOutputsVisitor::visit_tx(const tx_visit& tx)
+    {
+        const transaction_prefix& prefix = *tx.prefix;
+
+        vector<public_key> output_keys;
+
+        output_keys.reserve(prefix.vout.size());
+
+        for (const tx_out& out: prefix.vout)
+        {
+            output_keys.push_back(out.target.type() == typeid(txout_to_key)
+                                  ? boost::get<txout_to_key>(out.target).key
+                                  : null_pkey);
+        }
+
+        for (size_t i: get_belonging_output_indices(scan_tx_pub_key(prefix.extra),
+                                                    output_keys.data(),
+                                                    output_keys.size(),
+                                                    m_private_view_key,
+                                                    m_public_spend_key))
+        {
+            outputs.push_back(owned_output {tx.height, *tx.tx_hash, i,
+                                            prefix.vout[i].amount, output_keys[i]});
+        }
+    }
+
+
+
+    KeyImagesVisitor::KeyImagesVisitor(const vector<key_image>& key_images)
+            : m_key_images {make_shared<unordered_set<key_image>>(key_images.begin(),
+                                                                  key_images.end())}
+    {}
+
+
+    unique_ptr<ChainVisitor>
+    KeyImagesVisitor::fork() const
+    {
+        unique_ptr<KeyImagesVisitor> forked {new KeyImagesVisitor(vector<key_image> {})};
+
+        forked->m_key_images = m_key_images;
+
+        return std::move(forked);
+    }
+
+
+    void
+    KeyImagesVisitor::merge(ChainVisitor& range_visitor)
+    {
+        KeyImagesVisitor& other = static_cast<KeyImagesVisitor&>(range_visitor);
+
+        txs_found.insert(other.txs_found.begin(), other.txs_found.end());
+    }
+
+
+    void
+    KeyImagesVisitor::visit_tx(const tx_visit& tx)
+    {
+        for (const txin_v& in: tx.prefix->vin)
+        {
+            if (in.type() != typeid(txin_to_key))
+            {
+                continue;
+            }
+
+            const key_image& k_image = boost::get<txin_to_key>(in).k_image;
+
+            if (m_key_images->count(k_image))
+            {
+                txs_found[k_image] = *tx.tx_hash;
+            }
+        }
+    }
+
+}
@@ -0,0 +1,107 @@
+#ifndef XMREG01_CHAINVISITORS_H
+#define XMREG01_CHAINVISITORS_H
+
+#include "ChainVisitor.h"
+#include "tx_details.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+
+    /**
+     * Counts of blocks, txs, inputs and outputs, and
+     * sizes of tx blobs in the visited blocks.
+     */
+    class ChainStatsVisitor : public ChainVisitor
+    {
+    public:
+
+        uint64_t no_of_blocks {0};
+        uint64_t no_of_txs {0};
+        uint64_t no_of_inputs {0};
+        uint64_t no_of_outputs {0};
+        uint64_t tx_bytes {0};
+
+        uint32_t
+        fields() const override { return VISIT_BLOCK | VISIT_TX_BLOB | VISIT_TX_PREFIX; }
+
+        unique_ptr<ChainVisitor>
+        fork() const override;
+
+        void
+        merge(ChainVisitor& range_visitor) override;
+
+        void
+        visit_block(const uint64_t& height, const block& blk) override;
+
+        void
+        visit_tx(const tx_visit& tx) override;
+    };
+
+
+    /**
+     * Outputs which belong to the given address.
+     */
+    class OwnedOutputsVisitor : public ChainVisitor
+    {
+        secret_key m_private_view_key;
+        public_key m_public_spend_key;
+
+    public:
+
+        vector<owned_output> outputs;
+
+        OwnedOutputsVisitor(const secret_key& private_view_key,
+                            const public_key& public_spend_key);
+
+        uint32_t
+        fields() const override { return VISIT_TX_PREFIX; }
+
+        unique_ptr<ChainVisitor>
+        fork() const override;
+
+        void
+        merge(ChainVisitor& range_visitor) override;
+
+        void
+        visit_tx(const tx_visit& tx) override;
+    };
+
+
+    /**
+     * Txs having any of the given key images.
+     */
+    class KeyImagesVisitor : public ChainVisitor
+    {
+        // shared by all forks, as it is only read
+        shared_ptr<const unordered_set<key_image>> m_key_images;
+
+    public:
+
+        unordered_map<key_image, crypto::hash> txs_found;
+
+        explicit KeyImagesVisitor(const vector<key_image>& key_images);
+
+        uint32_t
+        fields() const override { return VISIT_TX_PREFIX; }
+
+        unique_ptr<ChainVisitor>
+        fork() const override;
+
+        void
+        merge(ChainVisitor& range_visitor) override;
+
+        void
+        visit_tx(const tx_visit& tx) override;
+    };
+
+}
+
+#endif //XMREG01_CHAINVISITORS_H
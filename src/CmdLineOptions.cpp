@@ -30,13 +30,85 @@ namespace xmreg
                 ("spendkey,s", value<string>(),
                  "private spend key string")
                 ("find-tx,f", value<bool>()->default_value(false)->implicit_value(true),
-                 "find transaction containing key generated if it is spend (time consuming search)")
+                 "find transaction containing key generated if it is spend (time consuming search), and verify that its ring signature is ours")
                 ("address,a", value<string>(),
                  "monero address string")
                 ("bc-path,b", value<string>(),
                  "path to lmdb blockchain")
                 ("testnet",  value<bool>()->default_value(false)->implicit_value(true),
-                 "is the address from testnet network");
+                 "is the address from testnet network")
+                ("prefetch-window", value<size_t>()->default_value(0),
+                 "number of txs to read ahead of chain scans, e.g., when blockchain is not in page cache (0 - disabled)")
+                ("synthetic-blocks", value<size_t>()->default_value(0),
+                 "run on synthetic blockchain of this many blocks kept in memory, with its test wallet, instead of lmdb one (0 - disabled)")
+                ("synthetic-seed", value<size_t>()->default_value(1),
+                 "seed of the synthetic blockchain")
+                ("synthetic-signatures", value<bool>()->default_value(false)->implicit_value(true),
+                 "make real ring signatures in the synthetic blockchain, which is much slower. always done with verify and find-tx, as they check them")
+                ("sidecar-path", value<string>(),
+                 "path to scan sidecar folder, used for find-tx and report before scanning the blockchain")
+                ("build-sidecar", value<bool>()->default_value(false)->implicit_value(true),
+                 "create or update scan sidecar in sidecar-path up to the current blockchain height")
+                ("block-summary-path", value<string>(),
+                 "path to block summary file, used to split parallel scans into parts of equal work and to estimate their time left")
+                ("build-block-summary", value<bool>()->default_value(false)->implicit_value(true),
+                 "create or update block summary in block-summary-path up to the current blockchain height")
+                ("follow", value<bool>()->default_value(false)->implicit_value(true),
+                 "keep running and report outputs received and spent in new blocks as they are added")
+                ("serve", value<bool>()->default_value(false)->implicit_value(true),
+                 "keep running and answer queries on a unix socket")
+                ("socket-path", value<string>()->default_value("checkoutputs.sock"),
+                 "path to unix socket of serve mode")
+                ("serve-threads", value<size_t>()->default_value(4),
+                 "number of workers answering queries in serve mode")
+                ("search-timeout", value<size_t>()->default_value(0),
+                 "time limit, in ms, of find-tx search in the blockchain, after which blocks checked so far are shown (0 - no limit)")
+                ("batch", value<string>(),
+                 "file with lines of: tx_hash [address viewkey [spendkey]] to check, or - for stdin. results are printed as csv")
+                ("report", value<bool>()->default_value(false)->implicit_value(true),
+                 "print csv with spent status of all outputs of the address. with find-tx, also their spending txs")
+                ("chain-stats", value<bool>()->default_value(false)->implicit_value(true),
+                 "print numbers of blocks, txs, inputs and outputs, together with outputs of the address, in one blockchain pass")
+                ("chain-reaction", value<bool>()->default_value(false)->implicit_value(true),
+                 "print csv of key images with real outputs they spend, deduced from zero mixin inputs and rings left with one possible output")
+                ("verify", value<bool>()->default_value(false)->implicit_value(true),
+                 "check ring signatures of all inputs in blocks from-height to to-height, and print failures as csv")
+                ("from-height", value<size_t>()->default_value(0),
+                 "first block to verify")
+                ("to-height", value<size_t>()->default_value(0),
+                 "block after the last one to verify. 0 is the current blockchain height")
+                ("wallets", value<string>(),
+                 "file with lines of: address viewkey. outputs of all of them are found by worker processes and printed as csv")
+                ("workers", value<size_t>()->default_value(1),
+                 "number of local worker processes for wallets")
+                ("worker-hosts", value<string>(),
+                 "comma separated ssh hosts to run more workers on. they need the same blockchain and work-dir")
+                ("work-dir", value<string>()->default_value("scan_units"),
+                 "folder for result files of work units")
+                ("unit-blocks", value<size_t>()->default_value(10000),
+                 "number of blocks in a work unit. units start at its multiples")
+                ("payment-id-index", value<string>(),
+                 "path to payment id index folder")
+                ("build-payment-id-index", value<bool>()->default_value(false)->implicit_value(true),
+                 "create or update payment id index in payment-id-index up to the current blockchain height")
+                ("payment-ids", value<string>(),
+                 "file with payment ids, one per line, to find txs of in payment-id-index, or - for stdin. 16 character ones are decrypted with the viewkey. results are printed as csv")
+                ("output-key-index", value<string>(),
+                 "path to output public key index folder")
+                ("build-output-key-index", value<bool>()->default_value(false)->implicit_value(true),
+                 "create or update output key index in output-key-index up to the current blockchain height")
+                ("output-keys", value<string>(),
+                 "file with output public keys, one per line, to find txs of in output-key-index, or - for stdin. results are printed as csv")
+                ("ring-member-index", value<string>(),
+                 "path to ring member index folder")
+                ("build-ring-member-index", value<bool>()->default_value(false)->implicit_value(true),
+                 "create or update ring member index in ring-member-index up to the current blockchain height")
+                ("ring-uses", value<string>(),
+                 "file with outputs, one per line as tx hash and output index, to find inputs having them in their rings in ring-member-index, or - for stdin. results are printed as csv")
+                ("worker-unit", value<string>(),
+                 "used by coordinator: scan blocks h0:h1 as a worker")
+                ("unit-output", value<string>(),
+                 "used by coordinator: result file of worker-unit");
 
 
         store(command_line_parser(acc, avv)
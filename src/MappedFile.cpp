@@ -0,0 +1,83 @@
+#include "MappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+namespace xmreg
+{
+
+    bool
+    MappedFile::open(const string& file_path)
+    {
+        close();
+
+        m_fd = ::open(file_path.c_str(), O_RDONLY);
+
+        if (m_fd < 0)
+        {
+            cerr << "Cant open " << file_path << ": " << strerror(errno) << endl;
+            return false;
+        }
+
+        struct stat st;
+
+        if (fstat(m_fd, &st) != 0)
+        {
+            cerr << "Cant stat " << file_path << ": " << strerror(errno) << endl;
+            close();
+            return false;
+        }
+
+        m_size = static_cast<size_t>(st.st_size);
+
+        if (m_size == 0)
+        {
+            return true;
+        }
+
+        void* addr = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+
+        if (addr == MAP_FAILED)
+        {
+            cerr << "Cant mmap " << file_path << ": " << strerror(errno) << endl;
+            close();
+            return false;
+        }
+
+        m_data = static_cast<const char*>(addr);
+
+        return true;
+    }
+
+
+    void
+    MappedFile::close()
+    {
+        if (m_data)
+        {
+            munmap(const_cast<char*>(m_data), m_size);
+            m_data = nullptr;
+        }
+
+        if (m_fd >= 0)
+        {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+
+        m_size = 0;
+    }
+
+
+    MappedFile::~MappedFile()
+    {
+        close();
+    }
+
+}
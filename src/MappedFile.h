@@ -0,0 +1,51 @@
+#ifndef XMREG01_MAPPEDFILE_H
+#define XMREG01_MAPPEDFILE_H
+
+#include <string>
+
+namespace xmreg
+{
+    using namespace std;
+
+    /**
+     * Whole file memory mapped read-only.
+     *
+     * Used for sidecar files we scan at memory bandwidth.
+     * Empty file maps to nullptr of size 0.
+     */
+    class MappedFile
+    {
+        int m_fd {-1};
+
+        const char* m_data {nullptr};
+
+        size_t m_size {0};
+
+    public:
+        MappedFile() = default;
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool
+        open(const string& file_path);
+
+        void
+        close();
+
+        const char*
+        data() const { return m_data; }
+
+        size_t
+        size() const { return m_size; }
+
+        template <typename T>
+        const T*
+        as() const { return reinterpret_cast<const T*>(m_data); }
+
+        ~MappedFile();
+    };
+
+}
+
+#endif //XMREG01_MAPPEDFILE_H
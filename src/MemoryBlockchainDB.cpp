@@ -0,0 +1,820 @@
+#include "MemoryBlockchainDB.h"
+
+namespace xmreg
+{
+
+    bool
+    MemoryBlockchainDB::get_block_blob(const uint64_t& height, blob_view& blob) const
+    {
+        if (height >= m_blocks.size())
+        {
+            return false;
+        }
+
+        const blobdata& blk_blob = m_blocks[height].blob;
+
+        blob = blob_view {blk_blob.data(), blk_blob.size()};
+
+        return true;
+    }
+
+
+    bool
+    MemoryBlockchainDB::get_tx_blob(const crypto::hash& h, blob_view& blob) const
+    {
+        auto it = m_txs.find(h);
+
+        if (it == m_txs.end())
+        {
+            return false;
+        }
+
+        blob = blob_view {it->second.blob.data(), it->second.blob.size()};
+
+        return true;
+    }
+
+
+    void
+    MemoryBlockchainDB::open(const std::string& filename, const int db_flags)
+    {
+        m_open = true;
+    }
+
+
+    void
+    MemoryBlockchainDB::close()
+    {
+        m_open = false;
+    }
+
+
+    void
+    MemoryBlockchainDB::sync()
+    {}
+
+
+    void
+    MemoryBlockchainDB::reset()
+    {
+        m_blocks.clear();
+        m_block_heights.clear();
+        m_txs.clear();
+        m_outputs.clear();
+        m_amount_outputs.clear();
+        m_spent_keys.clear();
+        m_hf_starting_heights.clear();
+        m_hf_versions.clear();
+    }
+
+
+    std::vector<std::string>
+    MemoryBlockchainDB::get_filenames() const
+    {
+        return {};
+    }
+
+
+    std::string
+    MemoryBlockchainDB::get_db_name() const
+    {
+        return "memory";
+    }
+
+
+    bool
+    MemoryBlockchainDB::lock()
+    {
+        return true;
+    }
+
+
+    void
+    MemoryBlockchainDB::unlock()
+    {}
+
+
+    bool
+    MemoryBlockchainDB::batch_start(uint64_t batch_num_blocks)
+    {
+        return true;
+    }
+
+
+    void
+    MemoryBlockchainDB::batch_commit()
+    {}
+
+
+    void
+    MemoryBlockchainDB::batch_stop()
+    {}
+
+
+    void
+    MemoryBlockchainDB::set_batch_transactions(bool batch_transactions)
+    {}
+
+
+    void
+    MemoryBlockchainDB::block_txn_start(bool readonly)
+    {}
+
+
+    void
+    MemoryBlockchainDB::block_txn_stop()
+    {}
+
+
+    void
+    MemoryBlockchainDB::block_txn_abort()
+    {}
+
+
+    /**
+     * Same as BlockchainDB::add_block, except that hard fork
+     * info is updated only if Blockchain already set it, so that
+     * blocks can be added before Blockchain::init is called.
+     */
+    uint64_t
+    MemoryBlockchainDB::add_block(const block& blk,
+                                  const size_t& block_size,
+                                  const difficulty_type& cumulative_difficulty,
+                                  const uint64_t& coins_generated,
+                                  const std::vector<transaction>& txs)
+    {
+        crypto::hash blk_hash = get_block_hash(blk);
+
+        add_block(blk, block_size, cumulative_difficulty, coins_generated, blk_hash);
+
+        add_transaction(blk_hash, blk.miner_tx);
+
+        for (size_t i = 0; i < txs.size(); ++i)
+        {
+            add_transaction(blk_hash, txs[i], &blk.tx_hashes[i]);
+        }
+
+        uint64_t blk_height = m_blocks.size() - 1;
+
+        if (m_hardfork)
+        {
+            m_hardfork->add(blk, blk_height);
+        }
+
+        return blk_height;
+    }
+
+
+    bool
+    MemoryBlockchainDB::block_exists(const crypto::hash& h) const
+    {
+        return m_block_heights.count(h) > 0;
+    }
+
+
+    block
+    MemoryBlockchainDB::get_block(const crypto::hash& h) const
+    {
+        return get_block_from_height(get_block_height(h));
+    }
+
+
+    uint64_t
+    MemoryBlockchainDB::get_block_height(const crypto::hash& h) const
+    {
+        auto it = m_block_heights.find(h);
+
+        if (it == m_block_heights.end())
+        {
+            throw BLOCK_DNE("Attempted to retrieve non-existent block height");
+        }
+
+        return it->second;
+    }
+
+
+    block_header
+    MemoryBlockchainDB::get_block_header(const crypto::hash& h) const
+    {
+        return get_block(h);
+    }
+
+
+    block
+    MemoryBlockchainDB::get_block_from_height(const uint64_t& height) const
+    {
+        block blk;
+
+        if (!parse_and_validate_block_from_blob(get_block_data(height).blob, blk))
+        {
+            throw DB_ERROR("Failed to parse block from blob retrieved from the db");
+        }
+
+        return blk;
+    }
+
+
+    uint64_t
+    MemoryBlockchainDB::get_block_timestamp(const uint64_t& height) const
+    {
+        return get_block_data(height).timestamp;
+    }
+
+
+    uint64_t
+    MemoryBlockchainDB::get_top_block_timestamp() const
+    {
+        if (m_blocks.empty())
+        {
+            return 0;
+        }
+
+        return m_blocks.back().timestamp;
+    }
+
+
+    size_t
+    MemoryBlockchainDB::get_block_size(const uint64_t& height) const
+    {
+        return get_block_data(height).size;
+    }
+
+
+    difficulty_type
+    MemoryBlockchainDB::get_block_cumulative_difficulty(const uint64_t& height) const
+    {
+        return get_block_data(height).cumulative_difficulty;
+    }
+
+
+    difficulty_type
+    MemoryBlockchainDB::get_block_difficulty(const uint64_t& height) const
+    {
+        difficulty_type diff = get_block_cumulative_difficulty(height);
+
+        if (height != 0)
+        {
+            diff -= get_block_cumulative_difficulty(height - 1);
+        }
+
+        return diff;
+    }
+
+
+    uint64_t
+    MemoryBlockchainDB::get_block_already_generated_coins(const uint64_t& height) const
+    {
+        return get_block_data(height).coins_generated;
+    }
+
+
+    crypto::hash
+    MemoryBlockchainDB::get_block_hash_from_height(const uint64_t& height) const
+    {
+        return get_block_data(height).hash;
+    }
+
+
+    std::vector<block>
+    MemoryBlockchainDB::get_blocks_range(const uint64_t& h1, const uint64_t& h2) const
+    {
+        std::vector<block> blks;
+
+        for (uint64_t height = h1; height <= h2; ++height)
+        {
+            blks.push_back(get_block_from_height(height));
+        }
+
+        return blks;
+    }
+
+
+    std::vector<crypto::hash>
+    MemoryBlockchainDB::get_hashes_range(const uint64_t& h1, const uint64_t& h2) const
+    {
+        std::vector<crypto::hash> hashes;
+
+        for (uint64_t height = h1; height <= h2; ++height)
+        {
+            hashes.push_back(get_block_hash_from_height(height));
+        }
+
+        return hashes;
+    }
+
+
+    crypto::hash
+    MemoryBlockchainDB::top_block_hash() const
+    {
+        if (m_blocks.empty())
+        {
+            return null_hash;
+        }
+
+        return m_blocks.back().hash;
+    }
+
+
+    block
+    MemoryBlockchainDB::get_top_block() const
+    {
+        if (m_blocks.empty())
+        {
+            return block {};
+        }
+
+        return get_block_from_height(m_blocks.size() - 1);
+    }
+
+
+    uint64_t
+    MemoryBlockchainDB::height() const
+    {
+        return m_blocks.size();
+    }
+
+
+    bool
+    MemoryBlockchainDB::tx_exists(const crypto::hash& h) const
+    {
+        return m_txs.count(h) > 0;
+    }
+
+
+    uint64_t
+    MemoryBlockchainDB::get_tx_unlock_time(const crypto::hash& h) const
+    {
+        return get_tx_data(h).unlock_time;
+    }
+
+
+    transaction
+    MemoryBlockchainDB::get_tx(const crypto::hash& h) const
+    {
+        transaction tx;
+
+        if (!parse_and_validate_tx_from_blob(get_tx_data(h).blob, tx))
+        {
+            throw DB_ERROR("Failed to parse transaction from blob retrieved from the db");
+        }
+
+        return tx;
+    }
+
+
+    uint64_t
+    MemoryBlockchainDB::get_tx_count() const
+    {
+        return m_txs.size();
+    }
+
+
+    std::vector<transaction>
+    MemoryBlockchainDB::get_tx_list(const std::vector<crypto::hash>& hlist) const
+    {
+        std::vector<transaction> txs;
+
+        for (const crypto::hash& h: hlist)
+        {
+            txs.push_back(get_tx(h));
+        }
+
+        return txs;
+    }
+
+
+    uint64_t
+    MemoryBlockchainDB::get_tx_block_height(const crypto::hash& h) const
+    {
+        return get_tx_data(h).height;
+    }
+
+
+    uint64_t
+    MemoryBlockchainDB::get_num_outputs(const uint64_t& amount) const
+    {
+        auto it = m_amount_outputs.find(amount);
+
+        return it == m_amount_outputs.end() ? 0 : it->second.size();
+    }
+
+
+    output_data_t
+    MemoryBlockchainDB::get_output_key(const uint64_t& amount, const uint64_t& index)
+    {
+        return get_amount_output(amount, index).data;
+    }
+
+
+    output_data_t
+    MemoryBlockchainDB::get_output_key(const uint64_t& global_index) const
+    {
+        if (global_index >= m_outputs.size())
+        {
+            throw OUTPUT_DNE("Attempting to get output pubkey by global index, but key does not exist");
+        }
+
+        return m_outputs[global_index].data;
+    }
+
+
+    tx_out
+    MemoryBlockchainDB::get_output(const crypto::hash& h, const uint64_t& index) const
+    {
+        const tx_data& txd = get_tx_data(h);
+
+        if (index >= txd.global_output_indices.size())
+        {
+            throw OUTPUT_DNE("Attempting to get output by tx hash and index, but output does not exist");
+        }
+
+        const output_entry& out = m_outputs[txd.global_output_indices[index]];
+
+        return tx_out {out.amount, txout_to_key {out.data.pubkey}};
+    }
+
+
+    tx_out_index
+    MemoryBlockchainDB::get_output_tx_and_index_from_global(const uint64_t& index) const
+    {
+        if (index >= m_outputs.size())
+        {
+            throw OUTPUT_DNE("output with given index not in db");
+        }
+
+        return m_outputs[index].tx_index;
+    }
+
+
+    tx_out_index
+    MemoryBlockchainDB::get_output_tx_and_index(const uint64_t& amount, const uint64_t& index)
+    {
+        return get_amount_output(amount, index).tx_index;
+    }
+
+
+    void
+    MemoryBlockchainDB::get_output_tx_and_index(const uint64_t& amount,
+                                                const std::vector<uint64_t>& offsets,
+                                                std::vector<tx_out_index>& indices)
+    {
+        for (const uint64_t& index: offsets)
+        {
+            indices.push_back(get_amount_output(amount, index).tx_index);
+        }
+    }
+
+
+    void
+    MemoryBlockchainDB::get_output_key(const uint64_t& amount,
+                                       const std::vector<uint64_t>& offsets,
+                                       std::vector<output_data_t>& outputs)
+    {
+        for (const uint64_t& index: offsets)
+        {
+            outputs.push_back(get_amount_output(amount, index).data);
+        }
+    }
+
+
+    bool
+    MemoryBlockchainDB::can_thread_bulk_indices() const
+    {
+        return true;
+    }
+
+
+    std::vector<uint64_t>
+    MemoryBlockchainDB::get_tx_output_indices(const crypto::hash& h) const
+    {
+        return get_tx_data(h).global_output_indices;
+    }
+
+
+    std::vector<uint64_t>
+    MemoryBlockchainDB::get_tx_amount_output_indices(const crypto::hash& h) const
+    {
+        return get_tx_data(h).amount_output_indices;
+    }
+
+
+    bool
+    MemoryBlockchainDB::has_key_image(const crypto::key_image& img) const
+    {
+        return m_spent_keys.count(img) > 0;
+    }
+
+
+    bool
+    MemoryBlockchainDB::for_all_key_images(std::function<bool(const crypto::key_image&)> f) const
+    {
+        for (const crypto::key_image& k_image: m_spent_keys)
+        {
+            if (!f(k_image))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    bool
+    MemoryBlockchainDB::for_all_blocks(std::function<bool(uint64_t, const crypto::hash&,
+                                                          const cryptonote::block&)> f) const
+    {
+        for (uint64_t height = 0; height < m_blocks.size(); ++height)
+        {
+            if (!f(height, m_blocks[height].hash, get_block_from_height(height)))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    bool
+    MemoryBlockchainDB::for_all_transactions(std::function<bool(const crypto::hash&,
+                                                                const cryptonote::transaction&)> f) const
+    {
+        transaction tx;
+
+        for (const auto& tx_kv: m_txs)
+        {
+            if (!parse_and_validate_tx_from_blob(tx_kv.second.blob, tx))
+            {
+                throw DB_ERROR("Failed to parse tx from blob retrieved from the db");
+            }
+
+            if (!f(tx_kv.first, tx))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    bool
+    MemoryBlockchainDB::for_all_outputs(std::function<bool(uint64_t amount,
+                                                           const crypto::hash& tx_hash,
+                                                           size_t tx_idx)> f) const
+    {
+        for (const output_entry& out: m_outputs)
+        {
+            if (!f(out.amount, out.tx_index.first, out.tx_index.second))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    void
+    MemoryBlockchainDB::set_hard_fork_starting_height(uint8_t version, uint64_t height)
+    {
+        m_hf_starting_heights[version] = height;
+    }
+
+
+    uint64_t
+    MemoryBlockchainDB::get_hard_fork_starting_height(uint8_t version) const
+    {
+        auto it = m_hf_starting_heights.find(version);
+
+        if (it == m_hf_starting_heights.end())
+        {
+            throw DB_ERROR("Error attempting to retrieve a hard fork starting height from the db");
+        }
+
+        return it->second;
+    }
+
+
+    void
+    MemoryBlockchainDB::set_hard_fork_version(uint64_t height, uint8_t version)
+    {
+        if (m_hf_versions.size() <= height)
+        {
+            m_hf_versions.resize(height + 1, 0);
+        }
+
+        m_hf_versions[height] = version;
+    }
+
+
+    uint8_t
+    MemoryBlockchainDB::get_hard_fork_version(uint64_t height) const
+    {
+        if (height >= m_hf_versions.size())
+        {
+            throw DB_ERROR("Error attempting to retrieve a hard fork version from the db");
+        }
+
+        return m_hf_versions[height];
+    }
+
+
+    void
+    MemoryBlockchainDB::check_hard_fork_info()
+    {}
+
+
+    void
+    MemoryBlockchainDB::drop_hard_fork_info()
+    {
+        m_hf_starting_heights.clear();
+        m_hf_versions.clear();
+    }
+
+
+    bool
+    MemoryBlockchainDB::is_read_only() const
+    {
+        return false;
+    }
+
+
+    void
+    MemoryBlockchainDB::add_block(const block& blk,
+                                  const size_t& block_size,
+                                  const difficulty_type& cumulative_difficulty,
+                                  const uint64_t& coins_generated,
+                                  const crypto::hash& blk_hash)
+    {
+        m_block_heights[blk_hash] = m_blocks.size();
+
+        m_blocks.push_back(block_data {block_to_blob(blk),
+                                       blk_hash,
+                                       blk.timestamp,
+                                       block_size,
+                                       cumulative_difficulty,
+                                       coins_generated});
+    }
+
+
+    void
+    MemoryBlockchainDB::remove_block()
+    {
+        if (m_blocks.empty())
+        {
+            throw BLOCK_DNE("Attempting to remove block from an empty blockchain");
+        }
+
+        m_block_heights.erase(m_blocks.back().hash);
+        m_blocks.pop_back();
+    }
+
+
+    /**
+     * Called after add_block(..., blk_hash), so
+     * the tx goes to the last block added.
+     */
+    void
+    MemoryBlockchainDB::add_transaction_data(const crypto::hash& blk_hash,
+                                             const transaction& tx,
+                                             const crypto::hash& tx_hash)
+    {
+        if (m_txs.count(tx_hash))
+        {
+            throw TX_EXISTS("Attempting to add transaction that's already in the db");
+        }
+
+        tx_data& txd = m_txs[tx_hash];
+
+        txd.blob        = tx_to_blob(tx);
+        txd.height      = m_blocks.size() - 1;
+        txd.unlock_time = tx.unlock_time;
+    }
+
+
+    void
+    MemoryBlockchainDB::remove_transaction_data(const crypto::hash& tx_hash,
+                                                const transaction& tx)
+    {
+        if (!m_txs.erase(tx_hash))
+        {
+            throw TX_DNE("Attempting to remove transaction that isn't in the db");
+        }
+
+        // outputs are removed in the reverse order they were added
+        for (auto it = tx.vout.rbegin(); it != tx.vout.rend(); ++it)
+        {
+            remove_output(*it);
+        }
+    }
+
+
+    void
+    MemoryBlockchainDB::add_output(const crypto::hash& tx_hash,
+                                   const tx_out& tx_output,
+                                   const uint64_t& local_index,
+                                   const uint64_t unlock_time)
+    {
+        if (tx_output.target.type() != typeid(txout_to_key))
+        {
+            throw DB_ERROR("Wrong output type: expected txout_to_key");
+        }
+
+        tx_data& txd = m_txs.at(tx_hash);
+
+        vector<uint64_t>& amount_outputs = m_amount_outputs[tx_output.amount];
+
+        uint64_t global_index = m_outputs.size();
+
+        txd.global_output_indices.push_back(global_index);
+        txd.amount_output_indices.push_back(amount_outputs.size());
+
+        amount_outputs.push_back(global_index);
+
+        output_data_t data;
+
+        data.pubkey      = boost::get<txout_to_key>(tx_output.target).key;
+        data.unlock_time = unlock_time;
+        data.height      = txd.height;
+
+        m_outputs.push_back(output_entry {tx_output.amount,
+                                          data,
+                                          tx_out_index {tx_hash, local_index}});
+    }
+
+
+    void
+    MemoryBlockchainDB::remove_output(const tx_out& tx_output)
+    {
+        auto it = m_amount_outputs.find(tx_output.amount);
+
+        if (it == m_amount_outputs.end() || it->second.empty()
+            || m_outputs.empty() || it->second.back() != m_outputs.size() - 1)
+        {
+            throw OUTPUT_DNE("Attempting to remove output that isn't the last one in the db");
+        }
+
+        it->second.pop_back();
+        m_outputs.pop_back();
+    }
+
+
+    void
+    MemoryBlockchainDB::add_spent_key(const crypto::key_image& k_image)
+    {
+        if (!m_spent_keys.insert(k_image).second)
+        {
+            throw KEY_IMAGE_EXISTS("Attempting to add spent key image that's already in the db");
+        }
+    }
+
+
+    void
+    MemoryBlockchainDB::remove_spent_key(const crypto::key_image& k_image)
+    {
+        m_spent_keys.erase(k_image);
+    }
+
+
+    const MemoryBlockchainDB::block_data&
+    MemoryBlockchainDB::get_block_data(const uint64_t& height) const
+    {
+        if (height >= m_blocks.size())
+        {
+            throw BLOCK_DNE("Attempted to get block from height, but no such block exists");
+        }
+
+        return m_blocks[height];
+    }
+
+
+    const MemoryBlockchainDB::tx_data&
+    MemoryBlockchainDB::get_tx_data(const crypto::hash& h) const
+    {
+        auto it = m_txs.find(h);
+
+        if (it == m_txs.end())
+        {
+            throw TX_DNE("Attempting to get tx that isn't in the db");
+        }
+
+        return it->second;
+    }
+
+
+    const MemoryBlockchainDB::output_entry&
+    MemoryBlockchainDB::get_amount_output(const uint64_t& amount, const uint64_t& index) const
+    {
+        auto it = m_amount_outputs.find(amount);
+
+        if (it == m_amount_outputs.end() || index >= it->second.size())
+        {
+            throw OUTPUT_DNE("Attempting to get output of given amount and index, but it does not exist");
+        }
+
+        return m_outputs[it->second[index]];
+    }
+
+}
@@ -0,0 +1,353 @@
+#ifndef XMREG01_MEMORYBLOCKCHAINDB_H
+#define XMREG01_MEMORYBLOCKCHAINDB_H
+
+#include "monero_headers.h"
+#include "tools.h"
+
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    /**
+     * BlockchainDB keeping the whole blockchain in memory.
+     *
+     * Meant for tests and benchmarks with synthetic
+     * chains (see SyntheticChain.h), so that MicroCore can
+     * run without a real lmdb blockchain.
+     *
+     * Blocks and txs are kept as blobs, as in lmdb, so that
+     * ChainReader can give out blob_views to them. Adding or
+     * removing blocks while reading is not supported.
+     */
+    class MemoryBlockchainDB : public BlockchainDB
+    {
+    public:
+
+        struct block_data
+        {
+            blobdata blob;
+            crypto::hash hash;
+            uint64_t timestamp;
+            size_t size;
+            difficulty_type cumulative_difficulty;
+            uint64_t coins_generated;
+        };
+
+        struct tx_data
+        {
+            blobdata blob;
+            uint64_t height;
+            uint64_t unlock_time;
+            vector<uint64_t> global_output_indices;
+            vector<uint64_t> amount_output_indices;
+        };
+
+        struct output_entry
+        {
+            uint64_t amount;
+            output_data_t data;
+            tx_out_index tx_index;
+        };
+
+        // txs ordered as lmdb keeps them, i.e., by memcmp of their hashes
+        struct hash_memcmp_less
+        {
+            bool
+            operator()(const crypto::hash& a, const crypto::hash& b) const
+            {
+                return memcmp(&a, &b, sizeof(crypto::hash)) < 0;
+            }
+        };
+
+        using txs_map = map<crypto::hash, tx_data, hash_memcmp_less>;
+
+        MemoryBlockchainDB() = default;
+
+        // blob access for ChainReader
+
+        bool
+        get_block_blob(const uint64_t& height, blob_view& blob) const;
+
+        bool
+        get_tx_blob(const crypto::hash& h, blob_view& blob) const;
+
+        const txs_map&
+        get_txs() const { return m_txs; }
+
+
+        // BlockchainDB interface
+
+        virtual void
+        open(const std::string& filename, const int db_flags = 0);
+
+        virtual void
+        close();
+
+        virtual void
+        sync();
+
+        virtual void
+        reset();
+
+        virtual std::vector<std::string>
+        get_filenames() const;
+
+        virtual std::string
+        get_db_name() const;
+
+        virtual bool
+        lock();
+
+        virtual void
+        unlock();
+
+        virtual bool
+        batch_start(uint64_t batch_num_blocks = 0);
+
+        virtual void
+        batch_commit();
+
+        virtual void
+        batch_stop();
+
+        virtual void
+        set_batch_transactions(bool batch_transactions);
+
+        virtual void
+        block_txn_start(bool readonly = false);
+
+        virtual void
+        block_txn_stop();
+
+        virtual void
+        block_txn_abort();
+
+        virtual uint64_t
+        add_block(const block& blk,
+                  const size_t& block_size,
+                  const difficulty_type& cumulative_difficulty,
+                  const uint64_t& coins_generated,
+                  const std::vector<transaction>& txs);
+
+        virtual bool
+        block_exists(const crypto::hash& h) const;
+
+        virtual block
+        get_block(const crypto::hash& h) const;
+
+        virtual uint64_t
+        get_block_height(const crypto::hash& h) const;
+
+        virtual block_header
+        get_block_header(const crypto::hash& h) const;
+
+        virtual block
+        get_block_from_height(const uint64_t& height) const;
+
+        virtual uint64_t
+        get_block_timestamp(const uint64_t& height) const;
+
+        virtual uint64_t
+        get_top_block_timestamp() const;
+
+        virtual size_t
+        get_block_size(const uint64_t& height) const;
+
+        virtual difficulty_type
+        get_block_cumulative_difficulty(const uint64_t& height) const;
+
+        virtual difficulty_type
+        get_block_difficulty(const uint64_t& height) const;
+
+        virtual uint64_t
+        get_block_already_generated_coins(const uint64_t& height) const;
+
+        virtual crypto::hash
+        get_block_hash_from_height(const uint64_t& height) const;
+
+        virtual std::vector<block>
+        get_blocks_range(const uint64_t& h1, const uint64_t& h2) const;
+
+        virtual std::vector<crypto::hash>
+        get_hashes_range(const uint64_t& h1, const uint64_t& h2) const;
+
+        virtual crypto::hash
+        top_block_hash() const;
+
+        virtual block
+        get_top_block() const;
+
+        virtual uint64_t
+        height() const;
+
+        virtual bool
+        tx_exists(const crypto::hash& h) const;
+
+        virtual uint64_t
+        get_tx_unlock_time(const crypto::hash& h) const;
+
+        virtual transaction
+        get_tx(const crypto::hash& h) const;
+
+        virtual uint64_t
+        get_tx_count() const;
+
+        virtual std::vector<transaction>
+        get_tx_list(const std::vector<crypto::hash>& hlist) const;
+
+        virtual uint64_t
+        get_tx_block_height(const crypto::hash& h) const;
+
+        virtual uint64_t
+        get_num_outputs(const uint64_t& amount) const;
+
+        virtual output_data_t
+        get_output_key(const uint64_t& amount, const uint64_t& index);
+
+        virtual output_data_t
+        get_output_key(const uint64_t& global_index) const;
+
+        virtual tx_out
+        get_output(const crypto::hash& h, const uint64_t& index) const;
+
+        virtual tx_out_index
+        get_output_tx_and_index_from_global(const uint64_t& index) const;
+
+        virtual tx_out_index
+        get_output_tx_and_index(const uint64_t& amount, const uint64_t& index);
+
+        virtual void
+        get_output_tx_and_index(const uint64_t& amount,
+                                const std::vector<uint64_t>& offsets,
+                                std::vector<tx_out_index>& indices);
+
+        virtual void
+        get_output_key(const uint64_t& amount,
+                       const std::vector<uint64_t>& offsets,
+                       std::vector<output_data_t>& outputs);
+
+        virtual bool
+        can_thread_bulk_indices() const;
+
+        virtual std::vector<uint64_t>
+        get_tx_output_indices(const crypto::hash& h) const;
+
+        virtual std::vector<uint64_t>
+        get_tx_amount_output_indices(const crypto::hash& h) const;
+
+        virtual bool
+        has_key_image(const crypto::key_image& img) const;
+
+        virtual bool
+        for_all_key_images(std::function<bool(const crypto::key_image&)>) const;
+
+        virtual bool
+        for_all_blocks(std::function<bool(uint64_t, const crypto::hash&,
+                                          const cryptonote::block&)>) const;
+
+        virtual bool
+        for_all_transactions(std::function<bool(const crypto::hash&,
+                                                const cryptonote::transaction&)>) const;
+
+        virtual bool
+        for_all_outputs(std::function<bool(uint64_t amount,
+                                           const crypto::hash& tx_hash,
+                                           size_t tx_idx)> f) const;
+
+        virtual void
+        set_hard_fork_starting_height(uint8_t version, uint64_t height);
+
+        virtual uint64_t
+        get_hard_fork_starting_height(uint8_t version) const;
+
+        virtual void
+        set_hard_fork_version(uint64_t height, uint8_t version);
+
+        virtual uint8_t
+        get_hard_fork_version(uint64_t height) const;
+
+        virtual void
+        check_hard_fork_info();
+
+        virtual void
+        drop_hard_fork_info();
+
+        virtual bool
+        is_read_only() const;
+
+    protected:
+
+        virtual void
+        add_block(const block& blk,
+                  const size_t& block_size,
+                  const difficulty_type& cumulative_difficulty,
+                  const uint64_t& coins_generated,
+                  const crypto::hash& blk_hash);
+
+        virtual void
+        remove_block();
+
+        virtual void
+        add_transaction_data(const crypto::hash& blk_hash,
+                             const transaction& tx,
+                             const crypto::hash& tx_hash);
+
+        virtual void
+        remove_transaction_data(const crypto::hash& tx_hash,
+                                const transaction& tx);
+
+        virtual void
+        add_output(const crypto::hash& tx_hash,
+                   const tx_out& tx_output,
+                   const uint64_t& local_index,
+                   const uint64_t unlock_time);
+
+        virtual void
+        remove_output(const tx_out& tx_output);
+
+        virtual void
+        add_spent_key(const crypto::key_image& k_image);
+
+        virtual void
+        remove_spent_key(const crypto::key_image& k_image);
+
+    private:
+
+        const block_data&
+        get_block_data(const uint64_t& height) const;
+
+        const tx_data&
+        get_tx_data(const crypto::hash& h) const;
+
+        const output_entry&
+        get_amount_output(const uint64_t& amount, const uint64_t& index) const;
+
+        vector<block_data> m_blocks;
+
+        unordered_map<crypto::hash, uint64_t> m_block_heights;
+
+        txs_map m_txs;
+
+        // all outputs, by global index
+        vector<output_entry> m_outputs;
+
+        // global indices of outputs of each amount
+        unordered_map<uint64_t, vector<uint64_t>> m_amount_outputs;
+
+        unordered_set<crypto::key_image> m_spent_keys;
+
+        map<uint8_t, uint64_t> m_hf_starting_heights;
+
+        vector<uint8_t> m_hf_versions;
+    };
+
+}
+
+#endif //XMREG01_MEMORYBLOCKCHAINDB_H
@@ -4,6 +4,13 @@
 
 #include "MicroCore.h"
 
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <unordered_set>
+
 namespace xmreg
 {
     /**
@@ -30,6 +37,7 @@ namespace xmreg
      * Create BlockchainLMDB on the heap.
      * Open database files located in blockchain_path.
      * Initialize m_blockchain_storage with the BlockchainLMDB object.
+     * Open m_reader on the same database for bulk reads.
      */
     bool
     MicroCore::init(const string& blockchain_path)
@@ -61,7 +69,35 @@ namespace xmreg
 
         // initialize Blockchain object to manage
         // the database.
-        return m_blockchain_storage.init(db, false);
+        if (!m_blockchain_storage.init(db, false))
+        {
+            return false;
+        }
+
+        return m_reader.open(blockchain_path);
+    }
+
+    /**
+     * Initialized the MicroCore object with blockchain
+     * kept in memory, e.g., a synthetic one.
+     *
+     * MicroCore takes ownership of memory_db, as it
+     * does of BlockchainLMDB.
+     */
+    bool
+    MicroCore::init(MemoryBlockchainDB* memory_db)
+    {
+        if (!memory_db->is_open())
+        {
+            memory_db->open("");
+        }
+
+        if (!m_blockchain_storage.init(memory_db, false))
+        {
+            return false;
+        }
+
+        return m_reader.open(*memory_db);
     }
 
     /**
@@ -74,6 +110,63 @@ namespace xmreg
         return m_blockchain_storage;
     }
 
+    /**
+     * Get m_reader, e.g., to open a read transaction
+     * and work with blob_views pinned to it.
+     */
+    ChainReader&
+    MicroCore::get_reader()
+    {
+        return m_reader;
+    }
+
+    /**
+     * Set number of txs (or blocks, for scans by height)
+     * ScanPrefetcher reads ahead of full chain scans.
+     *
+     * Useful when data.mdb is not in page cache, e.g., after reboot.
+     */
+    void
+    MicroCore::set_prefetch_window(size_t window)
+    {
+        m_prefetch_window = window;
+    }
+
+
+    bool
+    MicroCore::open_block_summary(const string& summary_path)
+    {
+        return m_block_summary.open(summary_path);
+    }
+
+
+    const BlockSummary&
+    MicroCore::get_block_summary() const
+    {
+        return m_block_summary;
+    }
+
+
+    RangeExecutor&
+    MicroCore::get_executor()
+    {
+        return m_executor;
+    }
+
+
+    bool
+    MicroCore::open_output_key_index(const string& index_path)
+    {
+        return m_output_key_index.open(index_path, *this);
+    }
+
+
+    const OutputKeyIndex&
+    MicroCore::get_output_key_index() const
+    {
+        return m_output_key_index;
+    }
+
     /**
      * Get block by its height
      *
@@ -108,6 +201,436 @@ namespace xmreg
     }
 
 
+    /**
+     * Get blocks of heights in [h0, h1) and their transactions.
+     *
+     * blk_txs[i] are transactions of blks[i] in the order of
+     * its tx_hashes. The coinbase transaction is not included,
+     * as it is already in blks[i].miner_tx.
+     *
+     * All blocks and txs are read in a single read transaction,
+     * with the blocks cursor moving forward through the range.
+     * The vectors are resized, not cleared, so passing the same
+     * vectors for consecutive ranges reuses their memory.
+     *
+     * h1 larger than blockchain height is capped to it.
+     */
+    bool
+    MicroCore::get_blocks_range(const uint64_t& h0, const uint64_t& h1,
+                                vector<block>& blks,
+                                vector<vector<transaction>>& blk_txs)
+    {
+        ChainReader::ReadTxn txn;
+
+        if (!m_reader.begin_read(txn))
+        {
+            return false;
+        }
+
+        uint64_t end_height = std::min(h1, txn.height());
+
+        size_t no_of_blks = h0 < end_height ? end_height - h0 : 0;
+
+        blks.resize(no_of_blks);
+        blk_txs.resize(no_of_blks);
+
+        for (size_t i = 0; i < no_of_blks; ++i)
+        {
+            block& blk = blks[i];
+
+            if (!txn.get_block(h0 + i, blk))
+            {
+                cerr << "Cant get block of height: " << h0 + i << endl;
+                return false;
+            }
+
+            vector<transaction>& txs = blk_txs[i];
+
+            txs.resize(blk.tx_hashes.size());
+
+            for (size_t j = 0; j < blk.tx_hashes.size(); ++j)
+            {
+                if (!txn.get_tx(blk.tx_hashes[j], txs[j]))
+                {
+                    cerr << "Cant get tx " << blk.tx_hashes[j]
+                         << " in block: " << h0 + i << endl;
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Call f for each transaction, including coinbase ones,
+     * in blocks of heights [h0, h1), in the order they are
+     * in the blockchain.
+     *
+     * f gets tx blob as a view into the lmdb memory map, so
+     * nothing is copied unless f parses it. The view is valid only
+     * during the call. Returning false from f stops the iteration.
+     *
+     * The deadline is checked before each block. If it expires,
+     * the iteration stops, and the result has blocks done so far.
+     * If f stops it, it is complete, up to the block f stopped in.
+     */
+    chain_scan_result
+    MicroCore::for_all_tx_blobs(const uint64_t& h0, const uint64_t& h1,
+                                std::function<bool(const uint64_t& height,
+                                                   const crypto::hash& tx_hash,
+                                                   const blob_view& tx_blob)> f,
+                                const ScanDeadline& deadline)
+    {
+        chain_scan_result result;
+
+        result.h0 = h0;
+        result.h1 = h0;
+
+        ChainReader::ReadTxn txn;
+
+        if (!m_reader.begin_read(txn))
+        {
+            return result;
+        }
+
+        uint64_t end_height = std::min(h1, txn.height());
+
+        ScanPrefetcher prefetcher {m_reader, m_prefetch_window,
+                                   ScanPrefetcher::scan_order::height, h0,
+                                   end_height};
+        prefetcher.start();
+
+        // reused for each block, so that tx_hashes
+        // vector does not need to be reallocated
+        block blk;
+
+        for (uint64_t height = h0; height < end_height; ++height)
+        {
+            if (deadline.expired())
+            {
+                result.expired = true;
+                return result;
+            }
+
+            prefetcher.advance();
+
+            blob_view blk_blob;
+            blob_view miner_tx_blob;
+
+            if (!txn.get_block_blob(height, blk_blob)
+                || !parse_block_from_view(blk_blob, blk, &miner_tx_blob))
+            {
+                cerr << "Cant get block of height: " << height << endl;
+                return result;
+            }
+
+            bool stopped = !f(height, get_tx_hash_from_view(miner_tx_blob), miner_tx_blob);
+
+            for (size_t i = 0; i < blk.tx_hashes.size() && !stopped; ++i)
+            {
+                const crypto::hash& tx_hash = blk.tx_hashes[i];
+
+                blob_view tx_blob;
+
+                if (!txn.get_tx_blob(tx_hash, tx_blob))
+                {
+                    cerr << "Cant get tx " << tx_hash
+                         << " in block: " << height << endl;
+                    return result;
+                }
+
+                stopped = !f(height, tx_hash, tx_blob);
+            }
+
+            result.h1 = height + 1;
+
+            if (stopped)
+            {
+                break;
+            }
+        }
+
+        result.complete = true;
+
+        return result;
+    }
+
+
+    /**
+     * Run all visitors in one pass over blocks of heights [h0, h1).
+     *
+     * Each block and tx is read and parsed once, only as much as
+     * the visitors together need. Ranges of blocks are visited by
+     * threads of the executor, each with forks of the visitors,
+     * which are then merged into them in height order.
+     *
+     * If the deadline expires, ranges being visited stop at their
+     * next block. Visitors then get only the ranges from h0 which
+     * were visited without a gap, and the result ends where they end.
+     */
+    chain_scan_result
+    MicroCore::visit_chain(const vector<ChainVisitor*>& visitors,
+                           uint64_t h0, uint64_t h1,
+                           bool show_progress,
+                           const ScanDeadline& deadline)
+    {
+        // average number of blocks visited by a thread at a time
+        const uint64_t VISIT_CHUNK {1000};
+
+        chain_scan_result result;
+
+        result.h0 = h0;
+        result.h1 = h0;
+
+        {
+            ChainReader::ReadTxn txn;
+
+            if (!m_reader.begin_read(txn))
+            {
+                return result;
+            }
+
+            h1 = std::min(h1, txn.height());
+        }
+
+        if (h0 >= h1 || visitors.empty())
+        {
+            result.h1       = std::max(h0, h1);
+            result.complete = true;
+            return result;
+        }
+
+        ScanProgress progress {m_block_summary, h0, h1, "visited blocks", show_progress};
+
+        // forks of visitors for a range, and where they stopped
+        struct visited_range
+        {
+            uint64_t h1;
+            vector<unique_ptr<ChainVisitor>> forks;
+        };
+
+        // by first height of the range
+        map<uint64_t, visited_range> range_visitors;
+
+        mutex range_visitors_mutex;
+
+        std::atomic<bool> failed {false};
+
+        m_executor.run(
+                m_block_summary, h0, h1, VISIT_CHUNK,
+                [&](size_t worker_i, uint64_t range_h0, uint64_t range_h1) -> bool
+                {
+                    vector<unique_ptr<ChainVisitor>> forks;
+
+                    for (ChainVisitor* visitor: visitors)
+                    {
+                        forks.push_back(visitor->fork());
+                    }
+
+                    uint64_t visited_h1 {range_h0};
+
+                    // false stops the executor's other threads too
+                    if (!visit_range(forks, range_h0, range_h1, deadline, visited_h1))
+                    {
+                        failed = true;
+                        return false;
+                    }
+
+                    // a range cut short by the deadline
+                    // is still good up to visited_h1
+                    bool range_done = visited_h1 == range_h1;
+
+                    if (range_done)
+                    {
+                        progress.done(range_h0, range_h1);
+                    }
+
+                    lock_guard<mutex> lock {range_visitors_mutex};
+
+                    range_visitors[range_h0] = visited_range {visited_h1, std::move(forks)};
+
+                    return range_done;
+                });
+
+        if (failed)
+        {
+            return result;
+        }
+
+        progress.finish();
+
+        // ranges after a gap, e.g., one not taken before
+        // the deadline expired, are not merged
+        for (auto& range: range_visitors)
+        {
+            if (range.first != result.h1)
+            {
+                break;
+            }
+
+            for (size_t i = 0; i < visitors.size(); ++i)
+            {
+                visitors[i]->merge(*range.second.forks[i]);
+            }
+
+            result.h1 = range.second.h1;
+        }
+
+        result.complete = result.h1 == h1;
+        result.expired  = !result.complete;
+
+        return result;
+    }
+
+
+    /**
+     * Returns false on errors. If the deadline expires, true is
+     * returned with visited_h1 before h1, as visitors are good for
+     * blocks they visited.
+     */
+    bool
+    MicroCore::visit_range(const vector<unique_ptr<ChainVisitor>>& visitors,
+                           uint64_t h0, uint64_t h1,
+                           const ScanDeadline& deadline,
+                           uint64_t& visited_h1)
+    {
+        const uint32_t TX_FIELDS = VISIT_TX_BLOB | VISIT_TX_PREFIX | VISIT_TX;
+
+        vector<uint32_t> fields;
+
+        uint32_t all_fields {0};
+
+        for (const unique_ptr<ChainVisitor>& visitor: visitors)
+        {
+            fields.push_back(visitor->fields());
+            all_fields |= fields.back();
+        }
+
+        ChainReader::ReadTxn txn;
+
+        if (!m_reader.begin_read(txn))
+        {
+            return false;
+        }
+
+        ScanPrefetcher prefetcher {m_reader, m_prefetch_window,
+                                   ScanPrefetcher::scan_order::height, h0, h1};
+        prefetcher.start();
+
+        // reused for each block and tx
+        block blk;
+        transaction_prefix tx_prefix;
+        transaction tx;
+
+        auto visit_tx = [&](const uint64_t& height,
+                            const crypto::hash& tx_hash,
+                            bool is_coinbase,
+                            const blob_view& blob,
+                            const transaction_prefix* prefix,
+                            const transaction* full_tx)
+        {
+            for (size_t i = 0; i < visitors.size(); ++i)
+            {
+                if (!(fields[i] & TX_FIELDS))
+                {
+                    continue;
+                }
+
+                visitors[i]->visit_tx(tx_visit {
+                        height, &tx_hash, is_coinbase,
+                        fields[i] & VISIT_TX_BLOB   ? &blob  : nullptr,
+                        fields[i] & VISIT_TX_PREFIX ? prefix : nullptr,
+                        fields[i] & VISIT_TX        ? full_tx : nullptr});
+            }
+        };
+
+        visited_h1 = h0;
+
+        for (uint64_t height = h0; height < h1; ++height)
+        {
+            if (deadline.expired())
+            {
+                return true;
+            }
+
+            prefetcher.advance();
+
+            blob_view blk_blob;
+            blob_view miner_tx_blob;
+
+            if (!txn.get_block_blob(height, blk_blob)
+                || !parse_block_from_view(blk_blob, blk, &miner_tx_blob))
+            {
+                cerr << "Cant get block of height: " << height << endl;
+                return false;
+            }
+
+            for (size_t i = 0; i < visitors.size(); ++i)
+            {
+                if (fields[i] & VISIT_BLOCK)
+                {
+                    visitors[i]->visit_block(height, blk);
+                }
+            }
+
+            if (!(all_fields & TX_FIELDS))
+            {
+                visited_h1 = height + 1;
+                continue;
+            }
+
+            // coinbase tx is already parsed with the block
+            visit_tx(height, get_tx_hash_from_view(miner_tx_blob), true,
+                     miner_tx_blob, &blk.miner_tx, &blk.miner_tx);
+
+            for (const crypto::hash& tx_hash: blk.tx_hashes)
+            {
+                blob_view tx_blob;
+
+                if (!txn.get_tx_blob(tx_hash, tx_blob))
+                {
+                    cerr << "Cant get tx " << tx_hash
+                         << " in block: " << height << endl;
+                    return false;
+                }
+
+                const transaction_prefix* prefix {nullptr};
+                const transaction* full_tx {nullptr};
+
+                if (all_fields & VISIT_TX)
+                {
+                    if (!parse_tx_from_view(tx_blob, tx))
+                    {
+                        cerr << "Cant parse tx " << tx_hash << endl;
+                        return false;
+                    }
+
+                    prefix  = &tx;
+                    full_tx = &tx;
+                }
+                else if (all_fields & VISIT_TX_PREFIX)
+                {
+                    if (!parse_tx_prefix_from_view(tx_blob, tx_prefix))
+                    {
+                        cerr << "Cant parse tx " << tx_hash << endl;
+                        return false;
+                    }
+
+                    prefix = &tx_prefix;
+                }
+
+                visit_tx(height, tx_hash, false, tx_blob, prefix, full_tx);
+            }
+
+            visited_h1 = height + 1;
+        }
+
+        return true;
+    }
+
+
     bool
     MicroCore::get_block_by_tx_hash(const crypto::hash& tx_hash, block& blk)
     {
@@ -152,6 +675,75 @@ namespace xmreg
 
 
 
+    /**
+     * Get height of the block containing the given transaction.
+     *
+     * Reads only the tx heights index of the database, so it is
+     * much cheaper than get_block_by_tx_hash when only the height
+     * is needed.
+     */
+    bool
+    MicroCore::get_tx_height(const crypto::hash& tx_hash, uint64_t& tx_height)
+    {
+        try
+        {
+            tx_height = m_blockchain_storage.get_db().get_tx_block_height(tx_hash);
+        }
+        catch (const exception& e)
+        {
+            cerr << e.what() << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Get timestamp of a block of given height,
+     * without reading and parsing the block.
+     */
+    bool
+    MicroCore::get_block_timestamp(const uint64_t& height, uint64_t& timestamp)
+    {
+        try
+        {
+            timestamp = m_blockchain_storage.get_db().get_block_timestamp(height);
+        }
+        catch (const exception& e)
+        {
+            cerr << e.what() << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Get hash of a block of given height, e.g., to check
+     * that data kept next to the blockchain is not from
+     * blocks removed by a reorg.
+     */
+    bool
+    MicroCore::get_block_hash(const uint64_t& height, crypto::hash& blk_hash)
+    {
+        try
+        {
+            blk_hash = m_blockchain_storage.get_db().get_block_hash_from_height(height);
+        }
+        catch (const exception& e)
+        {
+            cerr << e.what() << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+
+
     /**
      * Find output with given public key in a given transaction
      */
@@ -192,6 +784,13 @@ namespace xmreg
     }
 
 
+    /**
+     * Scan all txs for the one spending key_img.
+     *
+     * Txs are in the order of the txs table, so a search stopped
+     * early would not know which blocks it checked. For a search
+     * with a deadline, use find_txs_with_key_images over heights.
+     */
     bool
     MicroCore::find_tx_with_key_image(const crypto::key_image& key_img,
                                       crypto::hash& tx_hash,
@@ -203,10 +802,13 @@ namespace xmreg
 
         uint64_t total_tx_count = m_blockchain_storage.get_db().get_tx_count();
 
+        ScanPrefetcher prefetcher {m_reader, m_prefetch_window};
+        prefetcher.start();
+
         m_blockchain_storage.for_all_transactions(
                 [&](const crypto::hash& hash, const cryptonote::transaction& tx)->bool
                     {
-
+                        prefetcher.advance();
 
 
                         if (show_progress)
@@ -255,12 +857,22 @@ namespace xmreg
                         return true; // continue the search the iteration
                     });
 
+        prefetcher.stop();
+
+        if (show_progress && m_prefetch_window)
+        {
+            cout << "\n - " << prefetcher.report() << endl;
+        }
 
         return tx_found;
     }
 
 
 
+    /**
+     * Scan all txs for the ones spending key_imgs, in
+     * the order of the txs table, as the one above.
+     */
     unordered_map<crypto::key_image, crypto::hash>
     MicroCore::find_txs_with_key_images(const vector<crypto::key_image>& key_imgs,
                                         bool show_progress)
@@ -274,10 +886,14 @@ namespace xmreg
 
         uint64_t total_tx_count = m_blockchain_storage.get_db().get_tx_count();
 
+        ScanPrefetcher prefetcher {m_reader, m_prefetch_window};
+        prefetcher.start();
 
         m_blockchain_storage.for_all_transactions(
                 [&](const crypto::hash& hash, const cryptonote::transaction& tx)->bool {
 
+                    prefetcher.advance();
+
                     if (show_progress)
                     {
                         if (tx_idx % 100)
@@ -336,59 +952,274 @@ namespace xmreg
                     return true; // continue the search the iteration
                 });
 
+        prefetcher.stop();
+
+        if (show_progress && m_prefetch_window)
+        {
+            cout << "\t - " << prefetcher.report() << endl;
+        }
 
         return tx_hashes_found;
     }
 
 
 
+    /**
+     * Same as above, but over blocks of heights [h0, h1), in
+     * height order, and stopping when the deadline expires.
+     *
+     * The returned range tells which blocks were fully checked, so
+     * a search cut short can be resumed from its h1. A tx which can
+     * not be parsed also cuts the search short, as its key images
+     * are unknown.
+     */
+    key_image_search_result
+    MicroCore::find_txs_with_key_images(const vector<crypto::key_image>& key_imgs,
+                                        uint64_t h0, uint64_t h1,
+                                        const ScanDeadline& deadline,
+                                        bool show_progress)
+    {
+        key_image_search_result result;
+
+        result.h0 = h0;
+        result.h1 = h0;
+
+        unordered_set<crypto::key_image> to_find(key_imgs.begin(), key_imgs.end());
+
+        if (to_find.empty())
+        {
+            result.complete = true;
+            return result;
+        }
+
+        uint64_t current_height = h0;
+
+        bool parse_failed {false};
+
+        // reused for each tx
+        transaction_prefix tx;
+
+        chain_scan_result scan = for_all_tx_blobs(
+                h0, h1,
+                [&](const uint64_t& height,
+                    const crypto::hash& tx_hash,
+                    const blob_view& tx_blob) -> bool
+                {
+                    if (show_progress && height != current_height)
+                    {
+                        cout << "\r" << "\t - checking block no: "
+                             << height << "/" << h1 << flush;
+                    }
+
+                    current_height = height;
+
+                    if (!parse_tx_prefix_from_view(tx_blob, tx))
+                    {
+                        cerr << "Cant parse tx " << tx_hash << endl;
+                        parse_failed = true;
+                        return false;
+                    }
+
+                    for (const txin_v& in: tx.vin)
+                    {
+                        if (in.type() != typeid(txin_to_key))
+                        {
+                            continue;
+                        }
+
+                        auto it = to_find.find(boost::get<txin_to_key>(in).k_image);
+
+                        if (it == to_find.end())
+                        {
+                            continue;
+                        }
+
+                        if (show_progress)
+                        {
+                            cout << "\n" << "\t - tx found for key_img: " << *it;
+                        }
+
+                        result.txs_found[*it] = tx_hash;
+
+                        to_find.erase(it);
+                    }
+
+                    // we found everything
+                    return !to_find.empty();
+                },
+                deadline);
+
+        if (show_progress)
+        {
+            cout << endl;
+        }
+
+        if (parse_failed)
+        {
+            // block of current_height was checked only in part
+            result.h1 = current_height;
+            return result;
+        }
+
+        result.h1       = scan.h1;
+        result.complete = scan.complete;
+
+        return result;
+    }
+
 
     /**
-     * Returns tx hash in a given block which
-     * contains given output's public key
+     * Same as above, but over the key_images column of
+     * a scan sidecar, so no tx is read or parsed.
+     *
+     * Key images not in the sidecar are not in the map, as they
+     * can be in blocks added after the sidecar was last built.
      */
-    bool
-    MicroCore::get_tx_hash_from_output_pubkey(const public_key& output_pubkey,
-                                              const uint64_t& block_height,
-                                              crypto::hash& tx_hash,
-                                              cryptonote::transaction& tx_found)
+    unordered_map<crypto::key_image, crypto::hash>
+    MicroCore::find_txs_with_key_images(const ScanSidecar& sidecar,
+                                        const vector<crypto::key_image>& key_imgs)
     {
+        unordered_map<crypto::key_image, crypto::hash> tx_hashes_found;
 
-        tx_hash = null_hash;
+        unordered_set<crypto::key_image> to_find(key_imgs.begin(), key_imgs.end());
 
-        // get block of given height
-        block blk;
-        if (!get_block_by_height(block_height, blk))
+        const crypto::key_image* sidecar_key_imgs = sidecar.key_images();
+
+        uint64_t no_of_inputs = sidecar.no_of_inputs();
+
+        for (uint64_t i = 0; i < no_of_inputs && !to_find.empty(); ++i)
         {
-            cerr << "Cant get block of height: " << block_height << endl;
-            return false;
+            auto it = to_find.find(sidecar_key_imgs[i]);
+
+            if (it == to_find.end())
+            {
+                continue;
+            }
+
+            uint64_t tx_row = sidecar.tx_row_of_input(i);
+
+            tx_hashes_found[*it] = sidecar.tx_hash(tx_row);
+
+            to_find.erase(it);
         }
 
+        return tx_hashes_found;
+    }
+
+
+    /**
+     * Find outputs of the given address in blocks of
+     * heights [h0, h1), using tx public keys and output
+     * keys from a scan sidecar.
+     *
+     * h1 larger than sidecar height is capped to it.
+     *
+     * If derivations is given, the key derivation of each
+     * output found is added to it, e.g., for its key image.
+     */
+    vector<owned_output>
+    MicroCore::find_our_outputs(const ScanSidecar& sidecar,
+                                const secret_key& private_view_key,
+                                const public_key& public_spend_key,
+                                uint64_t h0, uint64_t h1,
+                                vector<key_derivation>* derivations)
+    {
+        vector<owned_output> our_outputs;
 
-        // get all transactions in the block found
-        // initialize the first list with transaction for solving
-        // the block i.e. coinbase.
-        list<transaction> txs {blk.miner_tx};
-        list<crypto::hash> missed_txs;
+        h1 = std::min(h1, sidecar.height());
 
-        if (!m_blockchain_storage.get_transactions(blk.tx_hashes, txs, missed_txs))
+        if (h0 >= h1)
         {
-            cerr << "Cant find transcations in block: " << block_height << endl;
-            return false;
+            return our_outputs;
         }
 
-        if (!missed_txs.empty())
+        const public_key* output_keys = sidecar.output_keys();
+        const uint64_t* output_amounts = sidecar.output_amounts();
+
+        uint64_t tx_begin = sidecar.block_txs(h0).begin;
+        uint64_t tx_end   = sidecar.block_txs(h1 - 1).end;
+
+        uint64_t height = h0;
+        uint64_t height_end = sidecar.block_txs(h0).end;
+
+        // reused for each tx
+        vector<size_t> our_indices;
+
+        for (uint64_t tx_row = tx_begin; tx_row < tx_end; ++tx_row)
         {
-            cerr << "Transactions not found in blk: " << block_height << endl;
+            while (tx_row >= height_end)
+            {
+                height_end = sidecar.block_txs(++height).end;
+            }
+
+            ScanSidecar::row_range outs = sidecar.tx_outputs(tx_row);
+
+            get_belonging_output_indices(sidecar.tx_pub_key(tx_row),
+                                         output_keys + outs.begin,
+                                         outs.end - outs.begin,
+                                         private_view_key,
+                                         public_spend_key,
+                                         our_indices);
 
-            for (const crypto::hash& h : missed_txs)
+            if (derivations != nullptr && !our_indices.empty())
             {
-                cerr << " - tx hash: " << h << endl;
+                // made again, but only for the few txs with our outputs
+                key_derivation derivation;
+
+                generate_key_derivation(sidecar.tx_pub_key(tx_row),
+                                        private_view_key, derivation);
+
+                derivations->insert(derivations->end(), our_indices.size(), derivation);
             }
 
+            for (size_t i: our_indices)
+            {
+                our_outputs.push_back(
+                        owned_output {height,
+                                      sidecar.tx_hash(tx_row),
+                                      i,
+                                      output_amounts[outs.begin + i],
+                                      output_keys[outs.begin + i]});
+            }
+        }
+
+        return our_outputs;
+    }
+
+
+
+
+    /**
+     * Returns tx hash in a given block which
+     * contains given output's public key
+     */
+    bool
+    MicroCore::get_tx_hash_from_output_pubkey(const public_key& output_pubkey,
+                                              const uint64_t& block_height,
+                                              crypto::hash& tx_hash,
+                                              cryptonote::transaction& tx_found)
+    {
+
+        tx_hash = null_hash;
+
+        // get block of given height and all its
+        // transactions in one go
+        vector<block> blks;
+        vector<vector<transaction>> blk_txs;
+
+        if (!get_blocks_range(block_height, block_height + 1, blks, blk_txs)
+            || blks.empty())
+        {
+            cerr << "Cant get block of height: " << block_height << endl;
             return false;
         }
 
+        // the coinbase transaction goes first, as it
+        // would in the block
+        vector<transaction>& txs = blk_txs.front();
+
+        txs.insert(txs.begin(), blks.front().miner_tx);
+
 
         // search outputs in each transactions
         // until output with pubkey of interest is found
@@ -415,6 +1246,144 @@ namespace xmreg
     }
 
 
+    /**
+     * Find tx having the output key without knowing
+     * its height, using the output key index.
+     *
+     * returns false if it is not found, or the index is not open
+     */
+    bool
+    MicroCore::get_tx_hash_from_output_pubkey(const public_key& output_pubkey,
+                                              crypto::hash& tx_hash,
+                                              cryptonote::transaction& tx_found)
+    {
+        tx_hash = null_hash;
+
+        output_location location;
+
+        if (!m_output_key_index.find(output_pubkey, location))
+        {
+            return false;
+        }
+
+        tx_hash = location.tx_hash;
+
+        return get_tx(tx_hash, tx_found);
+    }
+
+
+
+
+    /**
+     * Resolve (amount, global output index) pairs, e.g.,
+     * ring members of tx inputs, into output public keys,
+     * their txs and heights.
+     *
+     * outputs[i] corresponds to amount_indices[i]. Requests are
+     * sorted and grouped by amount, so that each amount is read
+     * in one bulk call with increasing indices, rather than
+     * one lookup per ring member.
+     */
+    bool
+    MicroCore::get_output_infos(const vector<pair<uint64_t, uint64_t>>& amount_indices,
+                                vector<output_info>& outputs)
+    {
+        size_t no_of_outputs = amount_indices.size();
+
+        outputs.resize(no_of_outputs);
+
+        // positions of requests sorted by amount and index
+        vector<size_t> order(no_of_outputs);
+
+        std::iota(order.begin(), order.end(), 0);
+
+        std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+        {
+            return amount_indices[a] < amount_indices[b];
+        });
+
+        BlockchainDB& db = m_blockchain_storage.get_db();
+
+        // reused for each amount
+        vector<uint64_t> offsets;
+        vector<output_data_t> output_keys;
+        vector<tx_out_index> tx_indices;
+
+        size_t run_start {0};
+
+        try
+        {
+            while (run_start < no_of_outputs)
+            {
+                uint64_t amount = amount_indices[order[run_start]].first;
+
+                size_t run_end = run_start;
+
+                offsets.clear();
+
+                // unique, sorted indices of this amount
+                while (run_end < no_of_outputs
+                       && amount_indices[order[run_end]].first == amount)
+                {
+                    uint64_t global_index = amount_indices[order[run_end]].second;
+
+                    if (offsets.empty() || offsets.back() != global_index)
+                    {
+                        offsets.push_back(global_index);
+                    }
+
+                    ++run_end;
+                }
+
+                output_keys.clear();
+                tx_indices.clear();
+
+                db.get_output_key(amount, offsets, output_keys);
+                db.get_output_tx_and_index(amount, offsets, tx_indices);
+
+                if (output_keys.size() != offsets.size()
+                    || tx_indices.size() != offsets.size())
+                {
+                    cerr << "Cant get all outputs of amount: " << amount << endl;
+                    return false;
+                }
+
+                // copy results to requests' positions
+                size_t offset_i {0};
+
+                for (size_t i = run_start; i < run_end; ++i)
+                {
+                    uint64_t global_index = amount_indices[order[i]].second;
+
+                    while (offsets[offset_i] != global_index)
+                    {
+                        ++offset_i;
+                    }
+
+                    output_info& out = outputs[order[i]];
+
+                    out.amount       = amount;
+                    out.global_index = global_index;
+                    out.pubkey       = output_keys[offset_i].pubkey;
+                    out.unlock_time  = output_keys[offset_i].unlock_time;
+                    out.height       = output_keys[offset_i].height;
+                    out.tx_hash      = tx_indices[offset_i].first;
+                    out.index_in_tx  = tx_indices[offset_i].second;
+                }
+
+                run_start = run_end;
+            }
+        }
+        catch (const exception& e)
+        {
+            cerr << e.what() << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
 
 
     void
@@ -451,5 +1420,9 @@ namespace xmreg
     MicroCore::~MicroCore()
     {
        delete &m_blockchain_storage.get_db();
+
+       // closing m_reader's environment drops lmdb locks of
+       // the process, so it goes after the database is closed
+       m_reader.close();
     }
 }
\ No newline at end of file
@@ -9,6 +9,14 @@
 
 #include "monero_headers.h"
 #include "tx_details.h"
+#include "ChainReader.h"
+#include "ScanPrefetcher.h"
+#include "ScanSidecar.h"
+#include "ScanDeadline.h"
+#include "ChainVisitor.h"
+#include "BlockSummary.h"
+#include "RangeExecutor.h"
+#include "OutputKeyIndex.h"
 
 
 
@@ -18,6 +26,58 @@ namespace xmreg
     using namespace crypto;
     using namespace std;
 
+    /**
+     * Output identified by its amount and global
+     * index for that amount, as used in tx inputs' rings.
+     */
+    struct output_info
+    {
+        uint64_t amount {0};
+        uint64_t global_index {0};
+
+        public_key pubkey;
+        crypto::hash tx_hash;
+        uint64_t index_in_tx {0};
+        uint64_t height {0};
+        uint64_t unlock_time {0};
+    };
+
+
+    /**
+     * Blocks of heights [h0, h1) covered by a scan.
+     *
+     * If the scan was stopped by its deadline, complete is false,
+     * expired is true, and h1 is where it can be resumed from. If it
+     * failed, e.g., a block could not be read, both are false.
+     */
+    struct chain_scan_result
+    {
+        uint64_t h0 {0};
+        uint64_t h1 {0};
+
+        bool complete {false};
+        bool expired {false};
+    };
+
+
+    /**
+     * Txs found by a key image search over blocks of
+     * heights [h0, h1).
+     *
+     * If the search was stopped by its deadline, complete is
+     * false and h1 is where it can be resumed from.
+     */
+    struct key_image_search_result
+    {
+        unordered_map<crypto::key_image, crypto::hash> txs_found;
+
+        uint64_t h0 {0};
+        uint64_t h1 {0};
+
+        bool complete {false};
+    };
+
+
     /**
      * Micro version of cryptonode::core class
      * Micro version of constructor,
@@ -31,24 +91,91 @@ namespace xmreg
         tx_memory_pool m_mempool;
         Blockchain m_blockchain_storage;
 
+        ChainReader m_reader;
+
+        // how many txs or blocks to read ahead
+        // of full chain scans. 0 disables it.
+        size_t m_prefetch_window {0};
+
+        // used to split parallel scans into parts of equal work.
+        // without its file, parts have equal number of blocks.
+        BlockSummary m_block_summary;
+
+        // threads of all parallel scans
+        RangeExecutor m_executor;
+
+        // to find txs of output keys without their height
+        OutputKeyIndex m_output_key_index;
+
     public:
         MicroCore();
 
         bool
         init(const string& blockchain_path);
 
+        bool
+        init(MemoryBlockchainDB* memory_db);
+
         Blockchain&
         get_core();
 
+        ChainReader&
+        get_reader();
+
+        void
+        set_prefetch_window(size_t window);
+
+        bool
+        open_block_summary(const string& summary_path);
+
+        const BlockSummary&
+        get_block_summary() const;
+
+        RangeExecutor&
+        get_executor();
+
+        bool
+        open_output_key_index(const string& index_path);
+
+        const OutputKeyIndex&
+        get_output_key_index() const;
+
         bool
         get_block_by_height(const uint64_t& height, block& blk);
 
+        bool
+        get_blocks_range(const uint64_t& h0, const uint64_t& h1,
+                         vector<block>& blks,
+                         vector<vector<transaction>>& blk_txs);
+
+        chain_scan_result
+        for_all_tx_blobs(const uint64_t& h0, const uint64_t& h1,
+                         std::function<bool(const uint64_t& height,
+                                            const crypto::hash& tx_hash,
+                                            const blob_view& tx_blob)> f,
+                         const ScanDeadline& deadline = ScanDeadline::none());
+
+        chain_scan_result
+        visit_chain(const vector<ChainVisitor*>& visitors,
+                    uint64_t h0, uint64_t h1,
+                    bool show_progress = false,
+                    const ScanDeadline& deadline = ScanDeadline::none());
+
         bool
         get_block_by_tx_hash(const crypto::hash& tx_hash, block& blk);
 
         bool
         get_tx(const crypto::hash& tx_hash, transaction& tx);
 
+        bool
+        get_tx_height(const crypto::hash& tx_hash, uint64_t& tx_height);
+
+        bool
+        get_block_timestamp(const uint64_t& height, uint64_t& timestamp);
+
+        bool
+        get_block_hash(const uint64_t& height, crypto::hash& blk_hash);
+
         bool
         find_output_in_tx(const transaction& tx,
                           const public_key& output_pubkey,
@@ -64,12 +191,38 @@ namespace xmreg
         find_txs_with_key_images(const vector<crypto::key_image>& key_img,
                                  bool show_progress = false);
 
+        key_image_search_result
+        find_txs_with_key_images(const vector<crypto::key_image>& key_imgs,
+                                 uint64_t h0, uint64_t h1,
+                                 const ScanDeadline& deadline,
+                                 bool show_progress = false);
+
+        unordered_map<crypto::key_image, crypto::hash>
+        find_txs_with_key_images(const ScanSidecar& sidecar,
+                                 const vector<crypto::key_image>& key_imgs);
+
+        vector<owned_output>
+        find_our_outputs(const ScanSidecar& sidecar,
+                         const secret_key& private_view_key,
+                         const public_key& public_spend_key,
+                         uint64_t h0, uint64_t h1,
+                         vector<key_derivation>* derivations = nullptr);
+
         bool
         get_tx_hash_from_output_pubkey(const public_key& output_pubkey,
                                        const uint64_t& block_height,
                                        crypto::hash& tx_hash,
                                        transaction& tx_found);
 
+        bool
+        get_tx_hash_from_output_pubkey(const public_key& output_pubkey,
+                                       crypto::hash& tx_hash,
+                                       transaction& tx_found);
+
+        bool
+        get_output_infos(const vector<pair<uint64_t, uint64_t>>& amount_indices,
+                         vector<output_info>& outputs);
+
         void
         check_ring_signature(const crypto::hash &tx_prefix_hash,
                              const crypto::key_image &key_image,
@@ -78,6 +231,14 @@ namespace xmreg
                              uint64_t &result);
 
         virtual ~MicroCore();
+
+    private:
+
+        bool
+        visit_range(const vector<unique_ptr<ChainVisitor>>& visitors,
+                    uint64_t h0, uint64_t h1,
+                    const ScanDeadline& deadline,
+                    uint64_t& visited_h1);
     };
 
 }
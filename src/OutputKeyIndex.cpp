@@ -0,0 +1,182 @@
+#include "OutputKeyIndex.h"
+#include "MicroCore.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace xmreg
+{
+
+namespace
+{
+    using key_record = SidecarIndex<public_key, output_location>::record;
+
+    // blocks added to the index at a time, as one segment
+    const uint64_t BUILD_STEP {100000};
+
+
+    /**
+     * Collects keys of outputs in visited blocks.
+     */
+    class OutputKeyVisitor : public ChainVisitor
+    {
+    public:
+
+        vector<key_record> records;
+
+        uint32_t
+        fields() const override { return VISIT_TX_PREFIX; }
+
+        unique_ptr<ChainVisitor>
+        fork() const override
+        {
+            return unique_ptr<ChainVisitor> {new OutputKeyVisitor()};
+        }
+
+        void
+        merge(ChainVisitor& range_visitor) override
+        {
+            OutputKeyVisitor& other = static_cast<OutputKeyVisitor&>(range_visitor);
+
+            records.insert(records.end(), other.records.begin(), other.records.end());
+        }
+
+        void
+        visit_tx(const tx_visit& tx) override
+        {
+            const vector<tx_out>& vout = tx.prefix->vout;
+
+            for (size_t i = 0; i < vout.size(); ++i)
+            {
+                if (vout[i].target.type() != typeid(txout_to_key))
+                {
+                    continue;
+                }
+
+                records.push_back(key_record {
+                        boost::get<txout_to_key>(vout[i].target).key,
+                        output_location {*tx.tx_hash, i, tx.height}});
+            }
+        }
+    };
+
+} // namespace
+
+
+
+    bool
+    OutputKeyIndex::open(const string& index_path, MicroCore& mcore)
+    {
+        return m_index.open(index_path, mcore);
+    }
+
+
+    bool
+    OutputKeyIndex::find(const public_key& output_pubkey, output_location& location) const
+    {
+        vector<output_location> locations;
+
+        m_index.find(output_pubkey, locations);
+
+        if (locations.empty())
+        {
+            return false;
+        }
+
+        location = locations.front();
+
+        return true;
+    }
+
+
+    bool
+    OutputKeyIndex::query_batch(istream& in, ostream& out) const
+    {
+        out << "output_key,tx_hash,output_index,height\n";
+
+        string line;
+
+        while (getline(in, line))
+        {
+            istringstream iss {line};
+
+            string key_str;
+
+            if (!(iss >> key_str) || key_str[0] == '#')
+            {
+                continue;
+            }
+
+            public_key output_pubkey;
+
+            if (!parse_str_secret_key(key_str, output_pubkey))
+            {
+                return false;
+            }
+
+            vector<output_location> locations;
+
+            m_index.find(output_pubkey, locations);
+
+            for (const output_location& location: locations)
+            {
+                out << key_str
+                    << "," << epee::string_tools::pod_to_hex(location.tx_hash)
+                    << "," << location.index_in_tx
+                    << "," << location.height << "\n";
+            }
+        }
+
+        out.flush();
+
+        return static_cast<bool>(out);
+    }
+
+
+    /**
+     * Create index in index_path, or add to existing
+     * one, blocks up to, but not including, to_height.
+     */
+    bool
+    OutputKeyIndex::build(MicroCore& mcore,
+                          const string& index_path,
+                          uint64_t to_height,
+                          bool show_progress)
+    {
+        SidecarIndex<public_key, output_location> index;
+
+        if (!index.open(index_path, mcore, true))
+        {
+            return false;
+        }
+
+        to_height = std::min(to_height, mcore.get_core().get_current_blockchain_height());
+
+        while (index.height() < to_height)
+        {
+            uint64_t h1 = std::min(index.height() + BUILD_STEP, to_height);
+
+            OutputKeyVisitor visitor;
+
+            if (!mcore.visit_chain({&visitor}, index.height(), h1).complete
+                || !index.append(h1, visitor.records))
+            {
+                return false;
+            }
+
+            if (show_progress)
+            {
+                cout << "\r - output key index height: "
+                     << index.height() << "/" << to_height << flush;
+            }
+        }
+
+        if (show_progress)
+        {
+            cout << endl;
+        }
+
+        return true;
+    }
+
+}
@@ -0,0 +1,71 @@
+#ifndef XMREG01_OUTPUTKEYINDEX_H
+#define XMREG01_OUTPUTKEYINDEX_H
+
+#include "monero_headers.h"
+#include "SidecarIndex.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    class MicroCore;
+
+    struct output_location
+    {
+        crypto::hash tx_hash;
+        uint64_t index_in_tx;
+        uint64_t height;
+    };
+
+
+    /**
+     * Sidecar index of txs by public keys of their outputs, for
+     * output keys which come without height of their block.
+     *
+     * Output keys are unique in a valid blockchain, so
+     * find gives the first output having the key.
+     */
+    class OutputKeyIndex
+    {
+    public:
+
+        bool
+        open(const string& index_path, MicroCore& mcore);
+
+        uint64_t
+        height() const { return m_index.height(); }
+
+        bool
+        find(const public_key& output_pubkey, output_location& location) const;
+
+        /**
+         * Find outputs of keys, one per line in hex, and write
+         * them as csv of:
+         *
+         *   output_key,tx_hash,output_index,height
+         *
+         * in the input order. Keys not found have no lines.
+         */
+        bool
+        query_batch(istream& in, ostream& out) const;
+
+        static bool
+        build(MicroCore& mcore,
+              const string& index_path,
+              uint64_t to_height,
+              bool show_progress = false);
+
+    private:
+
+        SidecarIndex<public_key, output_location> m_index;
+    };
+
+}
+
+#endif //XMREG01_OUTPUTKEYINDEX_H
@@ -0,0 +1,145 @@
+#include "OwnSpends.h"
+#include "MicroCore.h"
+
+namespace xmreg
+{
+
+    bool
+    verify_own_spends(MicroCore& mcore,
+                      vector<for_signatures>& spends,
+                      vector<own_spend_check>& checks)
+    {
+        size_t no_of_spends = spends.size();
+
+        checks.assign(no_of_spends, own_spend_check {});
+
+        vector<transaction> txs(no_of_spends);
+
+        // ring members of all spends, and where each spend's start
+        vector<pair<uint64_t, uint64_t>> amount_indices;
+        vector<size_t> members_begin(no_of_spends, 0);
+
+        for (size_t i = 0; i < no_of_spends; ++i)
+        {
+            members_begin[i] = amount_indices.size();
+
+            if (!mcore.get_tx(spends[i].tx_hash, txs[i]))
+            {
+                return false;
+            }
+
+            const vector<txin_v>& vin = txs[i].vin;
+
+            for (size_t j = 0; j < vin.size(); ++j)
+            {
+                if (vin[j].type() != typeid(txin_to_key))
+                {
+                    continue;
+                }
+
+                const txin_to_key& in = boost::get<txin_to_key>(vin[j]);
+
+                if (in.k_image != spends[i].kimg)
+                {
+                    continue;
+                }
+
+                checks[i].input_found = true;
+                checks[i].input_index = j;
+
+                // key offsets are relative to the previous one
+                uint64_t global_index {0};
+
+                for (const uint64_t& offset: in.key_offsets)
+                {
+                    global_index += offset;
+
+                    amount_indices.push_back(make_pair(in.amount, global_index));
+                }
+
+                break;
+            }
+        }
+
+        vector<output_info> outputs;
+
+        if (!mcore.get_output_infos(amount_indices, outputs))
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < no_of_spends; ++i)
+        {
+            size_t members_end = i + 1 < no_of_spends
+                                 ? members_begin[i + 1]
+                                 : amount_indices.size();
+
+            for_signatures& spend = spends[i];
+
+            spend.outs_pub_keys.clear();
+
+            for (size_t k = members_begin[i]; k < members_end; ++k)
+            {
+                if (outputs[k].pubkey == spend.in_ephemeral.pub)
+                {
+                    spend.real_output = spend.outs_pub_keys.size();
+                    checks[i].in_ring = true;
+                }
+
+                spend.outs_pub_keys.push_back(outputs[k].pubkey);
+            }
+        }
+
+        return mcore.get_executor().run(
+                0, no_of_spends, 1,
+                [&](size_t worker_i, uint64_t i0, uint64_t i1) -> bool
+                {
+                    // reused for each spend of the range
+                    vector<const public_key*> ring_keys;
+
+                    for (uint64_t i = i0; i < i1; ++i)
+                    {
+                        const for_signatures& spend = spends[i];
+                        const transaction& tx       = txs[i];
+
+                        own_spend_check& check = checks[i];
+
+                        if (!check.input_found)
+                        {
+                            continue;
+                        }
+
+                        key_image k_image;
+
+                        crypto::generate_key_image(spend.in_ephemeral.pub,
+                                                   spend.in_ephemeral.sec,
+                                                   k_image);
+
+                        check.key_image_ok = k_image == spend.kimg;
+
+                        if (check.input_index >= tx.signatures.size()
+                            || tx.signatures[check.input_index].size()
+                               != spend.outs_pub_keys.size())
+                        {
+                            continue;
+                        }
+
+                        ring_keys.clear();
+
+                        for (const public_key& key: spend.outs_pub_keys)
+                        {
+                            ring_keys.push_back(&key);
+                        }
+
+                        check.signature_ok = crypto::check_ring_signature(
+                                get_transaction_prefix_hash(tx),
+                                spend.kimg,
+                                ring_keys,
+                                tx.signatures[check.input_index].data());
+                    }
+
+                    return true;
+                });
+    }
+
+}
@@ -0,0 +1,68 @@
+#ifndef XMREG01_OWNSPENDS_H
+#define XMREG01_OWNSPENDS_H
+
+#include "monero_headers.h"
+
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    class MicroCore;
+
+    /**
+     * Our output spent in tx_hash, with its key image
+     * and the keys it can be spent with.
+     *
+     * outs_pub_keys and real_output are filled in
+     * by verify_own_spends.
+     */
+    struct for_signatures
+    {
+        crypto::hash tx_hash ;
+        crypto::key_image kimg ;
+        std::vector<crypto::public_key> outs_pub_keys;
+        cryptonote::keypair in_ephemeral;
+        size_t real_output {0};
+    };
+
+
+    struct own_spend_check
+    {
+        // of the spending tx having the key image
+        bool input_found {false};
+        size_t input_index {0};
+
+        // our output's key is in the ring, at real_output
+        bool in_ring {false};
+
+        // key image is made from in_ephemeral
+        bool key_image_ok {false};
+
+        bool signature_ok {false};
+
+        bool
+        ok() const { return in_ring && key_image_ok && signature_ok; }
+    };
+
+
+    /**
+     * Prove that spends are ours: for each, find the input
+     * with its key image in the spending tx and our output in its
+     * ring, and check the ring signature.
+     *
+     * Ring members of all spends are resolved with one
+     * get_output_infos call, and the checks are done in
+     * parallel by mcore's executor.
+     */
+    bool
+    verify_own_spends(MicroCore& mcore,
+                      vector<for_signatures>& spends,
+                      vector<own_spend_check>& checks);
+
+}
+
+#endif //XMREG01_OWNSPENDS_H
@@ -0,0 +1,395 @@
+#include "PaymentIdIndex.h"
+#include "MicroCore.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+
+namespace xmreg
+{
+
+namespace
+{
+    namespace bf = boost::filesystem;
+
+    using plain_record     = SidecarIndex<crypto::hash, payment_id_tx>::record;
+    using encrypted_record = SidecarIndex<short_payment_id, encrypted_payment_id_tx>::record;
+
+    // byte appended to key derivation to get
+    // the key of payment id encryption
+    const char ENCRYPTED_PAYMENT_ID_TAIL {static_cast<char>(0x8d)};
+
+    // blocks added to the index at a time, as one segment
+    const uint64_t BUILD_STEP {100000};
+
+
+    /**
+     * Collects payment ids of txs in visited blocks.
+     */
+    class PaymentIdVisitor : public ChainVisitor
+    {
+    public:
+
+        vector<plain_record> plain;
+        vector<encrypted_record> encrypted;
+
+        uint32_t
+        fields() const override { return VISIT_TX_PREFIX; }
+
+        unique_ptr<ChainVisitor>
+        fork() const override
+        {
+            return unique_ptr<ChainVisitor> {new PaymentIdVisitor()};
+        }
+
+        void
+        merge(ChainVisitor& range_visitor) override
+        {
+            PaymentIdVisitor& other = static_cast<PaymentIdVisitor&>(range_visitor);
+
+            plain.insert(plain.end(), other.plain.begin(), other.plain.end());
+            encrypted.insert(encrypted.end(),
+                             other.encrypted.begin(), other.encrypted.end());
+        }
+
+        void
+        visit_tx(const tx_visit& tx) override
+        {
+            const vector<uint8_t>& extra = tx.prefix->extra;
+
+            tx_extra_view extra_view;
+
+            // fields before a malformed one are still used
+            scan_tx_extra(extra.data(), extra.size(), extra_view);
+
+            if (extra_view.nonce == nullptr)
+            {
+                return;
+            }
+
+            crypto::hash payment_id;
+
+            if (get_payment_id(extra_view, payment_id))
+            {
+                plain.push_back(plain_record {payment_id,
+                                              payment_id_tx {*tx.tx_hash, tx.height}});
+                return;
+            }
+
+            encrypted_record record;
+
+            if (get_encrypted_payment_id(extra_view, record.key))
+            {
+                record.value = encrypted_payment_id_tx {
+                        *tx.tx_hash, tx.height,
+                        extra_view.tx_pub_key != nullptr
+                        ? *extra_view.tx_pub_key : null_pkey};
+
+                encrypted.push_back(record);
+            }
+        }
+    };
+
+
+    uint64_t
+    short_id_bits(const short_payment_id& payment_id)
+    {
+        uint64_t bits;
+
+        memcpy(&bits, payment_id.data, sizeof(bits));
+
+        return bits;
+    }
+
+
+    bool
+    decrypt_payment_id(const short_payment_id& encrypted_id,
+                       const public_key& tx_pub_key,
+                       const secret_key& private_view_key,
+                       short_payment_id& payment_id)
+    {
+        key_derivation derivation;
+
+        if (!generate_key_derivation(tx_pub_key, private_view_key, derivation))
+        {
+            return false;
+        }
+
+        char data[sizeof(key_derivation) + 1];
+
+        memcpy(data, &derivation, sizeof(key_derivation));
+
+        data[sizeof(key_derivation)] = ENCRYPTED_PAYMENT_ID_TAIL;
+
+        crypto::hash key;
+
+        cn_fast_hash(data, sizeof(data), key);
+
+        for (size_t i = 0; i < sizeof(short_payment_id); ++i)
+        {
+            payment_id.data[i] = encrypted_id.data[i]
+                                 ^ reinterpret_cast<const unsigned char*>(&key)[i];
+        }
+
+        return true;
+    }
+
+} // namespace
+
+
+
+    bool
+    PaymentIdIndex::open(const string& index_path, MicroCore& mcore)
+    {
+        return m_plain.open((bf::path(index_path) / "plain").string(), mcore)
+               && m_encrypted.open((bf::path(index_path) / "encrypted").string(), mcore);
+    }
+
+
+    uint64_t
+    PaymentIdIndex::height() const
+    {
+        return std::min(m_plain.height(), m_encrypted.height());
+    }
+
+
+    vector<payment_id_tx>
+    PaymentIdIndex::find(const crypto::hash& payment_id) const
+    {
+        vector<payment_id_tx> txs;
+
+        m_plain.find(payment_id, txs);
+
+        return txs;
+    }
+
+
+    /**
+     * Decrypt payment id of each tx having an 8 byte one,
+     * which is one key derivation per such tx.
+     */
+    vector<vector<payment_id_tx>>
+    PaymentIdIndex::find_decrypted(const vector<short_payment_id>& payment_ids,
+                                   const secret_key& private_view_key) const
+    {
+        vector<vector<payment_id_tx>> txs(payment_ids.size());
+
+        unordered_multimap<uint64_t, size_t> wanted;
+
+        for (size_t i = 0; i < payment_ids.size(); ++i)
+        {
+            wanted.insert(make_pair(short_id_bits(payment_ids[i]), i));
+        }
+
+        m_encrypted.for_each([&](const encrypted_record& record)
+        {
+            short_payment_id payment_id;
+
+            if (!decrypt_payment_id(record.key, record.value.tx_pub_key,
+                                    private_view_key, payment_id))
+            {
+                return;
+            }
+
+            auto found = wanted.equal_range(short_id_bits(payment_id));
+
+            for (auto it = found.first; it != found.second; ++it)
+            {
+                txs[it->second].push_back(payment_id_tx {record.value.tx_hash,
+                                                         record.value.height});
+            }
+        });
+
+        // records come in order of their encrypted ids
+        for (vector<payment_id_tx>& id_txs: txs)
+        {
+            std::sort(id_txs.begin(), id_txs.end(),
+                      [](const payment_id_tx& a, const payment_id_tx& b)
+                      {
+                          return a.height < b.height;
+                      });
+        }
+
+        return txs;
+    }
+
+
+    bool
+    PaymentIdIndex::query_batch(istream& in,
+                                const secret_key& private_view_key,
+                                ostream& out) const
+    {
+        // input lines, and for short ids, their
+        // index in short_ids, or -1 for long ones
+        vector<pair<string, int64_t>> lines;
+
+        vector<short_payment_id> short_ids;
+
+        string line;
+
+        while (getline(in, line))
+        {
+            istringstream iss {line};
+
+            string id_str;
+
+            if (!(iss >> id_str) || id_str[0] == '#')
+            {
+                continue;
+            }
+
+            if (id_str.size() == sizeof(short_payment_id) * 2)
+            {
+                short_payment_id payment_id;
+
+                if (!epee::string_tools::hex_to_pod(id_str, payment_id))
+                {
+                    cerr << "Cant parse payment id: " << id_str << endl;
+                    return false;
+                }
+
+                lines.push_back(make_pair(id_str, static_cast<int64_t>(short_ids.size())));
+                short_ids.push_back(payment_id);
+            }
+            else
+            {
+                lines.push_back(make_pair(id_str, -1));
+            }
+        }
+
+        vector<vector<payment_id_tx>> short_id_txs;
+
+        if (!short_ids.empty())
+        {
+            short_id_txs = find_decrypted(short_ids, private_view_key);
+        }
+
+        out << "payment_id,tx_hash,height\n";
+
+        for (const pair<string, int64_t>& id_line: lines)
+        {
+            vector<payment_id_tx> txs;
+
+            if (id_line.second >= 0)
+            {
+                txs = short_id_txs[id_line.second];
+            }
+            else
+            {
+                crypto::hash payment_id;
+
+                if (!epee::string_tools::hex_to_pod(id_line.first, payment_id))
+                {
+                    cerr << "Cant parse payment id: " << id_line.first << endl;
+                    return false;
+                }
+
+                txs = find(payment_id);
+            }
+
+            for (const payment_id_tx& tx: txs)
+            {
+                out << id_line.first
+                    << "," << epee::string_tools::pod_to_hex(tx.tx_hash)
+                    << "," << tx.height << "\n";
+            }
+        }
+
+        out.flush();
+
+        return static_cast<bool>(out);
+    }
+
+
+    /**
+     * Create index in index_path, or add to existing
+     * one, blocks up to, but not including, to_height.
+     */
+    bool
+    PaymentIdIndex::build(MicroCore& mcore,
+                          const string& index_path,
+                          uint64_t to_height,
+                          bool show_progress)
+    {
+        SidecarIndex<crypto::hash, payment_id_tx> plain;
+        SidecarIndex<short_payment_id, encrypted_payment_id_tx> encrypted;
+
+        if (!plain.open((bf::path(index_path) / "plain").string(), mcore, true)
+            || !encrypted.open((bf::path(index_path) / "encrypted").string(), mcore, true))
+        {
+            return false;
+        }
+
+        to_height = std::min(to_height, mcore.get_core().get_current_blockchain_height());
+
+        // parts can differ, if an update did not finish
+        uint64_t height = std::min(plain.height(), encrypted.height());
+
+        while (height < to_height)
+        {
+            uint64_t h1 = std::min(height + BUILD_STEP, to_height);
+
+            PaymentIdVisitor visitor;
+
+            if (!mcore.visit_chain({&visitor}, height, h1).complete)
+            {
+                return false;
+            }
+
+            if (plain.height() < h1)
+            {
+                uint64_t plain_h0 = plain.height();
+
+                visitor.plain.erase(
+                        std::remove_if(visitor.plain.begin(), visitor.plain.end(),
+                                       [&](const plain_record& r)
+                                       {
+                                           return r.value.height < plain_h0;
+                                       }),
+                        visitor.plain.end());
+
+                if (!plain.append(h1, visitor.plain))
+                {
+                    return false;
+                }
+            }
+
+            if (encrypted.height() < h1)
+            {
+                uint64_t encrypted_h0 = encrypted.height();
+
+                visitor.encrypted.erase(
+                        std::remove_if(visitor.encrypted.begin(), visitor.encrypted.end(),
+                                       [&](const encrypted_record& r)
+                                       {
+                                           return r.value.height < encrypted_h0;
+                                       }),
+                        visitor.encrypted.end());
+
+                if (!encrypted.append(h1, visitor.encrypted))
+                {
+                    return false;
+                }
+            }
+
+            height = h1;
+
+            if (show_progress)
+            {
+                cout << "\r - payment id index height: "
+                     << height << "/" << to_height << flush;
+            }
+        }
+
+        if (show_progress)
+        {
+            cout << endl;
+        }
+
+        return true;
+    }
+
+}
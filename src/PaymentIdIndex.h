@@ -0,0 +1,97 @@
+#ifndef XMREG01_PAYMENTIDINDEX_H
+#define XMREG01_PAYMENTIDINDEX_H
+
+#include "monero_headers.h"
+#include "SidecarIndex.h"
+#include "TxExtraScanner.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    class MicroCore;
+
+    struct payment_id_tx
+    {
+        crypto::hash tx_hash;
+        uint64_t height;
+    };
+
+
+    struct encrypted_payment_id_tx
+    {
+        crypto::hash tx_hash;
+        uint64_t height;
+
+        // to decrypt the payment id
+        public_key tx_pub_key;
+    };
+
+
+    /**
+     * Sidecar index of txs by payment ids in their extra nonce,
+     * kept in two SidecarIndex folders of index_path: plain for
+     * 32 byte payment ids, and encrypted for 8 byte ones, as they
+     * are in txs.
+     *
+     * Merchants know the 8 byte ids before they are encrypted, so
+     * these are found by decrypting payment ids of all txs having
+     * them, with merchant's private view key. Only the index is
+     * read for this, not the blockchain.
+     */
+    class PaymentIdIndex
+    {
+    public:
+
+        bool
+        open(const string& index_path, MicroCore& mcore);
+
+        // both parts are complete up to it
+        uint64_t
+        height() const;
+
+        vector<payment_id_tx>
+        find(const crypto::hash& payment_id) const;
+
+        /**
+         * Txs of each of the 8 byte payment ids,
+         * once decrypted with private_view_key.
+         */
+        vector<vector<payment_id_tx>>
+        find_decrypted(const vector<short_payment_id>& payment_ids,
+                       const secret_key& private_view_key) const;
+
+        /**
+         * Find txs of payment ids, one per line in hex, 64 or 16
+         * characters long, and write them as csv of:
+         *
+         *   payment_id,tx_hash,height
+         *
+         * in the input order. Payment ids without txs have no lines.
+         */
+        bool
+        query_batch(istream& in,
+                    const secret_key& private_view_key,
+                    ostream& out) const;
+
+        static bool
+        build(MicroCore& mcore,
+              const string& index_path,
+              uint64_t to_height,
+              bool show_progress = false);
+
+    private:
+
+        SidecarIndex<crypto::hash, payment_id_tx> m_plain;
+        SidecarIndex<short_payment_id, encrypted_payment_id_tx> m_encrypted;
+    };
+
+}
+
+#endif //XMREG01_PAYMENTIDINDEX_H
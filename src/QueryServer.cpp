@@ -0,0 +1,642 @@
+#include "QueryServer.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+namespace xmreg
+{
+
+namespace
+{
+    // requests larger than that are not valid
+    const uint32_t MAX_FRAME_SIZE {1 << 20};
+
+    // requests of a connection queued or being answered,
+    // before we stop reading more of them
+    const size_t MAX_PENDING_REQUESTS {256};
+
+    // how often, in ms, stop flag is checked
+    // while waiting for connections
+    const int ACCEPT_POLL_MS {250};
+
+
+    template <typename T>
+    void
+    append_pod(string& out, const T& value)
+    {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+
+    template <typename T>
+    bool
+    read_pod(const string& in, size_t& offset, T& value)
+    {
+        if (in.size() < offset + sizeof(T))
+        {
+            return false;
+        }
+
+        memcpy(&value, in.data() + offset, sizeof(T));
+
+        offset += sizeof(T);
+
+        return true;
+    }
+
+
+    bool
+    recv_all(int fd, char* buf, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t n = recv(fd, buf, size, 0);
+
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (n <= 0)
+            {
+                return false;
+            }
+
+            buf  += n;
+            size -= n;
+        }
+
+        return true;
+    }
+
+
+    bool
+    send_all(int fd, const char* buf, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t n = send(fd, buf, size, MSG_NOSIGNAL);
+
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (n <= 0)
+            {
+                return false;
+            }
+
+            buf  += n;
+            size -= n;
+        }
+
+        return true;
+    }
+
+} // namespace
+
+
+
+    QueryServer::connection::~connection()
+    {
+        ::close(fd);
+    }
+
+
+    QueryServer::QueryServer(MicroCore& mcore,
+                             const ScanSidecar* sidecar,
+                             size_t no_of_workers)
+            : m_mcore {mcore},
+              m_sidecar {sidecar},
+              m_no_of_workers {std::max<size_t>(no_of_workers, 1)},
+              m_search {mcore.get_reader()}
+    {}
+
+
+    bool
+    QueryServer::run(const string& socket_path, const std::atomic<bool>& stop)
+    {
+        sockaddr_un addr;
+
+        if (socket_path.size() >= sizeof(addr.sun_path))
+        {
+            cerr << "Socket path too long: " << socket_path << endl;
+            return false;
+        }
+
+        int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (listen_fd < 0)
+        {
+            cerr << "Cant create socket: " << strerror(errno) << endl;
+            return false;
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+
+        // socket file left by previous run
+        unlink(socket_path.c_str());
+
+        if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+            || listen(listen_fd, SOMAXCONN) != 0)
+        {
+            cerr << "Cant listen on " << socket_path << ": " << strerror(errno) << endl;
+            ::close(listen_fd);
+            return false;
+        }
+
+        m_stopping = false;
+
+        vector<thread> workers;
+
+        for (size_t i = 0; i < m_no_of_workers; ++i)
+        {
+            workers.emplace_back(&QueryServer::work, this);
+        }
+
+        vector<reader> readers;
+
+        while (!stop)
+        {
+            // join readers of closed connections, so
+            // their threads are not kept until we stop
+            for (size_t i = 0; i < readers.size();)
+            {
+                if (!*readers[i].exited)
+                {
+                    ++i;
+                    continue;
+                }
+
+                readers[i].t.join();
+
+                if (i + 1 < readers.size())
+                {
+                    readers[i] = std::move(readers.back());
+                }
+
+                readers.pop_back();
+            }
+
+            pollfd pfd {listen_fd, POLLIN, 0};
+
+            int ready = ::poll(&pfd, 1, ACCEPT_POLL_MS);
+
+            if (ready <= 0)
+            {
+                continue;
+            }
+
+            int fd = accept(listen_fd, nullptr, nullptr);
+
+            if (fd < 0)
+            {
+                continue;
+            }
+
+            shared_ptr<connection> conn = make_shared<connection>(fd);
+
+            shared_ptr<atomic<bool>> exited = make_shared<atomic<bool>>(false);
+
+            thread t {[this, conn, exited]()
+            {
+                read_requests(conn);
+                *exited = true;
+            }};
+
+            readers.push_back(reader {std::move(t), conn, exited});
+        }
+
+        ::close(listen_fd);
+        unlink(socket_path.c_str());
+
+        // wake up readers blocked in recv
+        for (reader& r: readers)
+        {
+            if (shared_ptr<connection> conn = r.conn.lock())
+            {
+                shutdown(conn->fd, SHUT_RDWR);
+            }
+        }
+
+        for (reader& r: readers)
+        {
+            r.t.join();
+        }
+
+        // searches still running are answered as failed,
+        // and their responses queued for the workers
+        m_search.stop();
+
+        {
+            lock_guard<mutex> lock {m_jobs_mutex};
+            m_stopping = true;
+        }
+
+        m_jobs_cv.notify_all();
+
+        for (thread& worker: workers)
+        {
+            worker.join();
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Read frames from a connection and queue them for workers,
+     * without waiting for earlier ones to be answered, unless
+     * there are too many of them.
+     */
+    void
+    QueryServer::read_requests(shared_ptr<connection> conn)
+    {
+        while (true)
+        {
+            {
+                unique_lock<mutex> lock {conn->pending_mutex};
+
+                conn->pending_cv.wait(lock, [&]
+                {
+                    return conn->no_of_pending < MAX_PENDING_REQUESTS;
+                });
+            }
+
+            uint32_t size;
+
+            if (!recv_all(conn->fd, reinterpret_cast<char*>(&size), sizeof(size)))
+            {
+                return;
+            }
+
+            if (size < sizeof(uint32_t) + sizeof(uint8_t) || size > MAX_FRAME_SIZE)
+            {
+                // cant find where next frame starts,
+                // so the connection is dropped
+                cerr << "Invalid query frame size: " << size << endl;
+                return;
+            }
+
+            string frame(size, '\0');
+
+            if (!recv_all(conn->fd, &frame[0], size))
+            {
+                return;
+            }
+
+            job j;
+
+            size_t offset {0};
+
+            read_pod(frame, offset, j.request_id);
+            read_pod(frame, offset, j.type);
+
+            j.conn    = conn;
+            j.payload = frame.substr(offset);
+
+            {
+                lock_guard<mutex> lock {conn->pending_mutex};
+                ++conn->no_of_pending;
+            }
+
+            add_job(std::move(j));
+        }
+    }
+
+
+    void
+    QueryServer::add_job(job j)
+    {
+        {
+            lock_guard<mutex> lock {m_jobs_mutex};
+            m_jobs.push_back(std::move(j));
+        }
+
+        m_jobs_cv.notify_one();
+    }
+
+
+    void
+    QueryServer::work()
+    {
+        while (true)
+        {
+            job j;
+
+            {
+                unique_lock<mutex> lock {m_jobs_mutex};
+
+                m_jobs_cv.wait(lock, [&]{ return m_stopping || !m_jobs.empty(); });
+
+                if (m_jobs.empty())
+                {
+                    return;
+                }
+
+                j = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+
+            string response;
+
+            bool answered_later {false};
+
+            status st = handle(j, response, answered_later);
+
+            if (answered_later)
+            {
+                continue;
+            }
+
+            if (st != status::ok)
+            {
+                response.clear();
+            }
+
+            // client could have gone, which is not our problem
+            send_response(*j.conn, j.request_id, st, response);
+        }
+    }
+
+
+    QueryServer::status
+    QueryServer::handle(const job& j, string& response, bool& answered_later)
+    {
+        try
+        {
+            switch (static_cast<request_type>(j.type))
+            {
+                case request_type::key_image_spent:
+                    return key_image_spent(j.payload, response);
+                case request_type::outputs_in_tx:
+                    return outputs_in_tx(j.payload, response);
+                case request_type::spending_tx:
+                    return spending_tx(j, response, answered_later);
+                case request_type::output_by_key:
+                    return output_by_key(j.payload, response);
+                default:
+                    return status::bad_request;
+            }
+        }
+        catch (const exception& e)
+        {
+            cerr << e.what() << endl;
+            return status::error;
+        }
+    }
+
+
+    QueryServer::status
+    QueryServer::key_image_spent(const string& payload, string& response)
+    {
+        size_t offset {0};
+
+        key_image k_image;
+
+        if (!read_pod(payload, offset, k_image))
+        {
+            return status::bad_request;
+        }
+
+        uint8_t spent = m_mcore.get_core().have_tx_keyimg_as_spent(k_image);
+
+        append_pod(response, spent);
+
+        return status::ok;
+    }
+
+
+    QueryServer::status
+    QueryServer::outputs_in_tx(const string& payload, string& response)
+    {
+        size_t offset {0};
+
+        crypto::hash tx_hash;
+        secret_key private_view_key;
+        public_key public_spend_key;
+
+        if (!read_pod(payload, offset, tx_hash)
+            || !read_pod(payload, offset, private_view_key)
+            || !read_pod(payload, offset, public_spend_key))
+        {
+            return status::bad_request;
+        }
+
+        uint64_t tx_height;
+
+        if (!m_mcore.get_tx_height(tx_hash, tx_height))
+        {
+            return status::not_found;
+        }
+
+        ChainReader::ReadTxn txn;
+
+        blob_view tx_blob;
+
+        transaction_prefix tx;
+
+        if (!m_mcore.get_reader().begin_read(txn)
+            || !txn.get_tx_blob(tx_hash, tx_blob)
+            || !parse_tx_prefix_from_view(tx_blob, tx))
+        {
+            return status::not_found;
+        }
+
+        vector<public_key> output_keys;
+
+        for (const tx_out& out: tx.vout)
+        {
+            output_keys.push_back(out.target.type() == typeid(txout_to_key)
+                                  ? boost::get<txout_to_key>(out.target).key
+                                  : null_pkey);
+        }
+
+        vector<size_t> our_indices = get_belonging_output_indices(
+                scan_tx_pub_key(tx.extra),
+                output_keys.data(), output_keys.size(),
+                private_view_key, public_spend_key);
+
+        append_pod(response, tx_height);
+        append_pod(response, static_cast<uint32_t>(our_indices.size()));
+
+        for (size_t i: our_indices)
+        {
+            append_pod(response, static_cast<uint32_t>(i));
+            append_pod(response, tx.vout[i].amount);
+            append_pod(response, output_keys[i]);
+        }
+
+        return status::ok;
+    }
+
+
+    /**
+     * Look for spending tx in the sidecar first. If it is not there,
+     * it is searched for in a pass over all txs, together with key
+     * images asked for by other clients at the same time, and the
+     * search's callback queues the job again with its result.
+     */
+    QueryServer::status
+    QueryServer::spending_tx(const job& j, string& response, bool& answered_later)
+    {
+        if (j.searched)
+        {
+            if (!j.search_complete)
+            {
+                return status::error;
+            }
+
+            if (j.tx_hash == null_hash)
+            {
+                return status::not_found;
+            }
+
+            return spending_tx_response(j.tx_hash, response);
+        }
+
+        size_t offset {0};
+
+        key_image k_image;
+
+        if (!read_pod(j.payload, offset, k_image))
+        {
+            return status::bad_request;
+        }
+
+        // no point in scanning for unspent key image
+        if (!m_mcore.get_core().have_tx_keyimg_as_spent(k_image))
+        {
+            return status::not_found;
+        }
+
+        unordered_map<key_image, crypto::hash> txs_found;
+
+        if (m_sidecar)
+        {
+            txs_found = m_mcore.find_txs_with_key_images(*m_sidecar, {k_image});
+        }
+
+        if (!txs_found.empty())
+        {
+            return spending_tx_response(txs_found.begin()->second, response);
+        }
+
+        shared_ptr<connection> conn = j.conn;
+        uint32_t request_id         = j.request_id;
+
+        // called from the search's scan thread, which should
+        // not wait for the db nor the client, so the response
+        // is made by a worker
+        auto answer = [this, conn, request_id](const key_image&,
+                                               const crypto::hash& tx_hash,
+                                               bool complete)
+        {
+            job searched_job;
+
+            searched_job.conn            = conn;
+            searched_job.request_id      = request_id;
+            searched_job.type            = static_cast<uint8_t>(request_type::spending_tx);
+            searched_job.searched        = true;
+            searched_job.tx_hash         = tx_hash;
+            searched_job.search_complete = complete;
+
+            add_job(std::move(searched_job));
+        };
+
+        m_search.search({k_image}, answer);
+
+        answered_later = true;
+
+        return status::ok;
+    }
+
+
+    QueryServer::status
+    QueryServer::spending_tx_response(const crypto::hash& tx_hash, string& response)
+    {
+        uint64_t tx_height;
+
+        if (!m_mcore.get_tx_height(tx_hash, tx_height))
+        {
+            return status::error;
+        }
+
+        append_pod(response, tx_hash);
+        append_pod(response, tx_height);
+
+        return status::ok;
+    }
+
+
+    QueryServer::status
+    QueryServer::output_by_key(const string& payload, string& response)
+    {
+        size_t offset {0};
+
+        public_key output_pubkey;
+
+        if (!read_pod(payload, offset, output_pubkey))
+        {
+            return status::bad_request;
+        }
+
+        output_location location;
+
+        if (!m_mcore.get_output_key_index().find(output_pubkey, location))
+        {
+            return status::not_found;
+        }
+
+        append_pod(response, location.tx_hash);
+        append_pod(response, static_cast<uint32_t>(location.index_in_tx));
+        append_pod(response, location.height);
+
+        return status::ok;
+    }
+
+
+    bool
+    QueryServer::send_response(connection& conn, uint32_t request_id,
+                               status st, const string& payload)
+    {
+        string frame;
+
+        frame.reserve(sizeof(uint32_t) * 2 + sizeof(uint8_t) + payload.size());
+
+        append_pod(frame, static_cast<uint32_t>(sizeof(uint32_t) + sizeof(uint8_t)
+                                                + payload.size()));
+        append_pod(frame, request_id);
+        append_pod(frame, static_cast<uint8_t>(st));
+
+        frame += payload;
+
+        bool sent {false};
+
+        {
+            lock_guard<mutex> lock {conn.write_mutex};
+
+            sent = send_all(conn.fd, frame.data(), frame.size());
+        }
+
+        // each request gets one response, so it is
+        // not pending any more, even if not sent
+        {
+            lock_guard<mutex> lock {conn.pending_mutex};
+            --conn.no_of_pending;
+        }
+
+        conn.pending_cv.notify_one();
+
+        return sent;
+    }
+
+}
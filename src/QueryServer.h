@@ -0,0 +1,185 @@
+#ifndef XMREG01_QUERYSERVER_H
+#define XMREG01_QUERYSERVER_H
+
+#include "MicroCore.h"
+#include "ScanSidecar.h"
+#include "SearchCoordinator.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    /**
+     * Answers queries over a Unix domain socket, keeping
+     * MicroCore and the blockchain open between them.
+     *
+     * Requests and responses are frames of integers in
+     * host byte order, as the socket is local:
+     *
+     *   request:  uint32 size | uint32 request_id | uint8 type | payload
+     *   response: uint32 size | uint32 request_id | uint8 status | payload
+     *
+     * where size is that of the rest of the frame. Requests
+     * (payload -> response payload) are:
+     *
+     *   key_image_spent: key image -> uint8 spent
+     *   outputs_in_tx:   tx hash, private view key, public spend key
+     *                    -> uint64 height, uint32 n,
+     *                       n x (uint32 index, uint64 amount, public key)
+     *   spending_tx:     key image -> tx hash, uint64 height
+     *   output_by_key:   output public key
+     *                    -> tx hash, uint32 index, uint64 height
+     *                    (needs output key index of mcore)
+     *
+     * A client can send many requests without waiting for
+     * responses. They are answered by a pool of workers, so responses
+     * can come in different order, and are matched by request_id.
+     * spending_tx requests needing a chain scan do not hold a worker
+     * while the scan runs. When it is done with them, they are queued
+     * again, and answered by a worker.
+     *
+     * Requests of a connection not answered yet are limited. When
+     * there are too many, no more are read until some are answered,
+     * so a client sending faster than it gets answers waits.
+     */
+    class QueryServer
+    {
+    public:
+
+        enum class request_type : uint8_t
+        {
+            key_image_spent = 1,
+            outputs_in_tx   = 2,
+            spending_tx     = 3,
+            output_by_key   = 4
+        };
+
+        enum class status : uint8_t
+        {
+            ok          = 0,
+            bad_request = 1,
+            not_found   = 2,
+            error       = 3
+        };
+
+        QueryServer(MicroCore& mcore,
+                    const ScanSidecar* sidecar,
+                    size_t no_of_workers);
+
+        QueryServer(const QueryServer&) = delete;
+        QueryServer& operator=(const QueryServer&) = delete;
+
+        /**
+         * Listen on socket_path until stop is set. Only once,
+         * as chain searches are stopped when it returns.
+         */
+        bool
+        run(const string& socket_path, const std::atomic<bool>& stop);
+
+    private:
+
+        struct connection
+        {
+            int fd;
+
+            // responses from different workers
+            // must not interleave
+            mutex write_mutex;
+
+            // requests read, but not answered yet
+            mutex pending_mutex;
+            condition_variable pending_cv;
+            size_t no_of_pending {0};
+
+            explicit connection(int fd_) : fd {fd_} {}
+
+            ~connection();
+        };
+
+        // thread reading requests of a connection
+        struct reader
+        {
+            thread t;
+            weak_ptr<connection> conn;
+
+            // set when the thread is done, so it can be joined
+            shared_ptr<atomic<bool>> exited;
+        };
+
+        struct job
+        {
+            shared_ptr<connection> conn;
+            uint32_t request_id;
+            uint8_t type;
+            string payload;
+
+            // spending_tx whose chain search is done,
+            // with tx found, or null_hash
+            bool searched {false};
+            crypto::hash tx_hash;
+            bool search_complete {false};
+        };
+
+        void
+        read_requests(shared_ptr<connection> conn);
+
+        void
+        add_job(job j);
+
+        void
+        work();
+
+        // answered_later is set if response is sent by someone else
+        status
+        handle(const job& j, string& response, bool& answered_later);
+
+        status
+        key_image_spent(const string& payload, string& response);
+
+        status
+        outputs_in_tx(const string& payload, string& response);
+
+        status
+        spending_tx(const job& j, string& response, bool& answered_later);
+
+        status
+        spending_tx_response(const crypto::hash& tx_hash, string& response);
+
+        status
+        output_by_key(const string& payload, string& response);
+
+        bool
+        send_response(connection& conn, uint32_t request_id,
+                      status st, const string& payload);
+
+        MicroCore& m_mcore;
+
+        const ScanSidecar* m_sidecar;
+
+        size_t m_no_of_workers;
+
+        mutex m_jobs_mutex;
+        condition_variable m_jobs_cv;
+        deque<job> m_jobs;
+        bool m_stopping {false};
+
+        // spending txs not in the sidecar are searched
+        // for in one chain pass shared by all workers.
+        // stopped by run() before its workers.
+        SearchCoordinator m_search;
+    };
+
+}
+
+#endif //XMREG01_QUERYSERVER_H
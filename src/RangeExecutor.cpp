@@ -0,0 +1,364 @@
+#include "RangeExecutor.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace xmreg
+{
+
+namespace
+{
+    // how long a thread waits before trying to steal
+    // again, when all ranges are taken but not done yet
+    const chrono::microseconds STEAL_BACKOFF {100};
+
+
+    uint64_t
+    elapsed_us(const chrono::steady_clock::time_point& from,
+               const chrono::steady_clock::time_point& to)
+    {
+        return chrono::duration_cast<chrono::microseconds>(to - from).count();
+    }
+}
+
+
+    RangeExecutor::RangeExecutor(size_t no_of_threads)
+            : m_no_of_threads {no_of_threads > 0
+                               ? no_of_threads
+                               : std::max<size_t>(std::thread::hardware_concurrency(), 1)}
+    {}
+
+
+    /**
+     * Do task on all blocks of [h0, h1), in ranges of about
+     * grain_blocks blocks' work on average, as given by summary.
+     *
+     * Ranges are done in any order, but each block is in exactly
+     * one of them. Returns false if any task returned false, in
+     * which case ranges not taken yet are not done.
+     */
+    bool
+    RangeExecutor::run(const BlockSummary& summary,
+                       uint64_t h0, uint64_t h1,
+                       uint64_t grain_blocks,
+                       const range_task& task)
+    {
+        if (h0 >= h1)
+        {
+            return true;
+        }
+
+        lock_guard<mutex> run_lock {m_run_mutex};
+
+        start();
+
+        vector<BlockSummary::height_range> parts = summary.split(h0, h1, m_no_of_threads);
+
+        for (size_t i = 0; i < parts.size(); ++i)
+        {
+            lock_guard<mutex> lock {m_workers[i]->ranges_mutex};
+
+            m_workers[i]->ranges.push_back(parts[i]);
+        }
+
+        m_task       = &task;
+        m_summary    = &summary;
+        m_grain_work = std::max<uint64_t>(
+                summary.work(h0, h1) / (h1 - h0) * std::max<uint64_t>(grain_blocks, 1), 1);
+
+        m_blocks_left = h1 - h0;
+        m_failed      = false;
+
+        {
+            unique_lock<mutex> lock {m_mutex};
+
+            m_no_of_working = m_no_of_threads;
+
+            ++m_run_id;
+
+            m_run_started.notify_all();
+
+            m_run_done.wait(lock, [&]() { return m_no_of_working == 0; });
+        }
+
+        // ranges not taken by a stopped run
+        for (unique_ptr<worker>& w: m_workers)
+        {
+            lock_guard<mutex> lock {w->ranges_mutex};
+
+            w->ranges.clear();
+        }
+
+        m_task    = nullptr;
+        m_summary = nullptr;
+
+        return !m_failed;
+    }
+
+
+    bool
+    RangeExecutor::run(uint64_t i0, uint64_t i1,
+                       uint64_t grain_items,
+                       const range_task& task)
+    {
+        // summary of no blocks has the same work for all heights
+        static const BlockSummary uniform;
+
+        return run(uniform, i0, i1, grain_items, task);
+    }
+
+
+    vector<RangeExecutor::worker_stats>
+    RangeExecutor::stats() const
+    {
+        vector<worker_stats> all_stats;
+
+        for (const unique_ptr<worker>& w: m_workers)
+        {
+            all_stats.push_back(worker_stats {w->busy_us, w->idle_us,
+                                              w->no_of_ranges, w->no_of_blocks,
+                                              w->no_of_steals});
+        }
+
+        return all_stats;
+    }
+
+
+    void
+    RangeExecutor::print_stats(ostream& out) const
+    {
+        vector<worker_stats> all_stats = stats();
+
+        for (size_t i = 0; i < all_stats.size(); ++i)
+        {
+            const worker_stats& s = all_stats[i];
+
+            uint64_t total_us = s.busy_us + s.idle_us;
+
+            out << " - worker " << i << ": utilization "
+                << (total_us > 0 ? s.busy_us * 100 / total_us : 0) << "%, "
+                << s.no_of_ranges << " ranges, "
+                << s.no_of_blocks << " blocks, "
+                << s.no_of_steals << " steals" << endl;
+        }
+    }
+
+
+    RangeExecutor::~RangeExecutor()
+    {
+        {
+            lock_guard<mutex> lock {m_mutex};
+
+            m_stop = true;
+        }
+
+        m_run_started.notify_all();
+
+        for (thread& t: m_threads)
+        {
+            t.join();
+        }
+    }
+
+
+    void
+    RangeExecutor::start()
+    {
+        if (!m_threads.empty())
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < m_no_of_threads; ++i)
+        {
+            m_workers.emplace_back(new worker());
+        }
+
+        for (size_t i = 0; i < m_no_of_threads; ++i)
+        {
+            m_threads.emplace_back(&RangeExecutor::worker_loop, this, i);
+        }
+    }
+
+
+    void
+    RangeExecutor::worker_loop(size_t worker_i)
+    {
+        uint64_t last_run_id {0};
+
+        while (true)
+        {
+            {
+                unique_lock<mutex> lock {m_mutex};
+
+                m_run_started.wait(lock, [&]()
+                {
+                    return m_stop || m_run_id != last_run_id;
+                });
+
+                if (m_stop)
+                {
+                    return;
+                }
+
+                last_run_id = m_run_id;
+            }
+
+            work(worker_i);
+
+            lock_guard<mutex> lock {m_mutex};
+
+            if (--m_no_of_working == 0)
+            {
+                m_run_done.notify_all();
+            }
+        }
+    }
+
+
+    void
+    RangeExecutor::work(size_t worker_i)
+    {
+        worker& self = *m_workers[worker_i];
+
+        chrono::steady_clock::time_point idle_start = chrono::steady_clock::now();
+
+        while (!m_failed)
+        {
+            BlockSummary::height_range range;
+
+            if (!take_own(worker_i, range))
+            {
+                // all ranges are done
+                if (m_blocks_left == 0)
+                {
+                    break;
+                }
+
+                if (!steal(worker_i))
+                {
+                    std::this_thread::sleep_for(STEAL_BACKOFF);
+                }
+
+                continue;
+            }
+
+            chrono::steady_clock::time_point busy_start = chrono::steady_clock::now();
+
+            self.idle_us += elapsed_us(idle_start, busy_start);
+
+            bool task_ok = (*m_task)(worker_i, range.h0, range.h1);
+
+            idle_start = chrono::steady_clock::now();
+
+            self.busy_us += elapsed_us(busy_start, idle_start);
+
+            if (!task_ok)
+            {
+                m_failed = true;
+                break;
+            }
+
+            ++self.no_of_ranges;
+
+            self.no_of_blocks += range.h1 - range.h0;
+            m_blocks_left     -= range.h1 - range.h0;
+        }
+
+        self.idle_us += elapsed_us(idle_start, chrono::steady_clock::now());
+    }
+
+
+    /**
+     * Take a range of about grain work from the front of own
+     * deque. The rest of it stays there, where it can be stolen.
+     */
+    bool
+    RangeExecutor::take_own(size_t worker_i, BlockSummary::height_range& range)
+    {
+        worker& self = *m_workers[worker_i];
+
+        lock_guard<mutex> lock {self.ranges_mutex};
+
+        if (self.ranges.empty())
+        {
+            return false;
+        }
+
+        range = self.ranges.front();
+
+        self.ranges.pop_front();
+
+        if (m_summary->work(range.h0, range.h1) > m_grain_work)
+        {
+            uint64_t cut = m_summary->cut(range.h0, range.h1, m_grain_work);
+
+            if (cut < range.h1)
+            {
+                self.ranges.push_front(BlockSummary::height_range {cut, range.h1});
+
+                range.h1 = cut;
+            }
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Move the back range of other worker's deque, or its second
+     * half if it is bigger than a grain, to own deque.
+     */
+    bool
+    RangeExecutor::steal(size_t worker_i)
+    {
+        for (size_t k = 1; k < m_no_of_threads; ++k)
+        {
+            worker& victim = *m_workers[(worker_i + k) % m_no_of_threads];
+
+            BlockSummary::height_range range;
+
+            {
+                lock_guard<mutex> lock {victim.ranges_mutex};
+
+                if (victim.ranges.empty())
+                {
+                    continue;
+                }
+
+                range = victim.ranges.back();
+
+                victim.ranges.pop_back();
+
+                uint64_t range_work = m_summary->work(range.h0, range.h1);
+
+                if (range_work > m_grain_work)
+                {
+                    uint64_t mid = m_summary->cut(range.h0, range.h1, range_work / 2);
+
+                    if (mid < range.h1)
+                    {
+                        victim.ranges.push_back(BlockSummary::height_range {range.h0, mid});
+
+                        range.h0 = mid;
+                    }
+                }
+            }
+
+            worker& self = *m_workers[worker_i];
+
+            {
+                lock_guard<mutex> lock {self.ranges_mutex};
+
+                self.ranges.push_back(range);
+            }
+
+            ++self.no_of_steals;
+
+            return true;
+        }
+
+        return false;
+    }
+
+}
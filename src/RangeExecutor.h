@@ -0,0 +1,140 @@
+#ifndef XMREG01_RANGEEXECUTOR_H
+#define XMREG01_RANGEEXECUTOR_H
+
+#include "BlockSummary.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace std;
+
+    /**
+     * Pool of threads doing a task on all blocks of a height range,
+     * shared by parallel scans of MicroCore.
+     *
+     * The range is first split into one part of equal work for each
+     * thread, put in its own deque. A thread takes ranges of about
+     * grain_blocks blocks' work from the front of its deque at a time.
+     * When its deque is empty, it steals the back range of the deque of
+     * other thread, splitting it in half if it is big enough, so that
+     * ranges with bursts of big txs do not leave threads idle.
+     *
+     * Runs are done one at a time. A task must not start a run.
+     */
+    class RangeExecutor
+    {
+    public:
+
+        // returns false to stop the run
+        using range_task = std::function<bool(size_t worker_i,
+                                              uint64_t h0, uint64_t h1)>;
+
+        // since the executor was made. idle time is
+        // counted only during runs, e.g., while stealing.
+        struct worker_stats
+        {
+            uint64_t busy_us;
+            uint64_t idle_us;
+            uint64_t no_of_ranges;
+            uint64_t no_of_blocks;
+            uint64_t no_of_steals;
+        };
+
+        // no_of_threads of 0 is number of cpu cores.
+        // threads are started with the first run.
+        explicit RangeExecutor(size_t no_of_threads = 0);
+
+        RangeExecutor(const RangeExecutor&) = delete;
+        RangeExecutor& operator=(const RangeExecutor&) = delete;
+
+        size_t
+        no_of_threads() const { return m_no_of_threads; }
+
+        bool
+        run(const BlockSummary& summary,
+            uint64_t h0, uint64_t h1,
+            uint64_t grain_blocks,
+            const range_task& task);
+
+        // items [i0, i1) of equal work, e.g., rings, instead of blocks
+        bool
+        run(uint64_t i0, uint64_t i1,
+            uint64_t grain_items,
+            const range_task& task);
+
+        vector<worker_stats>
+        stats() const;
+
+        void
+        print_stats(ostream& out) const;
+
+        ~RangeExecutor();
+
+    private:
+
+        struct worker
+        {
+            mutex ranges_mutex;
+
+            deque<BlockSummary::height_range> ranges;
+
+            std::atomic<uint64_t> busy_us {0};
+            std::atomic<uint64_t> idle_us {0};
+            std::atomic<uint64_t> no_of_ranges {0};
+            std::atomic<uint64_t> no_of_blocks {0};
+            std::atomic<uint64_t> no_of_steals {0};
+        };
+
+        void
+        start();
+
+        void
+        worker_loop(size_t worker_i);
+
+        void
+        work(size_t worker_i);
+
+        bool
+        take_own(size_t worker_i, BlockSummary::height_range& range);
+
+        bool
+        steal(size_t worker_i);
+
+        size_t m_no_of_threads;
+
+        vector<unique_ptr<worker>> m_workers;
+
+        vector<thread> m_threads;
+
+        // one run at a time
+        mutex m_run_mutex;
+
+        // current run
+        mutex m_mutex;
+        condition_variable m_run_started;
+        condition_variable m_run_done;
+
+        uint64_t m_run_id {0};
+        size_t m_no_of_working {0};
+        bool m_stop {false};
+
+        const range_task* m_task {nullptr};
+        const BlockSummary* m_summary {nullptr};
+        uint64_t m_grain_work {0};
+
+        std::atomic<uint64_t> m_blocks_left {0};
+        std::atomic<bool> m_failed {false};
+    };
+
+}
+
+#endif //XMREG01_RANGEEXECUTOR_H
@@ -0,0 +1,539 @@
+#include "RingMemberIndex.h"
+#include "MicroCore.h"
+#include "tools.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace xmreg
+{
+
+namespace
+{
+    const uint64_t INDEX_MAGIC   {0x786d656d676e6972ull};
+    const uint64_t INDEX_VERSION {3};
+
+    const char* const KEYS_FILE     {"keys"};
+    const char* const POSTINGS_FILE {"postings"};
+
+    // blocks added to the index at a time, as one segment. Each
+    // ring member of their inputs is kept in memory until written.
+    const uint64_t BUILD_STEP {20000};
+
+    /**
+     * Posting list of one key: height difference to the previous
+     * posting, tx index and input index, as varints each.
+     */
+    void
+    encode_postings(const vector<ring_member_use>& uses, string& out)
+    {
+        uint64_t prev_height {0};
+
+        for (const ring_member_use& use: uses)
+        {
+            write_varint(out, use.height - prev_height);
+            write_varint(out, use.tx_index);
+            write_varint(out, use.input_index);
+
+            prev_height = use.height;
+        }
+    }
+
+
+    bool
+    write_file(const string& file_path, const char* data, size_t size)
+    {
+        ofstream out(file_path, ios::binary | ios::trunc);
+
+        out.write(data, size);
+
+        if (!out.flush())
+        {
+            cerr << "Cant write " << file_path << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Collects outputs used in rings of inputs
+     * of visited txs, with absolute global indices.
+     */
+    class RingMemberVisitor : public ChainVisitor
+    {
+        // position of next non-coinbase tx in its block
+        uint64_t m_tx_index {0};
+
+    public:
+
+        vector<ring_member_ref> refs;
+
+        uint32_t
+        fields() const override { return VISIT_BLOCK | VISIT_TX_PREFIX; }
+
+        unique_ptr<ChainVisitor>
+        fork() const override
+        {
+            return unique_ptr<ChainVisitor> {new RingMemberVisitor()};
+        }
+
+        void
+        merge(ChainVisitor& range_visitor) override
+        {
+            RingMemberVisitor& other = static_cast<RingMemberVisitor&>(range_visitor);
+
+            refs.insert(refs.end(), other.refs.begin(), other.refs.end());
+        }
+
+        void
+        visit_block(const uint64_t& height, const block& blk) override
+        {
+            m_tx_index = 0;
+        }
+
+        void
+        visit_tx(const tx_visit& tx) override
+        {
+            if (tx.is_coinbase)
+            {
+                return;
+            }
+
+            const vector<txin_v>& vin = tx.prefix->vin;
+
+            for (size_t i = 0; i < vin.size(); ++i)
+            {
+                if (vin[i].type() != typeid(txin_to_key))
+                {
+                    continue;
+                }
+
+                const txin_to_key& in = boost::get<txin_to_key>(vin[i]);
+
+                // key offsets are relative to the previous one
+                uint64_t global_index {0};
+
+                for (const uint64_t& offset: in.key_offsets)
+                {
+                    global_index += offset;
+
+                    refs.push_back(ring_member_ref {
+                            in.amount, global_index,
+                            ring_member_use {tx.height, m_tx_index, i}});
+                }
+            }
+
+            ++m_tx_index;
+        }
+    };
+
+} // namespace
+
+
+
+    RingMemberIndex::RingMemberIndex()
+            : SegmentedIndex("ring member index", INDEX_MAGIC, INDEX_VERSION,
+                             2 * sizeof(uint64_t), sizeof(ring_key),
+                             {KEYS_FILE, POSTINGS_FILE})
+    {}
+
+
+    /**
+     * Find uses of the output by binary search in keys
+     * of each segment, in height order.
+     */
+    bool
+    RingMemberIndex::find(uint64_t amount, uint64_t global_index,
+                          vector<ring_member_use>& uses) const
+    {
+        for (const segment& seg: m_segments)
+        {
+            const ring_key* keys = seg.keys->as<ring_key>();
+
+            size_t no_of_keys = seg.keys->size() / sizeof(ring_key);
+
+            const ring_key* key = std::lower_bound(
+                    keys, keys + no_of_keys, make_pair(amount, global_index),
+                    [](const ring_key& k, const pair<uint64_t, uint64_t>& v)
+                    {
+                        return make_pair(k.amount, k.global_index) < v;
+                    });
+
+            if (key == keys + no_of_keys
+                || key->amount != amount
+                || key->global_index != global_index)
+            {
+                continue;
+            }
+
+            if (!decode_postings(seg, key - keys, uses))
+            {
+                cerr << "Corrupted postings in ring member index segment "
+                     << segment_path(POSTINGS_FILE, seg.h0, seg.h1) << endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    bool
+    RingMemberIndex::query_batch(MicroCore& mcore, istream& in, ostream& out) const
+    {
+        BlockchainDB& db = mcore.get_core().get_db();
+
+        out << "tx_hash,output_index,ring_tx_hash,input_index,height\n";
+
+        string line;
+
+        // reused for each output
+        transaction tx;
+        block blk;
+        vector<ring_member_use> uses;
+
+        while (getline(in, line))
+        {
+            istringstream iss {line};
+
+            string tx_hash_str;
+            size_t output_index;
+
+            if (!(iss >> tx_hash_str) || tx_hash_str[0] == '#')
+            {
+                continue;
+            }
+
+            crypto::hash tx_hash;
+
+            if (!(iss >> output_index) || !parse_str_secret_key(tx_hash_str, tx_hash))
+            {
+                cerr << "Cant parse output: " << line << endl;
+                return false;
+            }
+
+            if (!mcore.get_tx(tx_hash, tx))
+            {
+                return false;
+            }
+
+            vector<uint64_t> amount_indices;
+
+            try
+            {
+                amount_indices = db.get_tx_amount_output_indices(tx_hash);
+            }
+            catch (const exception& e)
+            {
+                cerr << e.what() << endl;
+                return false;
+            }
+
+            if (output_index >= tx.vout.size() || output_index >= amount_indices.size())
+            {
+                cerr << "No output " << output_index << " in tx " << tx_hash_str << endl;
+                return false;
+            }
+
+            uses.clear();
+
+            if (!find(tx.vout[output_index].amount, amount_indices[output_index], uses))
+            {
+                return false;
+            }
+
+            for (const ring_member_use& use: uses)
+            {
+                if (!mcore.get_block_by_height(use.height, blk)
+                    || use.tx_index >= blk.tx_hashes.size())
+                {
+                    cerr << "No tx " << use.tx_index
+                         << " in block: " << use.height << endl;
+                    return false;
+                }
+
+                out << tx_hash_str
+                    << "," << output_index
+                    << "," << epee::string_tools::pod_to_hex(blk.tx_hashes[use.tx_index])
+                    << "," << use.input_index
+                    << "," << use.height << "\n";
+            }
+        }
+
+        out.flush();
+
+        return static_cast<bool>(out);
+    }
+
+
+    /**
+     * Create index in index_path, or add to existing
+     * one, blocks up to, but not including, to_height.
+     */
+    bool
+    RingMemberIndex::build(MicroCore& mcore,
+                           const string& index_path,
+                           uint64_t to_height,
+                           bool show_progress)
+    {
+        RingMemberIndex index;
+
+        if (!index.open(index_path, mcore, true))
+        {
+            return false;
+        }
+
+        to_height = std::min(to_height, mcore.get_core().get_current_blockchain_height());
+
+        while (index.height() < to_height)
+        {
+            uint64_t h1 = std::min(index.height() + BUILD_STEP, to_height);
+
+            RingMemberVisitor visitor;
+
+            if (!mcore.visit_chain({&visitor}, index.height(), h1).complete
+                || !index.append(h1, visitor.refs))
+            {
+                return false;
+            }
+
+            if (show_progress)
+            {
+                cout << "\r - ring member index height: "
+                     << index.height() << "/" << to_height << flush;
+            }
+        }
+
+        if (show_progress)
+        {
+            cout << endl;
+        }
+
+        return true;
+    }
+
+
+    bool
+    RingMemberIndex::append(uint64_t to_height, vector<ring_member_ref>& refs)
+    {
+        if (to_height < height())
+        {
+            return false;
+        }
+
+        // stable, so postings of each key stay in height order
+        std::stable_sort(refs.begin(), refs.end(),
+                         [](const ring_member_ref& a, const ring_member_ref& b)
+                         {
+                             return make_pair(a.amount, a.global_index)
+                                    < make_pair(b.amount, b.global_index);
+                         });
+
+        if (!refs.empty()
+            && !write_segment(segment_path(KEYS_FILE, height(), to_height),
+                              segment_path(POSTINGS_FILE, height(), to_height),
+                              refs))
+        {
+            return false;
+        }
+
+        return add_segment(to_height, !refs.empty());
+    }
+
+
+    bool
+    RingMemberIndex::write_segment(const string& keys_path,
+                                   const string& postings_path,
+                                   const vector<ring_member_ref>& refs) const
+    {
+        vector<ring_key> keys;
+        string postings;
+
+        // reused for each key
+        vector<ring_member_use> uses;
+
+        for (size_t i = 0; i < refs.size(); )
+        {
+            ring_key key {refs[i].amount, refs[i].global_index, postings.size()};
+
+            uses.clear();
+
+            for (; i < refs.size()
+                   && refs[i].amount == key.amount
+                   && refs[i].global_index == key.global_index; ++i)
+            {
+                uses.push_back(refs[i].use);
+            }
+
+            encode_postings(uses, postings);
+
+            keys.push_back(key);
+        }
+
+        return write_file(keys_path,
+                          reinterpret_cast<const char*>(keys.data()),
+                          keys.size() * sizeof(ring_key))
+               && write_file(postings_path, postings.data(), postings.size());
+    }
+
+
+    /**
+     * Merge all segments into one. Postings of keys in more
+     * than one segment are joined in segment order, which is
+     * height order, and encoded again.
+     */
+    bool
+    RingMemberIndex::merge_segments(const uint64_t& h0, const uint64_t& h1) const
+    {
+        vector<size_t> positions(m_segments.size(), 0);
+
+        vector<ring_key> keys;
+        string postings;
+
+        vector<ring_member_use> uses;
+
+        while (true)
+        {
+            const ring_key* min_key {nullptr};
+
+            for (size_t i = 0; i < m_segments.size(); ++i)
+            {
+                if (positions[i] >= m_segments[i].keys->size() / sizeof(ring_key))
+                {
+                    continue;
+                }
+
+                const ring_key* key = m_segments[i].keys->as<ring_key>() + positions[i];
+
+                if (min_key == nullptr
+                    || make_pair(key->amount, key->global_index)
+                       < make_pair(min_key->amount, min_key->global_index))
+                {
+                    min_key = key;
+                }
+            }
+
+            if (min_key == nullptr)
+            {
+                break;
+            }
+
+            ring_key merged_key {min_key->amount, min_key->global_index, postings.size()};
+
+            uses.clear();
+
+            for (size_t i = 0; i < m_segments.size(); ++i)
+            {
+                if (positions[i] >= m_segments[i].keys->size() / sizeof(ring_key))
+                {
+                    continue;
+                }
+
+                const ring_key* key = m_segments[i].keys->as<ring_key>() + positions[i];
+
+                if (key->amount != merged_key.amount
+                    || key->global_index != merged_key.global_index)
+                {
+                    continue;
+                }
+
+                if (!decode_postings(m_segments[i], positions[i], uses))
+                {
+                    cerr << "Corrupted postings in ring member index segment "
+                         << segment_path(POSTINGS_FILE, m_segments[i].h0,
+                                         m_segments[i].h1) << endl;
+                    return false;
+                }
+
+                ++positions[i];
+            }
+
+            encode_postings(uses, postings);
+
+            keys.push_back(merged_key);
+        }
+
+        return write_file(segment_path(KEYS_FILE, h0, h1),
+                          reinterpret_cast<const char*>(keys.data()),
+                          keys.size() * sizeof(ring_key))
+               && write_file(segment_path(POSTINGS_FILE, h0, h1),
+                             postings.data(), postings.size());
+    }
+
+
+    bool
+    RingMemberIndex::map_segment(const uint64_t& h0, const uint64_t& h1)
+    {
+        m_segments.push_back(segment {h0, h1,
+                                      unique_ptr<MappedFile> {new MappedFile()},
+                                      unique_ptr<MappedFile> {new MappedFile()}});
+
+        const segment& seg = m_segments.back();
+
+        if (!seg.keys->open(segment_path(KEYS_FILE, h0, h1))
+            || !seg.postings->open(segment_path(POSTINGS_FILE, h0, h1)))
+        {
+            return false;
+        }
+
+        if (seg.keys->size() % sizeof(ring_key) != 0)
+        {
+            cerr << "Ring member index segment " << segment_path(KEYS_FILE, h0, h1)
+                 << " has partial key" << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    bool
+    RingMemberIndex::decode_postings(const segment& seg, size_t key_i,
+                                     vector<ring_member_use>& uses)
+    {
+        const ring_key* keys = seg.keys->as<ring_key>();
+
+        size_t no_of_keys = seg.keys->size() / sizeof(ring_key);
+
+        const uint8_t* postings = reinterpret_cast<const uint8_t*>(seg.postings->data());
+
+        uint64_t end_offset = key_i + 1 < no_of_keys
+                              ? keys[key_i + 1].postings_offset
+                              : seg.postings->size();
+
+        if (keys[key_i].postings_offset > end_offset || end_offset > seg.postings->size())
+        {
+            return false;
+        }
+
+        const uint8_t* pos = postings + keys[key_i].postings_offset;
+        const uint8_t* end = postings + end_offset;
+
+        uint64_t height {0};
+
+        while (pos < end)
+        {
+            uint64_t height_diff;
+
+            ring_member_use use;
+
+            if (!read_varint(pos, end, height_diff)
+                || !read_varint(pos, end, use.tx_index)
+                || !read_varint(pos, end, use.input_index))
+            {
+                return false;
+            }
+
+            height    += height_diff;
+            use.height = height;
+
+            uses.push_back(use);
+        }
+
+        return true;
+    }
+
+}
@@ -0,0 +1,130 @@
+#ifndef XMREG01_RINGMEMBERINDEX_H
+#define XMREG01_RINGMEMBERINDEX_H
+
+#include "monero_headers.h"
+#include "MappedFile.h"
+#include "SegmentedIndex.h"
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    class MicroCore;
+
+    /**
+     * Input of a tx whose ring has an output. The tx is
+     * given by its block and position in blk.tx_hashes,
+     * as coinbase txs have no rings.
+     */
+    struct ring_member_use
+    {
+        uint64_t height;
+        uint64_t tx_index;
+        uint64_t input_index;
+    };
+
+
+    // output in a ring, with its use
+    struct ring_member_ref
+    {
+        uint64_t amount;
+        uint64_t global_index;
+
+        ring_member_use use;
+    };
+
+
+    /**
+     * Index of inputs by outputs in their rings, i.e., from
+     * (amount, global output index) to all inputs using that
+     * output, real or as a decoy, found in blocks [0, height()).
+     *
+     * Each segment is made of two files: sorted keys with
+     * offsets of their posting lists, and the lists themselves.
+     * Postings of a key are in height order, written as varints,
+     * with heights as differences to the previous posting.
+     */
+    class RingMemberIndex : public SegmentedIndex
+    {
+    public:
+
+        RingMemberIndex();
+
+        bool
+        find(uint64_t amount, uint64_t global_index,
+             vector<ring_member_use>& uses) const;
+
+        /**
+         * Find inputs using our outputs, given one per line
+         * as tx hash and output index, and write them as csv of:
+         *
+         *   tx_hash,output_index,ring_tx_hash,input_index,height
+         *
+         * in the input order. Input spending the output is listed
+         * too, as it can't be told from decoys here.
+         */
+        bool
+        query_batch(MicroCore& mcore, istream& in, ostream& out) const;
+
+        static bool
+        build(MicroCore& mcore,
+              const string& index_path,
+              uint64_t to_height,
+              bool show_progress = false);
+
+    private:
+
+        struct ring_key
+        {
+            uint64_t amount;
+            uint64_t global_index;
+
+            // of its postings in postings file
+            uint64_t postings_offset;
+        };
+
+        struct segment
+        {
+            uint64_t h0;
+            uint64_t h1;
+
+            unique_ptr<MappedFile> keys;
+            unique_ptr<MappedFile> postings;
+        };
+
+        // refs of blocks [height(), to_height), in height order
+        bool
+        append(uint64_t to_height, vector<ring_member_ref>& refs);
+
+        bool
+        write_segment(const string& keys_path,
+                      const string& postings_path,
+                      const vector<ring_member_ref>& refs) const;
+
+        bool
+        map_segment(const uint64_t& h0, const uint64_t& h1) override;
+
+        void
+        unmap_segments() override { m_segments.clear(); }
+
+        bool
+        merge_segments(const uint64_t& h0, const uint64_t& h1) const override;
+
+        // postings of keys[key_i] in the segment
+        static bool
+        decode_postings(const segment& seg, size_t key_i,
+                        vector<ring_member_use>& uses);
+
+        vector<segment> m_segments;
+    };
+
+}
+
+#endif //XMREG01_RINGMEMBERINDEX_H
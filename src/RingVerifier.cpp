@@ -0,0 +1,278 @@
+#include "RingVerifier.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace xmreg
+{
+
+namespace
+{
+    // average number of blocks verified by a thread at a
+    // time, so ring members of each are resolved together
+    const uint64_t VERIFY_CHUNK {200};
+}
+
+
+    RingVerifier::RingVerifier(MicroCore& mcore, bool show_progress)
+            : m_mcore {mcore},
+              m_show_progress {show_progress}
+    {}
+
+
+    bool
+    RingVerifier::verify(uint64_t h0, uint64_t h1, vector<verify_failure>& failures)
+    {
+        auto start_time = chrono::steady_clock::now();
+
+        h1 = std::min(h1, m_mcore.get_core().get_current_blockchain_height());
+
+        RangeExecutor& executor = m_mcore.get_executor();
+
+        const BlockSummary& block_summary = m_mcore.get_block_summary();
+
+        vector<scratch> scratches(executor.no_of_threads());
+
+        ScanProgress progress {block_summary, h0, h1, "verified blocks", m_show_progress};
+
+        bool verified_ok = executor.run(
+                block_summary, h0, h1, VERIFY_CHUNK,
+                [&](size_t worker_i, uint64_t range_h0, uint64_t range_h1) -> bool
+                {
+                    if (!verify_range(range_h0, range_h1, scratches[worker_i]))
+                    {
+                        return false;
+                    }
+
+                    progress.done(range_h0, range_h1);
+
+                    return true;
+                });
+
+        progress.finish();
+
+        m_stats = verify_stats {};
+
+        size_t first_failure = failures.size();
+
+        for (scratch& s: scratches)
+        {
+            m_stats.no_of_blocks       += s.stats.no_of_blocks;
+            m_stats.no_of_txs          += s.stats.no_of_txs;
+            m_stats.no_of_inputs       += s.stats.no_of_inputs;
+            m_stats.no_of_ring_members += s.stats.no_of_ring_members;
+
+            failures.insert(failures.end(), s.failures.begin(), s.failures.end());
+        }
+
+        // ranges are in order within each thread, and
+        // failures of a block are all from one of them
+        std::stable_sort(failures.begin() + first_failure, failures.end(),
+                         [](const verify_failure& a, const verify_failure& b)
+                         {
+                             return a.height < b.height;
+                         });
+
+        m_stats.seconds = chrono::duration<double>(
+                chrono::steady_clock::now() - start_time).count();
+
+        return verified_ok;
+    }
+
+
+    void
+    RingVerifier::print_failures(const vector<verify_failure>& failures, ostream& out)
+    {
+        out << "height,tx_hash,input_index,reason\n";
+
+        for (const verify_failure& failure: failures)
+        {
+            out << failure.height
+                << "," << epee::string_tools::pod_to_hex(failure.tx_hash)
+                << "," << failure.input_index
+                << "," << failure.reason << "\n";
+        }
+
+        out.flush();
+    }
+
+
+    /**
+     * Read and parse txs of blocks [h0, h1), resolve keys
+     * of all their ring members at once, and check signatures.
+     */
+    bool
+    RingVerifier::verify_range(uint64_t h0, uint64_t h1, scratch& s)
+    {
+        ChainReader::ReadTxn txn;
+
+        if (!m_mcore.get_reader().begin_read(txn))
+        {
+            return false;
+        }
+
+        s.tx_hashes.clear();
+        s.prefix_hashes.clear();
+        s.heights.clear();
+        s.inputs.clear();
+        s.amount_indices.clear();
+
+        size_t no_of_txs {0};
+
+        for (uint64_t height = h0; height < h1; ++height)
+        {
+            blob_view blk_blob;
+
+            if (!txn.get_block_blob(height, blk_blob)
+                || !parse_block_from_view(blk_blob, s.blk))
+            {
+                cerr << "Cant get block of height: " << height << endl;
+                return false;
+            }
+
+            // coinbase tx has no rings
+            for (const crypto::hash& tx_hash: s.blk.tx_hashes)
+            {
+                if (s.txs.size() <= no_of_txs)
+                {
+                    s.txs.emplace_back();
+                }
+
+                transaction& tx = s.txs[no_of_txs];
+
+                blob_view tx_blob;
+
+                if (!txn.get_tx_blob(tx_hash, tx_blob)
+                    || !parse_tx_from_view(tx_blob, tx))
+                {
+                    cerr << "Cant get tx " << tx_hash
+                         << " in block: " << height << endl;
+                    return false;
+                }
+
+                s.tx_hashes.push_back(tx_hash);
+                s.prefix_hashes.push_back(get_transaction_prefix_hash(tx));
+                s.heights.push_back(height);
+
+                for (size_t i = 0; i < tx.vin.size(); ++i)
+                {
+                    if (tx.vin[i].type() != typeid(txin_to_key))
+                    {
+                        continue;
+                    }
+
+                    const txin_to_key& in = boost::get<txin_to_key>(tx.vin[i]);
+
+                    s.inputs.push_back(ring_input {no_of_txs, i,
+                                                   s.amount_indices.size(),
+                                                   in.key_offsets.size(),
+                                                   true});
+
+                    // key offsets are relative to the previous one
+                    uint64_t global_index {0};
+
+                    for (const uint64_t& offset: in.key_offsets)
+                    {
+                        global_index += offset;
+
+                        s.amount_indices.push_back(make_pair(in.amount, global_index));
+                    }
+                }
+
+                ++no_of_txs;
+            }
+
+            ++s.stats.no_of_blocks;
+        }
+
+        if (!m_mcore.get_output_infos(s.amount_indices, s.outputs))
+        {
+            resolve_each_input(s);
+        }
+
+        for (const ring_input& input: s.inputs)
+        {
+            const transaction& tx = s.txs[input.tx_i];
+
+            const txin_to_key& in = boost::get<txin_to_key>(tx.vin[input.input_index]);
+
+            ++s.stats.no_of_inputs;
+            s.stats.no_of_ring_members += input.ring_size;
+
+            const char* reason {nullptr};
+
+            if (!input.resolved)
+            {
+                reason = "ring members not found";
+            }
+            else if (input.ring_size == 0)
+            {
+                reason = "empty ring";
+            }
+            else if (tx.signatures.size() != tx.vin.size()
+                     || tx.signatures[input.input_index].size() != input.ring_size)
+            {
+                reason = "wrong number of signatures";
+            }
+            else
+            {
+                s.ring_keys.clear();
+
+                for (size_t j = 0; j < input.ring_size; ++j)
+                {
+                    s.ring_keys.push_back(&s.outputs[input.members_begin + j].pubkey);
+                }
+
+                if (!crypto::check_ring_signature(s.prefix_hashes[input.tx_i],
+                                                  in.k_image,
+                                                  s.ring_keys,
+                                                  tx.signatures[input.input_index].data()))
+                {
+                    reason = "invalid signature";
+                }
+            }
+
+            if (reason != nullptr)
+            {
+                s.failures.push_back(verify_failure {s.heights[input.tx_i],
+                                                     s.tx_hashes[input.tx_i],
+                                                     input.input_index,
+                                                     reason});
+            }
+        }
+
+        s.stats.no_of_txs += no_of_txs;
+
+        return true;
+    }
+
+
+    /**
+     * Resolve ring members input by input, so that only
+     * inputs with missing members fail verification.
+     */
+    void
+    RingVerifier::resolve_each_input(scratch& s)
+    {
+        s.outputs.resize(s.amount_indices.size());
+
+        vector<pair<uint64_t, uint64_t>> ring_indices;
+        vector<output_info> ring_outputs;
+
+        for (ring_input& input: s.inputs)
+        {
+            ring_indices.assign(s.amount_indices.begin() + input.members_begin,
+                                s.amount_indices.begin() + input.members_begin
+                                + input.ring_size);
+
+            input.resolved = m_mcore.get_output_infos(ring_indices, ring_outputs);
+
+            if (input.resolved)
+            {
+                std::copy(ring_outputs.begin(), ring_outputs.end(),
+                          s.outputs.begin() + input.members_begin);
+            }
+        }
+    }
+
+}
@@ -0,0 +1,111 @@
+#ifndef XMREG01_RINGVERIFIER_H
+#define XMREG01_RINGVERIFIER_H
+
+#include "MicroCore.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    struct verify_failure
+    {
+        uint64_t height;
+        crypto::hash tx_hash;
+        uint64_t input_index;
+        string reason;
+    };
+
+
+    struct verify_stats
+    {
+        uint64_t no_of_blocks {0};
+        uint64_t no_of_txs {0};
+        uint64_t no_of_inputs {0};
+        uint64_t no_of_ring_members {0};
+        double seconds {0};
+    };
+
+
+    /**
+     * Checks ring signatures of all key inputs in a height range,
+     * e.g., to audit a copy of the blockchain.
+     *
+     * Ranges of blocks are verified by threads of mcore's executor.
+     * For each range, keys of all ring members are resolved with one
+     * get_output_infos call, and buffers are reused between ranges
+     * of a thread. Only signatures are checked, not other rules
+     * of tx validity, such as unlock times of ring members.
+     */
+    class RingVerifier
+    {
+    public:
+
+        RingVerifier(MicroCore& mcore, bool show_progress = false);
+
+        // failures are in blockchain order
+        bool
+        verify(uint64_t h0, uint64_t h1, vector<verify_failure>& failures);
+
+        const verify_stats&
+        stats() const { return m_stats; }
+
+        static void
+        print_failures(const vector<verify_failure>& failures, ostream& out);
+
+    private:
+
+        struct ring_input
+        {
+            size_t tx_i;
+            uint64_t input_index;
+
+            // of its ring members in amount_indices
+            size_t members_begin;
+            size_t ring_size;
+
+            bool resolved;
+        };
+
+        // buffers of a thread, kept between its ranges
+        struct scratch
+        {
+            block blk;
+
+            vector<transaction> txs;
+            vector<crypto::hash> tx_hashes;
+            vector<crypto::hash> prefix_hashes;
+            vector<uint64_t> heights;
+
+            vector<ring_input> inputs;
+            vector<pair<uint64_t, uint64_t>> amount_indices;
+            vector<output_info> outputs;
+            vector<const public_key*> ring_keys;
+
+            vector<verify_failure> failures;
+
+            verify_stats stats;
+        };
+
+        bool
+        verify_range(uint64_t h0, uint64_t h1, scratch& s);
+
+        // when not all ring members of a range are found
+        void
+        resolve_each_input(scratch& s);
+
+        MicroCore& m_mcore;
+
+        bool m_show_progress;
+
+        verify_stats m_stats;
+    };
+
+}
+
+#endif //XMREG01_RINGVERIFIER_H
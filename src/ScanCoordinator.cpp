@@ -0,0 +1,515 @@
+#include "ScanCoordinator.h"
+#include "ChainVisitors.h"
+
+#include <boost/filesystem.hpp>
+
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+extern char** environ;
+
+namespace xmreg
+{
+
+namespace
+{
+    namespace bf = boost::filesystem;
+
+    // how many times a unit is tried before giving up
+    const size_t MAX_ATTEMPTS {3};
+
+    // hex digits of wallets hash used in unit file names
+    const size_t WALLETS_ID_SIZE {16};
+
+
+    // wallet index of a unit file line
+    size_t
+    line_wallet(const string& line)
+    {
+        return std::stoull(line.substr(0, line.find(',')));
+    }
+
+
+    /**
+     * Hash of view and spend keys of wallets, in their order,
+     * as unit files refer to wallets by their index.
+     */
+    crypto::hash
+    wallets_hash(const vector<scan_wallet>& wallets)
+    {
+        string keys;
+
+        for (const scan_wallet& wallet: wallets)
+        {
+            keys.append(reinterpret_cast<const char*>(&wallet.private_view_key),
+                        sizeof(secret_key));
+            keys.append(reinterpret_cast<const char*>(&wallet.public_spend_key),
+                        sizeof(public_key));
+        }
+
+        return cn_fast_hash(keys.data(), keys.size());
+    }
+}
+
+
+    ScanCoordinator::ScanCoordinator(const string& executable,
+                                     const vector<string>& worker_args,
+                                     const string& work_dir,
+                                     size_t no_of_local_workers,
+                                     const vector<string>& worker_hosts,
+                                     const vector<scan_wallet>& wallets)
+            : m_executable {executable},
+              m_worker_args {worker_args},
+              m_work_dir {work_dir},
+              m_wallets_id {epee::string_tools::pod_to_hex(wallets_hash(wallets))
+                                    .substr(0, WALLETS_ID_SIZE)}
+    {
+        m_worker_slots.resize(no_of_local_workers);
+
+        m_worker_slots.insert(m_worker_slots.end(),
+                              worker_hosts.begin(), worker_hosts.end());
+    }
+
+
+    /**
+     * Scan blocks [h0, h1) in units of unit_blocks blocks.
+     *
+     * Units start at heights which are multiples of unit_blocks, not
+     * where h0 and h1 split the work, so when the chain grows, units of
+     * earlier runs keep their heights and files. Only the last unit,
+     * which was cut by the old h1, and ones after it are done again.
+     */
+    bool
+    ScanCoordinator::run(const BlockSummary& block_summary,
+                         uint64_t h0, uint64_t h1,
+                         uint64_t unit_blocks,
+                         ostream& out)
+    {
+        if (m_worker_slots.empty() || unit_blocks == 0)
+        {
+            cerr << "No workers or empty work units" << endl;
+            return false;
+        }
+
+        boost::system::error_code ec;
+
+        bf::create_directories(m_work_dir, ec);
+
+        if (ec)
+        {
+            cerr << "Cant create " << m_work_dir << ": " << ec.message() << endl;
+            return false;
+        }
+
+        vector<work_unit> units;
+
+        for (uint64_t unit_h0 = h0; unit_h0 < h1;)
+        {
+            uint64_t unit_h1 = std::min((unit_h0 / unit_blocks + 1) * unit_blocks, h1);
+
+            units.push_back(work_unit {unit_h0, unit_h1, 0});
+
+            unit_h0 = unit_h1;
+        }
+
+        ScanProgress progress {block_summary, h0, h1, "scanned blocks", false};
+
+        // units done by previous runs are not done again
+        deque<size_t> pending;
+
+        for (size_t i = 0; i < units.size(); ++i)
+        {
+            if (!bf::exists(unit_path(units[i])))
+            {
+                pending.push_back(i);
+            }
+            else
+            {
+                progress.skip(units[i].h0, units[i].h1);
+            }
+        }
+
+        vector<size_t> free_slots;
+
+        for (size_t slot = m_worker_slots.size(); slot > 0; --slot)
+        {
+            free_slots.push_back(slot - 1);
+        }
+
+        // pid -> (unit, slot)
+        map<pid_t, pair<size_t, size_t>> running;
+
+        size_t no_of_done = units.size() - pending.size();
+
+        bool failed {false};
+
+        while (!failed && (!pending.empty() || !running.empty()))
+        {
+            while (!failed && !pending.empty() && !free_slots.empty())
+            {
+                size_t unit_i = pending.front();
+                size_t slot   = free_slots.back();
+
+                pending.pop_front();
+
+                pid_t pid = start_worker(units[unit_i], m_worker_slots[slot]);
+
+                if (pid > 0)
+                {
+                    free_slots.pop_back();
+                    running[pid] = make_pair(unit_i, slot);
+                    continue;
+                }
+
+                if (++units[unit_i].attempts >= MAX_ATTEMPTS)
+                {
+                    failed = true;
+                }
+
+                pending.push_back(unit_i);
+            }
+
+            if (running.empty())
+            {
+                continue;
+            }
+
+            int status;
+
+            pid_t pid = waitpid(-1, &status, 0);
+
+            if (pid < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                cerr << "Cant wait for workers: " << strerror(errno) << endl;
+                return false;
+            }
+
+            auto it = running.find(pid);
+
+            if (it == running.end())
+            {
+                continue;
+            }
+
+            size_t unit_i = it->second.first;
+
+            work_unit& unit = units[unit_i];
+
+            free_slots.push_back(it->second.second);
+            running.erase(it);
+
+            if (WIFEXITED(status) && WEXITSTATUS(status) == 0
+                && bf::exists(unit_path(unit)))
+            {
+                progress.done(unit.h0, unit.h1);
+
+                cerr << "Unit " << unit.h0 << "-" << unit.h1 << " done ("
+                     << ++no_of_done << "/" << units.size() << ", "
+                     << static_cast<int>(progress.fraction_done() * 100) << "% of work, eta "
+                     << static_cast<uint64_t>(progress.eta()) << " s)" << endl;
+                continue;
+            }
+
+            cerr << "Unit " << unit.h0 << "-" << unit.h1 << " failed" << endl;
+
+            // try again, probably with other worker
+            if (++unit.attempts >= MAX_ATTEMPTS)
+            {
+                failed = true;
+            }
+            else
+            {
+                pending.push_back(unit_i);
+            }
+        }
+
+        if (failed)
+        {
+            cerr << "Giving up after " << MAX_ATTEMPTS << " attempts of a unit" << endl;
+
+            for (auto& r: running)
+            {
+                kill(r.first, SIGTERM);
+                waitpid(r.first, nullptr, 0);
+            }
+
+            return false;
+        }
+
+        return merge(units, out);
+    }
+
+
+    bool
+    ScanCoordinator::run_unit(MicroCore& mcore,
+                              const vector<scan_wallet>& wallets,
+                              uint64_t h0, uint64_t h1,
+                              const string& unit_path)
+    {
+        vector<OwnedOutputsVisitor> owned;
+
+        owned.reserve(wallets.size());
+
+        for (const scan_wallet& wallet: wallets)
+        {
+            owned.emplace_back(wallet.private_view_key, wallet.public_spend_key);
+        }
+
+        vector<ChainVisitor*> visitors;
+
+        for (OwnedOutputsVisitor& visitor: owned)
+        {
+            visitors.push_back(&visitor);
+        }
+
+        // all wallets are checked in one pass
+        if (!mcore.visit_chain(visitors, h0, h1).complete)
+        {
+            return false;
+        }
+
+        string tmp_path = unit_path + ".tmp";
+
+        {
+            ofstream unit_file {tmp_path, ios::trunc};
+
+            for (size_t i = 0; i < owned.size(); ++i)
+            {
+                for (const owned_output& output: owned[i].outputs)
+                {
+                    unit_file << i
+                              << "," << output.height
+                              << "," << epee::string_tools::pod_to_hex(output.tx_hash)
+                              << "," << output.index_in_tx
+                              << "," << output.amount << "\n";
+                }
+            }
+
+            if (!unit_file.flush())
+            {
+                cerr << "Cant write " << tmp_path << endl;
+                return false;
+            }
+        }
+
+        boost::system::error_code ec;
+
+        bf::rename(tmp_path, unit_path, ec);
+
+        if (ec)
+        {
+            cerr << "Cant rename " << tmp_path << ": " << ec.message() << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Read lines of: address private_view_key
+     */
+    bool
+    ScanCoordinator::read_wallets(const string& wallets_path,
+                                  bool testnet,
+                                  vector<scan_wallet>& wallets)
+    {
+        ifstream in {wallets_path};
+
+        if (!in)
+        {
+            cerr << "Cant open wallets file: " << wallets_path << endl;
+            return false;
+        }
+
+        string line;
+
+        while (getline(in, line))
+        {
+            istringstream iss {line};
+
+            string address_str, viewkey_str;
+
+            if (!(iss >> address_str) || address_str[0] == '#')
+            {
+                continue;
+            }
+
+            iss >> viewkey_str;
+
+            account_public_address address;
+
+            scan_wallet wallet;
+
+            if (!parse_str_address(address_str, address, testnet)
+                || !parse_str_secret_key(viewkey_str, wallet.private_view_key))
+            {
+                cerr << "Invalid wallet line: " << line << endl;
+                return false;
+            }
+
+            wallet.address_str      = address_str;
+            wallet.public_spend_key = address.m_spend_public_key;
+
+            wallets.push_back(wallet);
+        }
+
+        return true;
+    }
+
+
+    bool
+    ScanCoordinator::parse_unit(const string& unit_str, uint64_t& h0, uint64_t& h1)
+    {
+        size_t colon = unit_str.find(':');
+
+        if (colon == string::npos)
+        {
+            return false;
+        }
+
+        try
+        {
+            h0 = std::stoull(unit_str.substr(0, colon));
+            h1 = std::stoull(unit_str.substr(colon + 1));
+        }
+        catch (const std::exception& e)
+        {
+            return false;
+        }
+
+        return h0 < h1;
+    }
+
+
+    string
+    ScanCoordinator::unit_path(const work_unit& unit) const
+    {
+        return (bf::path(m_work_dir) / ("unit_" + m_wallets_id
+                                        + "_" + std::to_string(unit.h0)
+                                        + "_" + std::to_string(unit.h1) + ".csv")).string();
+    }
+
+
+    /**
+     * Start worker process of a unit, locally if host is
+     * empty, or over ssh. Returns its pid, or -1.
+     */
+    pid_t
+    ScanCoordinator::start_worker(const work_unit& unit, const string& host)
+    {
+        vector<string> args;
+
+        if (!host.empty())
+        {
+            args.push_back("ssh");
+            args.push_back(host);
+        }
+
+        args.push_back(m_executable);
+        args.insert(args.end(), m_worker_args.begin(), m_worker_args.end());
+
+        args.push_back("--worker-unit");
+        args.push_back(std::to_string(unit.h0) + ":" + std::to_string(unit.h1));
+        args.push_back("--unit-output");
+        args.push_back(unit_path(unit));
+
+        vector<char*> argv;
+
+        for (string& arg: args)
+        {
+            argv.push_back(&arg[0]);
+        }
+
+        argv.push_back(nullptr);
+
+        // workers print what they do, but only
+        // the merged result should go to stdout
+        posix_spawn_file_actions_t file_actions;
+
+        posix_spawn_file_actions_init(&file_actions);
+        posix_spawn_file_actions_addopen(&file_actions, STDOUT_FILENO,
+                                         "/dev/null", O_WRONLY, 0);
+
+        pid_t pid;
+
+        int rc = posix_spawnp(&pid, argv[0], &file_actions, nullptr,
+                              argv.data(), environ);
+
+        posix_spawn_file_actions_destroy(&file_actions);
+
+        if (rc != 0)
+        {
+            cerr << "Cant start worker " << argv[0] << ": " << strerror(rc) << endl;
+            return -1;
+        }
+
+        return pid;
+    }
+
+
+    /**
+     * Join unit files, grouped by wallet, and
+     * in height order for each wallet.
+     */
+    bool
+    ScanCoordinator::merge(const vector<work_unit>& units, ostream& out) const
+    {
+        vector<string> lines;
+
+        for (const work_unit& unit: units)
+        {
+            ifstream unit_file {unit_path(unit)};
+
+            if (!unit_file)
+            {
+                cerr << "Cant open " << unit_path(unit) << endl;
+                return false;
+            }
+
+            string line;
+
+            while (getline(unit_file, line))
+            {
+                if (!line.empty())
+                {
+                    lines.push_back(line);
+                }
+            }
+        }
+
+        // units are in height order already
+        std::stable_sort(lines.begin(), lines.end(),
+                         [](const string& a, const string& b)
+                         {
+                             return line_wallet(a) < line_wallet(b);
+                         });
+
+        out << "wallet,height,tx_hash,output_index,amount\n";
+
+        for (const string& line: lines)
+        {
+            out << line << "\n";
+        }
+
+        out.flush();
+
+        return static_cast<bool>(out);
+    }
+
+}
@@ -0,0 +1,121 @@
+#ifndef XMREG01_SCANCOORDINATOR_H
+#define XMREG01_SCANCOORDINATOR_H
+
+#include "MicroCore.h"
+
+#include <sys/types.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    /**
+     * Wallet whose outputs are looked for. Only keys
+     * needed to find outputs are kept.
+     */
+    struct scan_wallet
+    {
+        string address_str;
+        secret_key private_view_key;
+        public_key public_spend_key;
+    };
+
+
+    /**
+     * Scan for outputs of many wallets split into work units
+     * of block ranges, each done by a separate worker process.
+     *
+     * Workers are this program run with --worker-unit, locally or
+     * over ssh on hosts having the same blockchain snapshot and
+     * the work folder, e.g., over nfs. Each writes its results
+     * to a file of the unit in the work folder, first to a temporary
+     * file which is renamed when complete. So existing unit files are
+     * complete, and are not done again when coordinator is rerun.
+     * Names of unit files have a hash of keys of all wallets, so when
+     * the wallets change, units of the old ones are not used.
+     *
+     * Units whose worker fails are given to the next free worker,
+     * up to MAX_ATTEMPTS times. Unit files are merged in height
+     * order, so the result does not depend on which worker did what.
+     */
+    class ScanCoordinator
+    {
+    public:
+
+        struct work_unit
+        {
+            uint64_t h0;
+            uint64_t h1;
+            size_t attempts;
+        };
+
+        /**
+         * worker_args are arguments passed to each worker,
+         * e.g., blockchain path, and worker_hosts are ssh hosts
+         * to run workers on, in addition to no_of_local_workers.
+         */
+        ScanCoordinator(const string& executable,
+                        const vector<string>& worker_args,
+                        const string& work_dir,
+                        size_t no_of_local_workers,
+                        const vector<string>& worker_hosts,
+                        const vector<scan_wallet>& wallets);
+
+        bool
+        run(const BlockSummary& block_summary,
+            uint64_t h0, uint64_t h1,
+            uint64_t unit_blocks,
+            ostream& out);
+
+        /**
+         * Worker side: find outputs of wallets in
+         * blocks [h0, h1) and write them to unit_path.
+         */
+        static bool
+        run_unit(MicroCore& mcore,
+                 const vector<scan_wallet>& wallets,
+                 uint64_t h0, uint64_t h1,
+                 const string& unit_path);
+
+        static bool
+        read_wallets(const string& wallets_path,
+                     bool testnet,
+                     vector<scan_wallet>& wallets);
+
+        static bool
+        parse_unit(const string& unit_str, uint64_t& h0, uint64_t& h1);
+
+    private:
+
+        string
+        unit_path(const work_unit& unit) const;
+
+        pid_t
+        start_worker(const work_unit& unit, const string& host);
+
+        bool
+        merge(const vector<work_unit>& units, ostream& out) const;
+
+        string m_executable;
+
+        vector<string> m_worker_args;
+
+        string m_work_dir;
+
+        // hex of hash of keys of wallets, in unit file names
+        string m_wallets_id;
+
+        // one entry for each worker that can run at the same
+        // time. empty string for local ones, host otherwise.
+        vector<string> m_worker_slots;
+    };
+
+}
+
+#endif //XMREG01_SCANCOORDINATOR_H
@@ -0,0 +1,63 @@
+#ifndef XMREG01_SCANDEADLINE_H
+#define XMREG01_SCANDEADLINE_H
+
+#include <atomic>
+#include <chrono>
+
+namespace xmreg
+{
+    using namespace std;
+
+    /**
+     * Time budget of a blockchain scan, which can also be
+     * cancelled from another thread.
+     *
+     * Scans taking it check expired() as they go, and when it is
+     * true, return what they found so far, together with the
+     * range of heights they covered.
+     */
+    class ScanDeadline
+    {
+        using clock = std::chrono::steady_clock;
+
+        clock::time_point m_deadline;
+
+        bool m_has_deadline {false};
+
+        std::atomic<bool> m_cancelled {false};
+
+    public:
+
+        // no time limit, only cancel()
+        ScanDeadline() = default;
+
+        explicit ScanDeadline(std::chrono::milliseconds budget)
+                : m_deadline {clock::now() + budget},
+                  m_has_deadline {true}
+        {}
+
+        ScanDeadline(const ScanDeadline&) = delete;
+        ScanDeadline& operator=(const ScanDeadline&) = delete;
+
+        void
+        cancel() { m_cancelled = true; }
+
+        bool
+        expired() const
+        {
+            return m_cancelled
+                   || (m_has_deadline && clock::now() >= m_deadline);
+        }
+
+        // default of scans which can take a deadline
+        static const ScanDeadline&
+        none()
+        {
+            static const ScanDeadline no_deadline;
+            return no_deadline;
+        }
+    };
+
+}
+
+#endif //XMREG01_SCANDEADLINE_H
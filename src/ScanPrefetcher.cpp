@@ -0,0 +1,286 @@
+#include "ScanPrefetcher.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <sstream>
+
+namespace xmreg
+{
+
+    ScanPrefetcher::ScanPrefetcher(const ChainReader& reader,
+                                   size_t window,
+                                   scan_order order,
+                                   uint64_t start_height,
+                                   uint64_t end_height)
+            : m_reader {reader},
+              m_window {window},
+              m_order {order},
+              m_start_height {start_height},
+              m_end_height {end_height},
+              m_page_size {static_cast<size_t>(sysconf(_SC_PAGESIZE))}
+    {}
+
+
+    void
+    ScanPrefetcher::start()
+    {
+        if (m_window == 0 || m_thread.joinable())
+        {
+            return;
+        }
+
+        m_stop = false;
+
+        m_thread = thread(&ScanPrefetcher::run, this);
+    }
+
+
+    /**
+     * Called by the scan after it processed no_of_items
+     * txs (or blocks, for scan_order::height).
+     */
+    void
+    ScanPrefetcher::advance(uint64_t no_of_items)
+    {
+        uint64_t consumed = (m_consumed += no_of_items);
+
+        // dont take the lock for every tx. wake the prefetcher
+        // only when it waits and the scan is half window behind it.
+        if (m_waiting && consumed + m_window / 2 >= m_prefetched)
+        {
+            lock_guard<mutex> lck {m_mtx};
+            m_cv.notify_one();
+        }
+    }
+
+
+    void
+    ScanPrefetcher::stop()
+    {
+        m_stop = true;
+
+        {
+            lock_guard<mutex> lck {m_mtx};
+            m_cv.notify_one();
+        }
+
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+
+    ScanPrefetcher::prefetch_stats
+    ScanPrefetcher::get_stats() const
+    {
+        return m_stats;
+    }
+
+
+    string
+    ScanPrefetcher::report() const
+    {
+        stringstream ss;
+
+        double mb_requested = static_cast<double>(m_stats.pages_requested)
+                              * m_page_size / (1024.0 * 1024.0);
+
+        ss << "prefetched " << m_stats.items_prefetched << " items, "
+           << m_stats.pages_requested << " pages ("
+           << mb_requested << " MB), "
+           << m_stats.pages_not_resident << " of them not in page cache; "
+           << "prefetcher busy: " << m_stats.busy_seconds << " s; "
+           << "scan overtook prefetcher " << m_stats.times_overtaken << " times";
+
+        return ss.str();
+    }
+
+
+    ScanPrefetcher::~ScanPrefetcher()
+    {
+        stop();
+    }
+
+
+    /**
+     * Block while we are window items ahead of the scan.
+     *
+     * Returns false if we should stop.
+     */
+    bool
+    ScanPrefetcher::wait_for_consumer()
+    {
+        if (m_stop)
+        {
+            return false;
+        }
+
+        uint64_t prefetched = m_prefetched;
+        uint64_t consumed   = m_consumed;
+
+        if (prefetched < consumed)
+        {
+            // the scan is ahead of us, so what we read next
+            // was already read by it.
+            ++m_stats.times_overtaken;
+            m_prefetched = consumed;
+            return true;
+        }
+
+        if (prefetched < consumed + m_window)
+        {
+            return true;
+        }
+
+        unique_lock<mutex> lck {m_mtx};
+
+        m_waiting = true;
+
+        m_cv.wait(lck, [&]
+        {
+            return m_stop || m_consumed + m_window / 2 >= m_prefetched;
+        });
+
+        m_waiting = false;
+
+        return !m_stop;
+    }
+
+
+    /**
+     * Ask kernel to read pages of the blob, and count
+     * how many of them were not in page cache.
+     */
+    void
+    ScanPrefetcher::prefetch(const blob_view& blob)
+    {
+        if (blob.size == 0)
+        {
+            return;
+        }
+
+        uintptr_t first = reinterpret_cast<uintptr_t>(blob.data)
+                          & ~(static_cast<uintptr_t>(m_page_size) - 1);
+
+        uintptr_t last  = reinterpret_cast<uintptr_t>(blob.data) + blob.size;
+
+        size_t length   = last - first;
+        size_t no_pages = (length + m_page_size - 1) / m_page_size;
+
+        void* addr = reinterpret_cast<void*>(first);
+
+        m_residency.resize(no_pages);
+
+        if (mincore(addr, length, m_residency.data()) == 0)
+        {
+            for (unsigned char page: m_residency)
+            {
+                if (!(page & 1))
+                {
+                    ++m_stats.pages_not_resident;
+                }
+            }
+        }
+
+        madvise(addr, length, MADV_WILLNEED);
+
+        m_stats.pages_requested += no_pages;
+    }
+
+
+    void
+    ScanPrefetcher::run()
+    {
+        ChainReader::ReadTxn txn;
+
+        if (!m_reader.begin_read(txn))
+        {
+            return;
+        }
+
+        m_prefetched = 0;
+
+        chrono::duration<double> busy_time {0};
+
+        // reused for every block in scan_order::height
+        block blk;
+
+        // txs read by the cursor in scan_order::tx_table
+        uint64_t cursor_pos {0};
+
+        while (wait_for_consumer())
+        {
+            auto item_start = chrono::steady_clock::now();
+
+            if (m_order == scan_order::tx_table)
+            {
+                crypto::hash tx_hash;
+                blob_view tx_blob;
+
+                // if the scan overtook us, move the cursor
+                // over the txs it already read
+                bool end_of_txs {false};
+
+                while (cursor_pos <= m_prefetched)
+                {
+                    if (!txn.get_next_tx_blob(tx_hash, tx_blob))
+                    {
+                        end_of_txs = true;
+                        break;
+                    }
+
+                    ++cursor_pos;
+                }
+
+                if (end_of_txs)
+                {
+                    break;
+                }
+
+                prefetch(tx_blob);
+            }
+            else
+            {
+                // if the scan overtook us, this skips
+                // the blocks it already read
+                uint64_t height = m_start_height + m_prefetched;
+
+                if (height >= m_end_height)
+                {
+                    break;
+                }
+
+                blob_view blk_blob;
+
+                if (!txn.get_block_blob(height, blk_blob)
+                    || !parse_block_from_view(blk_blob, blk))
+                {
+                    break;
+                }
+
+                prefetch(blk_blob);
+
+                for (const crypto::hash& tx_hash: blk.tx_hashes)
+                {
+                    blob_view tx_blob;
+
+                    if (txn.get_tx_blob(tx_hash, tx_blob))
+                    {
+                        prefetch(tx_blob);
+                    }
+                }
+            }
+
+            busy_time += chrono::steady_clock::now() - item_start;
+
+            ++m_prefetched;
+            ++m_stats.items_prefetched;
+        }
+
+        m_stats.busy_seconds = busy_time.count();
+    }
+
+}
@@ -0,0 +1,132 @@
+#ifndef XMREG01_SCANPREFETCHER_H
+#define XMREG01_SCANPREFETCHER_H
+
+#include "ChainReader.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+namespace xmreg
+{
+    using namespace std;
+
+    /**
+     * Reads ahead of a sequential chain scan, so that when the
+     * data.mdb file is not in the page cache the scanning thread
+     * does not stall on page faults.
+     *
+     * A background thread walks the same table in the same order
+     * as the scan, with its own read transaction, up to window
+     * items ahead of it. Walking the cursor faults in the tree pages,
+     * and blobs that do not fit in them (overflow pages) are
+     * requested with madvise(MADV_WILLNEED).
+     *
+     * For scan_order::height, blocks [start_height, end_height)
+     * are read, i.e., the range of the scan, and not beyond it.
+     *
+     * The scan reports its progress with advance().
+     * Stats are available after stop().
+     */
+    class ScanPrefetcher
+    {
+    public:
+
+        enum class scan_order
+        {
+            tx_table,   // txs table key order, as in for_all_transactions
+            height      // blocks and their txs, by height
+        };
+
+        struct prefetch_stats
+        {
+            // txs or blocks read ahead of the scan
+            uint64_t items_prefetched {0};
+
+            // pages requested and how many of them
+            // were not in page cache at that time
+            uint64_t pages_requested {0};
+            uint64_t pages_not_resident {0};
+
+            // how many times the scan caught up with the prefetcher
+            uint64_t times_overtaken {0};
+
+            // wall time prefetcher thread spent reading. it is not
+            // I/O wait saved by the scan, as reads of resident
+            // pages and waits of the scan overlap with it
+            double busy_seconds {0};
+        };
+
+        ScanPrefetcher(const ChainReader& reader,
+                       size_t window,
+                       scan_order order = scan_order::tx_table,
+                       uint64_t start_height = 0,
+                       uint64_t end_height = std::numeric_limits<uint64_t>::max());
+
+        ScanPrefetcher(const ScanPrefetcher&) = delete;
+        ScanPrefetcher& operator=(const ScanPrefetcher&) = delete;
+
+        void
+        start();
+
+        void
+        advance(uint64_t no_of_items = 1);
+
+        void
+        stop();
+
+        prefetch_stats
+        get_stats() const;
+
+        string
+        report() const;
+
+        ~ScanPrefetcher();
+
+    private:
+
+        void
+        run();
+
+        bool
+        wait_for_consumer();
+
+        void
+        prefetch(const blob_view& blob);
+
+        const ChainReader& m_reader;
+
+        size_t m_window;
+
+        scan_order m_order;
+
+        uint64_t m_start_height;
+
+        // scan_order::height stops before it
+        uint64_t m_end_height;
+
+        size_t m_page_size;
+
+        // reused mincore result buffer
+        vector<unsigned char> m_residency;
+
+        atomic<uint64_t> m_consumed {0};
+        atomic<uint64_t> m_prefetched {0};
+
+        atomic<bool> m_waiting {false};
+        atomic<bool> m_stop {false};
+
+        mutex m_mtx;
+        condition_variable m_cv;
+
+        thread m_thread;
+
+        // written only by the prefetcher thread
+        prefetch_stats m_stats;
+    };
+
+}
+
+#endif //XMREG01_SCANPREFETCHER_H
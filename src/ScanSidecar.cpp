@@ -0,0 +1,527 @@
+#include "ScanSidecar.h"
+#include "MicroCore.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <fstream>
+
+namespace xmreg
+{
+
+namespace
+{
+    namespace bf = boost::filesystem;
+
+    const uint64_t SIDECAR_MAGIC   {0x726164696373787dull};
+    const uint64_t SIDECAR_VERSION {2};
+
+    const char* const META_FILE {"meta"};
+
+    // how often, in blocks, meta is updated while building
+    const uint64_t COMMIT_INTERVAL {10000};
+
+    // column files and the size of their records
+    enum column_id
+    {
+        BLOCK_TXS, TX_HASHES, TX_PUB_KEYS, TX_OUTS, TX_INS,
+        OUT_KEYS, OUT_AMOUNTS, KEY_IMAGES, BLOCK_HASHES, NO_OF_COLUMNS
+    };
+
+    const char* const COLUMN_FILES[NO_OF_COLUMNS] {
+            "block_txs", "tx_hashes", "tx_pub_keys", "tx_outs", "tx_ins",
+            "out_keys", "out_amounts", "key_images", "block_hashes"};
+
+    const size_t RECORD_SIZES[NO_OF_COLUMNS] {
+            sizeof(uint64_t), sizeof(crypto::hash), sizeof(public_key),
+            sizeof(uint64_t), sizeof(uint64_t),
+            sizeof(public_key), sizeof(uint64_t), sizeof(key_image),
+            sizeof(crypto::hash)};
+
+
+    string
+    column_path(const string& sidecar_path, column_id col)
+    {
+        return (bf::path(sidecar_path) / COLUMN_FILES[col]).string();
+    }
+
+
+    uint64_t
+    no_of_records(const ScanSidecar::sidecar_meta& meta, column_id col)
+    {
+        switch (col)
+        {
+            case BLOCK_TXS:
+            case BLOCK_HASHES:
+                return meta.no_of_blocks;
+            case TX_HASHES:
+            case TX_PUB_KEYS:
+            case TX_OUTS:
+            case TX_INS:
+                return meta.no_of_txs;
+            case OUT_KEYS:
+            case OUT_AMOUNTS:
+                return meta.no_of_outputs;
+            case KEY_IMAGES:
+                return meta.no_of_inputs;
+            default:
+                return 0;
+        }
+    }
+
+
+    bool
+    write_meta(const string& sidecar_path, const ScanSidecar::sidecar_meta& meta)
+    {
+        bf::path meta_path = bf::path(sidecar_path) / META_FILE;
+        bf::path tmp_path  = meta_path;
+
+        tmp_path += ".tmp";
+
+        {
+            ofstream out(tmp_path.string(), ios::binary | ios::trunc);
+
+            out.write(reinterpret_cast<const char*>(&meta), sizeof(meta));
+
+            if (!out)
+            {
+                cerr << "Cant write " << tmp_path << endl;
+                return false;
+            }
+        }
+
+        // rename is atomic, so meta is either old or new one
+        boost::system::error_code ec;
+
+        bf::rename(tmp_path, meta_path, ec);
+
+        if (ec)
+        {
+            cerr << "Cant rename " << tmp_path << ": " << ec.message() << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    template <typename T>
+    void
+    write_record(ofstream& out, const T& record)
+    {
+        out.write(reinterpret_cast<const char*>(&record), sizeof(T));
+    }
+
+} // namespace
+
+
+
+    bool
+    ScanSidecar::read_meta(const string& sidecar_path, sidecar_meta& meta)
+    {
+        ifstream in((bf::path(sidecar_path) / META_FILE).string(), ios::binary);
+
+        if (!in)
+        {
+            return false;
+        }
+
+        in.read(reinterpret_cast<char*>(&meta), sizeof(meta));
+
+        if (!in || meta.magic != SIDECAR_MAGIC)
+        {
+            cerr << "Not a scan sidecar: " << sidecar_path << endl;
+            return false;
+        }
+
+        if (meta.version != SIDECAR_VERSION)
+        {
+            cerr << "Unsupported scan sidecar version " << meta.version
+                 << " in " << sidecar_path << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Map all columns for reading. Records past those of
+     * complete blocks, as given in meta, are ignored.
+     *
+     * If the last block is not in the blockchain, blocks
+     * are left out back to the last one which is.
+     */
+    bool
+    ScanSidecar::open(const string& sidecar_path, MicroCore& mcore)
+    {
+        if (!read_meta(sidecar_path, m_meta))
+        {
+            return false;
+        }
+
+        MappedFile* columns[NO_OF_COLUMNS] {
+                &m_block_txs, &m_tx_hashes, &m_tx_pub_keys, &m_tx_outs, &m_tx_ins,
+                &m_out_keys, &m_out_amounts, &m_key_images, &m_block_hashes};
+
+        for (size_t col = 0; col < NO_OF_COLUMNS; ++col)
+        {
+            column_id col_id = static_cast<column_id>(col);
+
+            if (!columns[col]->open(column_path(sidecar_path, col_id)))
+            {
+                return false;
+            }
+
+            if (columns[col]->size() < no_of_records(m_meta, col_id) * RECORD_SIZES[col])
+            {
+                cerr << "Scan sidecar column " << COLUMN_FILES[col]
+                     << " is shorter than its meta says" << endl;
+                return false;
+            }
+        }
+
+        if (m_meta.no_of_blocks == 0)
+        {
+            return true;
+        }
+
+        uint64_t no_of_blocks = std::min(m_meta.no_of_blocks,
+                                         mcore.get_core().get_current_blockchain_height());
+
+        crypto::hash blk_hash;
+
+        // usual case, with the last block still in the blockchain
+        if (no_of_blocks == m_meta.no_of_blocks)
+        {
+            if (!mcore.get_block_hash(no_of_blocks - 1, blk_hash))
+            {
+                return false;
+            }
+
+            if (blk_hash == m_meta.top_block_hash)
+            {
+                return true;
+            }
+        }
+
+        const crypto::hash* block_hashes = m_block_hashes.as<crypto::hash>();
+
+        for (; no_of_blocks > 0; --no_of_blocks)
+        {
+            if (!mcore.get_block_hash(no_of_blocks - 1, blk_hash))
+            {
+                return false;
+            }
+
+            if (blk_hash == block_hashes[no_of_blocks - 1])
+            {
+                break;
+            }
+        }
+
+        cerr << "Scan sidecar blocks from height " << no_of_blocks
+             << " are not in the blockchain, and are not used" << endl;
+
+        keep_blocks(no_of_blocks);
+
+        return true;
+    }
+
+
+    void
+    ScanSidecar::keep_blocks(uint64_t no_of_blocks)
+    {
+        if (no_of_blocks >= m_meta.no_of_blocks)
+        {
+            return;
+        }
+
+        sidecar_meta meta = m_meta;
+
+        meta.no_of_blocks = no_of_blocks;
+
+        meta.top_block_hash = no_of_blocks > 0
+                              ? m_block_hashes.as<crypto::hash>()[no_of_blocks - 1]
+                              : null_hash;
+
+        meta.no_of_txs = m_block_txs.as<uint64_t>()[no_of_blocks];
+
+        meta.no_of_outputs = meta.no_of_txs < m_meta.no_of_txs
+                             ? m_tx_outs.as<uint64_t>()[meta.no_of_txs]
+                             : m_meta.no_of_outputs;
+
+        meta.no_of_inputs = meta.no_of_txs < m_meta.no_of_txs
+                            ? m_tx_ins.as<uint64_t>()[meta.no_of_txs]
+                            : m_meta.no_of_inputs;
+
+        m_meta = meta;
+    }
+
+
+    ScanSidecar::row_range
+    ScanSidecar::block_txs(const uint64_t& height) const
+    {
+        const uint64_t* starts = m_block_txs.as<uint64_t>();
+
+        return row_range {starts[height],
+                          height + 1 < m_meta.no_of_blocks
+                          ? starts[height + 1] : m_meta.no_of_txs};
+    }
+
+
+    ScanSidecar::row_range
+    ScanSidecar::tx_outputs(const uint64_t& row) const
+    {
+        const uint64_t* starts = m_tx_outs.as<uint64_t>();
+
+        return row_range {starts[row],
+                          row + 1 < m_meta.no_of_txs
+                          ? starts[row + 1] : m_meta.no_of_outputs};
+    }
+
+
+    ScanSidecar::row_range
+    ScanSidecar::tx_inputs(const uint64_t& row) const
+    {
+        const uint64_t* starts = m_tx_ins.as<uint64_t>();
+
+        return row_range {starts[row],
+                          row + 1 < m_meta.no_of_txs
+                          ? starts[row + 1] : m_meta.no_of_inputs};
+    }
+
+
+    /**
+     * Find tx row of a key image, by binary search
+     * in the tx_ins column.
+     */
+    uint64_t
+    ScanSidecar::tx_row_of_input(const uint64_t& input_i) const
+    {
+        const uint64_t* starts = m_tx_ins.as<uint64_t>();
+
+        // last tx which first input is not after input_i.
+        // txs without inputs have the same start as the next tx.
+        return std::upper_bound(starts, starts + m_meta.no_of_txs, input_i)
+               - starts - 1;
+    }
+
+
+    uint64_t
+    ScanSidecar::height_of_tx(const uint64_t& row) const
+    {
+        const uint64_t* starts = m_block_txs.as<uint64_t>();
+
+        return std::upper_bound(starts, starts + m_meta.no_of_blocks, row)
+               - starts - 1;
+    }
+
+
+    /**
+     * Create sidecar in sidecar_path, or append to existing one,
+     * with blocks up to, but not including, to_height.
+     *
+     * Blocks of the existing one which are not in the blockchain
+     * any more are dropped first.
+     *
+     * txs are read as blob views and only their prefixes are parsed.
+     */
+    bool
+    ScanSidecar::build(MicroCore& mcore,
+                       const string& sidecar_path,
+                       uint64_t to_height,
+                       bool show_progress)
+    {
+        boost::system::error_code ec;
+
+        bf::create_directories(sidecar_path, ec);
+
+        if (ec)
+        {
+            cerr << "Cant create " << sidecar_path << ": " << ec.message() << endl;
+            return false;
+        }
+
+        sidecar_meta meta;
+
+        if (bf::exists(bf::path(sidecar_path) / META_FILE))
+        {
+            // its meta, without blocks not in the blockchain
+            ScanSidecar sidecar;
+
+            if (!sidecar.open(sidecar_path, mcore))
+            {
+                return false;
+            }
+
+            meta = sidecar.m_meta;
+        }
+        else
+        {
+            meta.magic   = SIDECAR_MAGIC;
+            meta.version = SIDECAR_VERSION;
+        }
+
+        ofstream columns[NO_OF_COLUMNS];
+
+        for (size_t col = 0; col < NO_OF_COLUMNS; ++col)
+        {
+            column_id col_id = static_cast<column_id>(col);
+
+            bf::path col_path = column_path(sidecar_path, col_id);
+
+            // drop records of a build that did not finish
+            // after meta was last written
+            if (bf::exists(col_path))
+            {
+                bf::resize_file(col_path, no_of_records(meta, col_id) * RECORD_SIZES[col]);
+            }
+
+            columns[col].open(col_path.string(), ios::binary | ios::app);
+
+            if (!columns[col])
+            {
+                cerr << "Cant open " << col_path << " for writing" << endl;
+                return false;
+            }
+        }
+
+        if (meta.no_of_blocks >= to_height)
+        {
+            return true;
+        }
+
+        auto commit = [&]() -> bool
+        {
+            for (ofstream& column: columns)
+            {
+                column.flush();
+
+                if (!column)
+                {
+                    cerr << "Cant write scan sidecar column" << endl;
+                    return false;
+                }
+            }
+
+            return write_meta(sidecar_path, meta);
+        };
+
+        bool ok {true};
+
+        uint64_t current_height = meta.no_of_blocks;
+
+        bool first_tx {true};
+
+        // of the last block written
+        crypto::hash blk_hash = meta.top_block_hash;
+
+        // reused for each tx
+        transaction_prefix tx;
+
+        chain_scan_result scan = mcore.for_all_tx_blobs(
+                meta.no_of_blocks, to_height,
+                [&](const uint64_t& height,
+                    const crypto::hash& tx_hash,
+                    const blob_view& tx_blob) -> bool
+                {
+                    // first tx of a new block. so all
+                    // previous blocks are complete.
+                    if (height != current_height || first_tx)
+                    {
+                        first_tx = false;
+
+                        meta.no_of_blocks   = height;
+                        meta.top_block_hash = blk_hash;
+
+                        if (height != current_height && height % COMMIT_INTERVAL == 0)
+                        {
+                            if (!(ok = commit()))
+                            {
+                                return false;
+                            }
+
+                            if (show_progress)
+                            {
+                                cout << "\r - scan sidecar height: "
+                                     << height << "/" << to_height << flush;
+                            }
+                        }
+
+                        if (!(ok = mcore.get_block_hash(height, blk_hash)))
+                        {
+                            return false;
+                        }
+
+                        write_record(columns[BLOCK_HASHES], blk_hash);
+                        write_record(columns[BLOCK_TXS], meta.no_of_txs);
+
+                        current_height = height;
+                    }
+
+                    if (!parse_tx_prefix_from_view(tx_blob, tx))
+                    {
+                        cerr << "Cant parse tx " << tx_hash << endl;
+                        ok = false;
+                        return false;
+                    }
+
+                    write_record(columns[TX_HASHES], tx_hash);
+                    write_record(columns[TX_PUB_KEYS], scan_tx_pub_key(tx.extra));
+                    write_record(columns[TX_OUTS], meta.no_of_outputs);
+                    write_record(columns[TX_INS], meta.no_of_inputs);
+
+                    for (const tx_out& out: tx.vout)
+                    {
+                        public_key out_key = null_pkey;
+
+                        if (out.target.type() == typeid(txout_to_key))
+                        {
+                            out_key = boost::get<txout_to_key>(out.target).key;
+                        }
+
+                        write_record(columns[OUT_KEYS], out_key);
+                        write_record(columns[OUT_AMOUNTS], out.amount);
+
+                        ++meta.no_of_outputs;
+                    }
+
+                    for (const txin_v& in: tx.vin)
+                    {
+                        if (in.type() == typeid(txin_to_key))
+                        {
+                            write_record(columns[KEY_IMAGES],
+                                         boost::get<txin_to_key>(in).k_image);
+
+                            ++meta.no_of_inputs;
+                        }
+                    }
+
+                    ++meta.no_of_txs;
+
+                    return true;
+                });
+
+        if (!scan.complete || !ok)
+        {
+            return false;
+        }
+
+        // the last block is complete too
+        if (!first_tx)
+        {
+            meta.no_of_blocks   = current_height + 1;
+            meta.top_block_hash = blk_hash;
+        }
+
+        if (show_progress)
+        {
+            cout << "\r - scan sidecar height: "
+                 << meta.no_of_blocks << "/" << to_height << endl;
+        }
+
+        return commit();
+    }
+
+}
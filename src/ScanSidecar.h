@@ -0,0 +1,147 @@
+#ifndef XMREG01_SCANSIDECAR_H
+#define XMREG01_SCANSIDECAR_H
+
+#include "monero_headers.h"
+#include "MappedFile.h"
+
+#include <string>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    class MicroCore;
+
+    /**
+     * Columnar copy of the few tx fields that ownership and
+     * spent key scans need, kept in a folder next to the blockchain.
+     *
+     * Each column is a file of fixed size records, memory mapped
+     * for reading:
+     *
+     *  - block_txs:     per block, row of its first tx
+     *  - tx_hashes:     per tx row, tx hash
+     *  - tx_pub_keys:   per tx row, tx public key from extra
+     *  - tx_outs:       per tx row, index of its first output
+     *  - tx_ins:        per tx row, index of its first key image
+     *  - out_keys:      per output, its public key
+     *  - out_amounts:   per output, its amount
+     *  - key_images:    per txin_to_key input, its key image
+     *  - block_hashes:  per block, its hash
+     *
+     * txs go in the order they are in the blockchain, with coinbase
+     * txs first in their blocks. The meta file holds number of records
+     * of complete blocks, and is written last, so the sidecar can be
+     * appended to as the blockchain grows.
+     *
+     * The meta also holds hash of the last block. If it is not in
+     * the blockchain any more, e.g., after a reorg, blocks from the
+     * first one not in the blockchain on are not used, and are
+     * replaced by the next build.
+     */
+    class ScanSidecar
+    {
+    public:
+
+        struct sidecar_meta
+        {
+            uint64_t magic {0};
+            uint64_t version {0};
+            uint64_t no_of_blocks {0};
+            uint64_t no_of_txs {0};
+            uint64_t no_of_outputs {0};
+            uint64_t no_of_inputs {0};
+            crypto::hash top_block_hash {null_hash};
+        };
+
+        // [begin, end) range of rows or records
+        struct row_range
+        {
+            uint64_t begin {0};
+            uint64_t end {0};
+        };
+
+        ScanSidecar() = default;
+
+        ScanSidecar(const ScanSidecar&) = delete;
+        ScanSidecar& operator=(const ScanSidecar&) = delete;
+
+        // blocks not in mcore's blockchain are left out
+        bool
+        open(const string& sidecar_path, MicroCore& mcore);
+
+        uint64_t
+        height() const { return m_meta.no_of_blocks; }
+
+        uint64_t
+        no_of_txs() const { return m_meta.no_of_txs; }
+
+        uint64_t
+        no_of_outputs() const { return m_meta.no_of_outputs; }
+
+        uint64_t
+        no_of_inputs() const { return m_meta.no_of_inputs; }
+
+        row_range
+        block_txs(const uint64_t& height) const;
+
+        const crypto::hash&
+        tx_hash(const uint64_t& row) const { return m_tx_hashes.as<crypto::hash>()[row]; }
+
+        const public_key&
+        tx_pub_key(const uint64_t& row) const { return m_tx_pub_keys.as<public_key>()[row]; }
+
+        row_range
+        tx_outputs(const uint64_t& row) const;
+
+        row_range
+        tx_inputs(const uint64_t& row) const;
+
+        const public_key*
+        output_keys() const { return m_out_keys.as<public_key>(); }
+
+        const uint64_t*
+        output_amounts() const { return m_out_amounts.as<uint64_t>(); }
+
+        const key_image*
+        key_images() const { return m_key_images.as<key_image>(); }
+
+        uint64_t
+        tx_row_of_input(const uint64_t& input_i) const;
+
+        uint64_t
+        height_of_tx(const uint64_t& row) const;
+
+        static bool
+        build(MicroCore& mcore,
+              const string& sidecar_path,
+              uint64_t to_height,
+              bool show_progress = false);
+
+        static bool
+        read_meta(const string& sidecar_path, sidecar_meta& meta);
+
+    private:
+
+        // leave out blocks from no_of_blocks on
+        void
+        keep_blocks(uint64_t no_of_blocks);
+
+        sidecar_meta m_meta;
+
+        MappedFile m_block_txs;
+        MappedFile m_tx_hashes;
+        MappedFile m_tx_pub_keys;
+        MappedFile m_tx_outs;
+        MappedFile m_tx_ins;
+        MappedFile m_out_keys;
+        MappedFile m_out_amounts;
+        MappedFile m_key_images;
+        MappedFile m_block_hashes;
+    };
+
+}
+
+#endif //XMREG01_SCANSIDECAR_H
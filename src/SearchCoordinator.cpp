@@ -0,0 +1,502 @@
+#include "SearchCoordinator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace xmreg
+{
+
+namespace
+{
+    // txs scanned between checks for new searches
+    const size_t SCAN_BATCH {256};
+
+    // end of a bucket or of the free list
+    const uint32_t NO_WAITER {std::numeric_limits<uint32_t>::max()};
+
+    const size_t MIN_BUCKETS {64};
+}
+
+
+    SearchCoordinator::SearchCoordinator(const ChainReader& reader)
+            : m_reader {reader},
+              m_buckets(MIN_BUCKETS, NO_WAITER),
+              m_free {NO_WAITER}
+    {
+        m_scan_thread = thread {&SearchCoordinator::scan, this};
+    }
+
+
+    void
+    SearchCoordinator::search(const vector<key_image>& key_imgs, result_callback f)
+    {
+        {
+            lock_guard<mutex> lock {m_mutex};
+
+            if (!m_stopping)
+            {
+                for (const key_image& k_image: key_imgs)
+                {
+                    m_new_searches.push_back(waiter {k_image, f, nullptr, 0});
+                }
+
+                m_cv.notify_one();
+
+                return;
+            }
+        }
+
+        // scan thread is gone, so nobody would answer
+        for (const key_image& k_image: key_imgs)
+        {
+            f(k_image, null_hash, false);
+        }
+    }
+
+
+    bool
+    SearchCoordinator::find(const vector<key_image>& key_imgs,
+                            unordered_map<key_image, crypto::hash>& txs_found)
+    {
+        vector<crypto::hash> tx_hashes(key_imgs.size());
+
+        bool complete = find(key_imgs.data(), key_imgs.size(), tx_hashes.data());
+
+        for (size_t i = 0; i < key_imgs.size(); ++i)
+        {
+            if (tx_hashes[i] != null_hash)
+            {
+                txs_found[key_imgs[i]] = tx_hashes[i];
+            }
+        }
+
+        return complete;
+    }
+
+
+    bool
+    SearchCoordinator::find(const key_image* key_imgs,
+                            size_t no_of_key_images,
+                            crypto::hash* tx_hashes)
+    {
+        if (no_of_key_images == 0)
+        {
+            return true;
+        }
+
+        // waiters point to it, and we wait for all of them
+        // to be answered before returning
+        find_batch batch;
+
+        batch.left      = no_of_key_images;
+        batch.tx_hashes = tx_hashes;
+
+        {
+            lock_guard<mutex> lock {m_mutex};
+
+            if (m_stopping)
+            {
+                std::fill(tx_hashes, tx_hashes + no_of_key_images, null_hash);
+                return false;
+            }
+
+            for (size_t i = 0; i < no_of_key_images; ++i)
+            {
+                m_new_searches.push_back(waiter {key_imgs[i], nullptr, &batch, i});
+            }
+        }
+
+        m_cv.notify_one();
+
+        unique_lock<mutex> lock {batch.m};
+
+        batch.cv.wait(lock, [&]{ return batch.left == 0; });
+
+        return batch.complete;
+    }
+
+
+    void
+    SearchCoordinator::stop()
+    {
+        {
+            lock_guard<mutex> lock {m_mutex};
+            m_stopping = true;
+        }
+
+        m_cv.notify_one();
+
+        if (m_scan_thread.joinable())
+        {
+            m_scan_thread.join();
+        }
+    }
+
+
+    SearchCoordinator::~SearchCoordinator()
+    {
+        stop();
+    }
+
+
+    void
+    SearchCoordinator::scan()
+    {
+        ChainReader::ReadTxn txn;
+
+        // reused for each tx
+        transaction_prefix tx;
+
+        while (true)
+        {
+            {
+                unique_lock<mutex> lock {m_mutex};
+
+                if (m_no_of_waiters == 0)
+                {
+                    // dont keep old snapshot of the
+                    // blockchain while waiting. the cursor
+                    // starts over with the new one.
+                    txn.close();
+
+                    if (m_lap_started)
+                    {
+                        end_lap();
+                    }
+
+                    m_cv.wait(lock, [&]{ return m_stopping || !m_new_searches.empty(); });
+                }
+
+                if (m_stopping)
+                {
+                    break;
+                }
+            }
+
+            if (!txn.is_open() && !m_reader.begin_read(txn))
+            {
+                cerr << "Cant start read transaction for key image search" << endl;
+                break;
+            }
+
+            join_new_searches();
+
+            for (size_t i = 0; i < SCAN_BATCH && m_no_of_waiters > 0; ++i)
+            {
+                crypto::hash tx_hash;
+                blob_view tx_blob;
+
+                if (!txn.get_next_tx_blob(tx_hash, tx_blob))
+                {
+                    end_lap();
+                    break;
+                }
+
+                m_lap_started = true;
+                m_last_key    = tx_hash;
+
+                if (!parse_tx_prefix_from_view(tx_blob, tx))
+                {
+                    // its key images are unknown, so
+                    // none of the searches can finish
+                    cerr << "Cant parse tx " << tx_hash << endl;
+                    fail_searches();
+                    continue;
+                }
+
+                for (const txin_v& in: tx.vin)
+                {
+                    if (in.type() != typeid(txin_to_key))
+                    {
+                        continue;
+                    }
+
+                    answer_found(boost::get<txin_to_key>(in).k_image, tx_hash);
+                }
+            }
+
+            expire_searches(txn);
+
+            if (!m_lap_started)
+            {
+                // end of txs table. wrap around with new read
+                // transaction, to see txs added since this one started
+                txn.close();
+            }
+        }
+
+        // from now on, search() answers by itself. also when
+        // we got here because read transaction could not start.
+        {
+            lock_guard<mutex> lock {m_mutex};
+            m_stopping = true;
+        }
+
+        join_new_searches();
+
+        fail_searches();
+    }
+
+
+    /**
+     * Move searches added since the last batch into the pool
+     * of waiters, joining at the current position of the cursor.
+     */
+    void
+    SearchCoordinator::join_new_searches()
+    {
+        {
+            lock_guard<mutex> lock {m_mutex};
+
+            if (m_new_searches.empty())
+            {
+                return;
+            }
+
+            m_joining.swap(m_new_searches);
+        }
+
+        for (waiter& w: m_joining)
+        {
+            if (m_no_of_waiters == 0)
+            {
+                m_oldest_join_lap = m_lap;
+            }
+
+            w.join_lap       = m_lap;
+            w.joined_mid_lap = m_lap_started;
+            w.join_key       = m_last_key;
+
+            add_waiter(w);
+        }
+
+        // keeps its capacity for the next swap
+        m_joining.clear();
+    }
+
+
+    void
+    SearchCoordinator::add_waiter(waiter& w)
+    {
+        if (m_no_of_waiters >= m_buckets.size())
+        {
+            rehash(2 * m_buckets.size());
+        }
+
+        uint32_t i = m_free;
+
+        if (i == NO_WAITER)
+        {
+            i = static_cast<uint32_t>(m_waiters.size());
+            m_waiters.push_back(std::move(w));
+        }
+        else
+        {
+            m_free       = m_waiters[i].next;
+            m_waiters[i] = std::move(w);
+        }
+
+        uint32_t& head = m_buckets[bucket_of(m_waiters[i].k_image)];
+
+        m_waiters[i].next = head;
+        head              = i;
+
+        ++m_no_of_waiters;
+    }
+
+
+    void
+    SearchCoordinator::remove_waiter(uint32_t* link)
+    {
+        uint32_t i = *link;
+        waiter& w  = m_waiters[i];
+
+        *link = w.next;
+
+        // dont keep callback's captures alive
+        w.f     = nullptr;
+        w.batch = nullptr;
+
+        w.next = m_free;
+        m_free = i;
+
+        --m_no_of_waiters;
+    }
+
+
+    void
+    SearchCoordinator::rehash(size_t no_of_buckets)
+    {
+        vector<uint32_t> old_buckets(no_of_buckets, NO_WAITER);
+
+        old_buckets.swap(m_buckets);
+
+        for (uint32_t i: old_buckets)
+        {
+            while (i != NO_WAITER)
+            {
+                waiter& w = m_waiters[i];
+
+                uint32_t next = w.next;
+                uint32_t& head = m_buckets[bucket_of(w.k_image)];
+
+                w.next = head;
+                head   = i;
+
+                i = next;
+            }
+        }
+    }
+
+
+    size_t
+    SearchCoordinator::bucket_of(const key_image& k_image) const
+    {
+        // key images are hashes, so any of their bits will do
+        uint64_t h;
+        std::memcpy(&h, &k_image, sizeof(h));
+
+        // number of buckets is a power of two
+        return h & (m_buckets.size() - 1);
+    }
+
+
+    void
+    SearchCoordinator::answer(waiter& w, const crypto::hash& tx_hash, bool complete)
+    {
+        if (!w.batch)
+        {
+            w.f(w.k_image, tx_hash, complete);
+            return;
+        }
+
+        find_batch& batch = *w.batch;
+
+        // find() returns, and batch is gone, once the last
+        // of its waiters is answered and the lock released
+        lock_guard<mutex> lock {batch.m};
+
+        batch.tx_hashes[w.batch_i] = tx_hash;
+
+        batch.complete = batch.complete && complete;
+
+        if (--batch.left == 0)
+        {
+            batch.cv.notify_all();
+        }
+    }
+
+
+    void
+    SearchCoordinator::answer_found(const key_image& k_image, const crypto::hash& tx_hash)
+    {
+        uint32_t* link = &m_buckets[bucket_of(k_image)];
+
+        while (*link != NO_WAITER)
+        {
+            waiter& w = m_waiters[*link];
+
+            if (w.k_image != k_image)
+            {
+                link = &w.next;
+                continue;
+            }
+
+            answer(w, tx_hash, true);
+
+            remove_waiter(link);
+        }
+    }
+
+
+    void
+    SearchCoordinator::end_lap()
+    {
+        ++m_lap;
+        m_lap_started = false;
+    }
+
+
+    /**
+     * A search joined at the start of a lap is done at its end.
+     * Otherwise it still needs txs up to and including the one
+     * it joined after, in the next lap, whatever was added
+     * to the table in the meantime.
+     */
+    bool
+    SearchCoordinator::lap_done(const waiter& w, const ChainReader::ReadTxn& txn) const
+    {
+        if (!w.joined_mid_lap)
+        {
+            return m_lap > w.join_lap;
+        }
+
+        if (m_lap > w.join_lap + 1)
+        {
+            return true;
+        }
+
+        return m_lap == w.join_lap + 1
+               && m_lap_started
+               && txn.compare_tx_hashes(m_last_key, w.join_key) >= 0;
+    }
+
+
+    /**
+     * Report as not found key images which
+     * were checked against all txs.
+     */
+    void
+    SearchCoordinator::expire_searches(const ChainReader::ReadTxn& txn)
+    {
+        // searches are done in the lap after they joined, at the earliest
+        if (m_no_of_waiters == 0 || m_lap == m_oldest_join_lap)
+        {
+            return;
+        }
+
+        m_oldest_join_lap = m_lap;
+
+        for (uint32_t& head: m_buckets)
+        {
+            uint32_t* link = &head;
+
+            while (*link != NO_WAITER)
+            {
+                waiter& w = m_waiters[*link];
+
+                if (!lap_done(w, txn))
+                {
+                    m_oldest_join_lap = std::min(m_oldest_join_lap, w.join_lap);
+                    link = &w.next;
+                    continue;
+                }
+
+                answer(w, null_hash, true);
+
+                remove_waiter(link);
+            }
+        }
+    }
+
+
+    /**
+     * Answer all searches as failed, e.g., when a tx
+     * can not be parsed or the scan is stopped.
+     */
+    void
+    SearchCoordinator::fail_searches()
+    {
+        for (uint32_t& head: m_buckets)
+        {
+            while (head != NO_WAITER)
+            {
+                answer(m_waiters[head], null_hash, false);
+
+                remove_waiter(&head);
+            }
+        }
+    }
+
+}
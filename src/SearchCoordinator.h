@@ -0,0 +1,202 @@
+#ifndef XMREG01_SEARCHCOORDINATOR_H
+#define XMREG01_SEARCHCOORDINATOR_H
+
+#include "monero_headers.h"
+#include "ChainReader.h"
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    /**
+     * Shares one pass over the txs table between all
+     * searches for txs spending given key images.
+     *
+     * A single scan thread walks the txs with a cursor. Key images
+     * searched for while it runs join at the cursor's current
+     * position, and the cursor wraps around to the first tx at the
+     * end of the table, so each key image is checked against all txs
+     * once, no matter when it joined. The scan thread waits when
+     * nothing is searched for.
+     *
+     * Each wrap starts a new read transaction, which can see txs
+     * added in the meantime anywhere in the key order. So a search
+     * is done when, in the lap after it joined, the cursor passes
+     * the key it joined at, rather than after a number of txs.
+     *
+     * Callbacks are called from the scan thread as soon as the tx
+     * is found, or after a whole lap without it. If a tx can not be
+     * parsed, or the coordinator is stopped, searches running at that
+     * time are answered as failed, as they can not check all txs.
+     *
+     * Waiting key images are kept in a pool of waiters, linked into
+     * buckets by key image, which is reused as searches end. So once
+     * the pool and the queue of new searches have grown to the most
+     * key images searched for at a time, find() into a tx_hashes
+     * array does not allocate. search() copies its callback
+     * for each key image.
+     */
+    class SearchCoordinator
+    {
+    public:
+
+        // tx_hash is null_hash if no tx with k_image was found.
+        // complete is false if the search failed before all
+        // txs were checked.
+        using result_callback = std::function<void(const key_image& k_image,
+                                                   const crypto::hash& tx_hash,
+                                                   bool complete)>;
+
+        explicit SearchCoordinator(const ChainReader& reader);
+
+        SearchCoordinator(const SearchCoordinator&) = delete;
+        SearchCoordinator& operator=(const SearchCoordinator&) = delete;
+
+        /**
+         * Add key images to the running scan. f is called
+         * once for each of them, right away if it is stopped.
+         */
+        void
+        search(const vector<key_image>& key_imgs, result_callback f);
+
+        /**
+         * Add key images to the running scan and
+         * wait for all of them to be found or not.
+         *
+         * Returns false if search of any of them failed.
+         */
+        bool
+        find(const vector<key_image>& key_imgs,
+             unordered_map<key_image, crypto::hash>& txs_found);
+
+        /**
+         * Same as above, for no_of_key_images key images one after
+         * another. Hash of tx found for each, or null_hash, is written
+         * to tx_hashes, so results need no memory of their own.
+         */
+        bool
+        find(const key_image* key_imgs,
+             size_t no_of_key_images,
+             crypto::hash* tx_hashes);
+
+        void
+        stop();
+
+        ~SearchCoordinator();
+
+    private:
+
+        // find() waiting for its key images, on its stack
+        struct find_batch
+        {
+            mutex m;
+            condition_variable cv;
+            size_t left;
+            bool complete {true};
+            crypto::hash* tx_hashes;
+        };
+
+        struct waiter
+        {
+            key_image k_image;
+
+            // called with the result, or, if batch is set,
+            // the result goes to batch->tx_hashes[batch_i]
+            result_callback f;
+            find_batch* batch;
+            size_t batch_i;
+
+            // lap in which it joined, and, if it joined after
+            // txs of that lap were scanned, the last of them
+            uint64_t join_lap;
+            bool joined_mid_lap;
+            crypto::hash join_key;
+
+            // next waiter in the same bucket, or in the free list
+            uint32_t next;
+        };
+
+        void
+        scan();
+
+        void
+        join_new_searches();
+
+        void
+        add_waiter(waiter& w);
+
+        // unlink waiter from its bucket, given by link, and free it
+        void
+        remove_waiter(uint32_t* link);
+
+        void
+        rehash(size_t no_of_buckets);
+
+        size_t
+        bucket_of(const key_image& k_image) const;
+
+        void
+        answer(waiter& w, const crypto::hash& tx_hash, bool complete);
+
+        void
+        answer_found(const key_image& k_image, const crypto::hash& tx_hash);
+
+        // cursor went past the end of the txs table
+        void
+        end_lap();
+
+        bool
+        lap_done(const waiter& w, const ChainReader::ReadTxn& txn) const;
+
+        void
+        expire_searches(const ChainReader::ReadTxn& txn);
+
+        void
+        fail_searches();
+
+        const ChainReader& m_reader;
+
+        thread m_scan_thread;
+
+        // protects m_new_searches and m_stopping
+        mutex m_mutex;
+        condition_variable m_cv;
+
+        vector<waiter> m_new_searches;
+
+        bool m_stopping {false};
+
+        // owned by the scan thread. m_joining is swapped with
+        // m_new_searches, so both keep their capacity.
+        vector<waiter> m_joining;
+
+        // pool of waiters, heads of their buckets,
+        // and head of the free list
+        vector<waiter> m_waiters;
+        vector<uint32_t> m_buckets;
+        uint32_t m_free;
+
+        size_t m_no_of_waiters {0};
+
+        // number of laps over the txs table, and
+        // the last tx scanned in the current one
+        uint64_t m_lap {0};
+        bool m_lap_started {false};
+        crypto::hash m_last_key;
+
+        // smallest join_lap of the waiters
+        uint64_t m_oldest_join_lap {0};
+    };
+
+}
+
+#endif //XMREG01_SEARCHCOORDINATOR_H
@@ -0,0 +1,329 @@
+#include "SegmentedIndex.h"
+#include "MicroCore.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace xmreg
+{
+
+namespace
+{
+    namespace bf = boost::filesystem;
+
+    const char* const META_FILE {"meta"};
+
+    // more segments than this are merged into one
+    const size_t MAX_SEGMENTS {8};
+
+    struct index_meta
+    {
+        uint64_t magic;
+        uint64_t version;
+        uint64_t key_size;
+        uint64_t record_size;
+        uint64_t height;
+        uint64_t no_of_segments;
+        crypto::hash top_block_hash;
+    };
+}
+
+
+    SegmentedIndex::SegmentedIndex(const string& name,
+                                   uint64_t magic,
+                                   uint64_t version,
+                                   size_t key_size,
+                                   size_t record_size,
+                                   const vector<string>& file_prefixes)
+            : m_key_size {key_size},
+              m_record_size {record_size},
+              m_name {name},
+              m_magic {magic},
+              m_version {version},
+              m_file_prefixes {file_prefixes}
+    {}
+
+
+    bool
+    SegmentedIndex::open(const string& index_path, MicroCore& mcore, bool create)
+    {
+        m_mcore      = &mcore;
+        m_index_path = index_path;
+        m_height     = 0;
+
+        m_ranges.clear();
+        m_dropped.clear();
+        unmap_segments();
+
+        bf::path meta_path = bf::path(index_path) / META_FILE;
+
+        if (!bf::exists(meta_path))
+        {
+            if (!create)
+            {
+                cerr << "No " << m_name << " in " << index_path << endl;
+                return false;
+            }
+
+            boost::system::error_code ec;
+
+            bf::create_directories(index_path, ec);
+
+            if (ec)
+            {
+                cerr << "Cant create " << index_path << ": " << ec.message() << endl;
+                return false;
+            }
+
+            return true;
+        }
+
+        ifstream in(meta_path.string(), ios::binary);
+
+        index_meta meta;
+
+        in.read(reinterpret_cast<char*>(&meta), sizeof(meta));
+
+        if (!in || meta.magic != m_magic)
+        {
+            cerr << "Not a " << m_name << ": " << index_path << endl;
+            return false;
+        }
+
+        if (meta.version != m_version
+            || meta.key_size != m_key_size
+            || meta.record_size != m_record_size)
+        {
+            cerr << "The " << m_name << " in " << index_path
+                 << " has other version or records" << endl;
+            return false;
+        }
+
+        vector<segment_range> ranges(meta.no_of_segments);
+
+        in.read(reinterpret_cast<char*>(ranges.data()),
+                ranges.size() * sizeof(segment_range));
+
+        if (!in)
+        {
+            cerr << "The " << m_name << " meta is too short: " << index_path << endl;
+            return false;
+        }
+
+        uint64_t height = meta.height;
+
+        bool in_chain {true};
+
+        if (height > 0 && !chain_has_blocks(height, meta.top_block_hash, in_chain))
+        {
+            return false;
+        }
+
+        if (!in_chain)
+        {
+            // last segment whose last block is still in the blockchain
+            size_t no_of_kept = ranges.size();
+
+            for (; no_of_kept > 0; --no_of_kept)
+            {
+                const segment_range& range = ranges[no_of_kept - 1];
+
+                if (!chain_has_blocks(range.h1, range.last_block_hash, in_chain))
+                {
+                    return false;
+                }
+
+                if (in_chain)
+                {
+                    break;
+                }
+            }
+
+            height = no_of_kept > 0 ? ranges[no_of_kept - 1].h1 : 0;
+
+            cerr << "The " << m_name << " blocks from height " << height
+                 << " are not in the blockchain, and are not used" << endl;
+
+            m_dropped.assign(ranges.begin() + no_of_kept, ranges.end());
+
+            ranges.resize(no_of_kept);
+        }
+
+        for (const segment_range& range: ranges)
+        {
+            m_ranges.push_back(range);
+
+            if (!map_segment(range.h0, range.h1))
+            {
+                return false;
+            }
+        }
+
+        m_height = height;
+
+        return true;
+    }
+
+
+    string
+    SegmentedIndex::segment_path(const string& prefix,
+                                 const uint64_t& h0, const uint64_t& h1) const
+    {
+        return (bf::path(m_index_path) / (prefix + "_" + std::to_string(h0)
+                                          + "_" + std::to_string(h1))).string();
+    }
+
+
+    /**
+     * Add the new segment, merging all if there are too many,
+     * and make it part of the index by writing the meta. Segments
+     * not in the new meta, e.g., merged ones or ones not in the
+     * blockchain any more, are removed afterwards.
+     */
+    bool
+    SegmentedIndex::add_segment(uint64_t to_height, bool new_segment)
+    {
+        if (to_height < m_height)
+        {
+            return false;
+        }
+
+        crypto::hash top_block_hash {null_hash};
+
+        if (to_height > 0 && !m_mcore->get_block_hash(to_height - 1, top_block_hash))
+        {
+            return false;
+        }
+
+        vector<segment_range> ranges = m_ranges;
+
+        if (new_segment)
+        {
+            ranges.push_back(segment_range {m_height, to_height, top_block_hash});
+        }
+
+        vector<segment_range> old_ranges = m_dropped;
+
+        if (ranges.size() > MAX_SEGMENTS)
+        {
+            // new segment is merged too, so map it first
+            if (new_segment && !map_segment(m_height, to_height))
+            {
+                return false;
+            }
+
+            segment_range merged {ranges.front().h0, to_height, top_block_hash};
+
+            if (!merge_segments(merged.h0, merged.h1))
+            {
+                return false;
+            }
+
+            old_ranges.insert(old_ranges.end(), ranges.begin(), ranges.end());
+
+            ranges.assign(1, merged);
+        }
+
+        if (!write_meta(ranges, to_height, top_block_hash))
+        {
+            return false;
+        }
+
+        for (const segment_range& old_range: old_ranges)
+        {
+            // files of the new meta can have names of old ones
+            bool in_use = std::any_of(ranges.begin(), ranges.end(),
+                                      [&](const segment_range& range)
+                                      {
+                                          return range.h0 == old_range.h0
+                                                 && range.h1 == old_range.h1;
+                                      });
+
+            if (in_use)
+            {
+                continue;
+            }
+
+            for (const string& prefix: m_file_prefixes)
+            {
+                boost::system::error_code ec;
+                bf::remove(segment_path(prefix, old_range.h0, old_range.h1), ec);
+            }
+        }
+
+        // map the segments from the new meta
+        return open(m_index_path, *m_mcore);
+    }
+
+
+    bool
+    SegmentedIndex::chain_has_blocks(const uint64_t& no_of_blocks,
+                                     const crypto::hash& blk_hash,
+                                     bool& has_blocks) const
+    {
+        has_blocks = false;
+
+        if (no_of_blocks > m_mcore->get_core().get_current_blockchain_height())
+        {
+            return true;
+        }
+
+        crypto::hash chain_blk_hash;
+
+        if (!m_mcore->get_block_hash(no_of_blocks - 1, chain_blk_hash))
+        {
+            return false;
+        }
+
+        has_blocks = chain_blk_hash == blk_hash;
+
+        return true;
+    }
+
+
+    bool
+    SegmentedIndex::write_meta(const vector<segment_range>& ranges,
+                               uint64_t height,
+                               const crypto::hash& top_block_hash) const
+    {
+        bf::path meta_path = bf::path(m_index_path) / META_FILE;
+        bf::path tmp_path  = meta_path;
+
+        tmp_path += ".tmp";
+
+        {
+            ofstream out(tmp_path.string(), ios::binary | ios::trunc);
+
+            index_meta meta {m_magic, m_version, m_key_size, m_record_size,
+                             height, ranges.size(), top_block_hash};
+
+            out.write(reinterpret_cast<const char*>(&meta), sizeof(meta));
+
+            out.write(reinterpret_cast<const char*>(ranges.data()),
+                      ranges.size() * sizeof(segment_range));
+
+            if (!out.flush())
+            {
+                cerr << "Cant write " << tmp_path << endl;
+                return false;
+            }
+        }
+
+        // rename is atomic, so meta is either old or new one
+        boost::system::error_code ec;
+
+        bf::rename(tmp_path, meta_path, ec);
+
+        if (ec)
+        {
+            cerr << "Cant rename " << tmp_path << ": " << ec.message() << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+}
@@ -0,0 +1,132 @@
+#ifndef XMREG01_SEGMENTEDINDEX_H
+#define XMREG01_SEGMENTEDINDEX_H
+
+#include "monero_headers.h"
+
+#include <string>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    class MicroCore;
+
+    /**
+     * Folder of an index of blocks [0, height()), kept in
+     * segments, each of blocks [h0, h1) and made of one file
+     * per prefix, e.g., prefix_h0_h1.
+     *
+     * Each update adds a segment with blocks not yet indexed,
+     * so the index can be kept up to date cheaply. When there
+     * are too many of them, all segments are merged into one.
+     *
+     * The meta file lists the segments and is written last,
+     * so files of an update that did not finish are not used.
+     * Subclasses map and merge the files of their segments.
+     *
+     * The meta also has hashes of the last block of the index and
+     * of each segment. If the last block is not in the blockchain
+     * any more, e.g., after a reorg, only segments up to the last
+     * one whose last block still is are used, and files of the
+     * others are removed by the next update.
+     */
+    class SegmentedIndex
+    {
+    public:
+
+        SegmentedIndex(const string& name,
+                       uint64_t magic,
+                       uint64_t version,
+                       size_t key_size,
+                       size_t record_size,
+                       const vector<string>& file_prefixes);
+
+        SegmentedIndex(const SegmentedIndex&) = delete;
+        SegmentedIndex& operator=(const SegmentedIndex&) = delete;
+
+        virtual ~SegmentedIndex() = default;
+
+        // with create, missing index is made empty. blocks
+        // are checked against mcore's blockchain.
+        bool
+        open(const string& index_path, MicroCore& mcore, bool create = false);
+
+        uint64_t
+        height() const { return m_height; }
+
+    protected:
+
+        string
+        segment_path(const string& prefix,
+                     const uint64_t& h0, const uint64_t& h1) const;
+
+        /**
+         * Make blocks [height(), to_height) part of the index.
+         * With new_segment, files of the segment are written
+         * already, otherwise the blocks have nothing to index.
+         */
+        bool
+        add_segment(uint64_t to_height, bool new_segment);
+
+        // adds files of the segment to mapped ones, in height order
+        virtual bool
+        map_segment(const uint64_t& h0, const uint64_t& h1) = 0;
+
+        virtual void
+        unmap_segments() = 0;
+
+        // write mapped segments as one of blocks [h0, h1)
+        virtual bool
+        merge_segments(const uint64_t& h0, const uint64_t& h1) const = 0;
+
+        size_t m_key_size;
+        size_t m_record_size;
+
+    private:
+
+        struct segment_range
+        {
+            uint64_t h0;
+            uint64_t h1;
+
+            crypto::hash last_block_hash;
+        };
+
+        // blockchain has no_of_blocks blocks or more, the
+        // last of them of blk_hash
+        bool
+        chain_has_blocks(const uint64_t& no_of_blocks,
+                         const crypto::hash& blk_hash,
+                         bool& has_blocks) const;
+
+        bool
+        write_meta(const vector<segment_range>& ranges,
+                   uint64_t height,
+                   const crypto::hash& top_block_hash) const;
+
+        string m_name;
+
+        uint64_t m_magic;
+        uint64_t m_version;
+
+        vector<string> m_file_prefixes;
+
+        MicroCore* m_mcore {nullptr};
+
+        string m_index_path;
+
+        uint64_t m_height {0};
+
+        // of mapped segments
+        vector<segment_range> m_ranges;
+
+        // of segments not in the blockchain any more
+        vector<segment_range> m_dropped;
+    };
+
+}
+
+#endif //XMREG01_SEGMENTEDINDEX_H
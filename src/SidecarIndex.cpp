@@ -0,0 +1,205 @@
+#include "SidecarIndex.h"
+
+#include <fstream>
+#include <iostream>
+
+namespace xmreg
+{
+
+namespace
+{
+    const uint64_t INDEX_MAGIC   {0x786564696373787dull};
+    const uint64_t INDEX_VERSION {2};
+
+    const char* const SEGMENT_FILE {"segment"};
+}
+
+
+    SidecarIndexBase::SidecarIndexBase(size_t key_size, size_t record_size)
+            : SegmentedIndex("sidecar index", INDEX_MAGIC, INDEX_VERSION,
+                             key_size, record_size, {SEGMENT_FILE})
+    {}
+
+
+    uint64_t
+    SidecarIndexBase::no_of_records() const
+    {
+        uint64_t no_of_records {0};
+
+        for (const segment& seg: m_segments)
+        {
+            no_of_records += seg.file->size() / m_record_size;
+        }
+
+        return no_of_records;
+    }
+
+
+    /**
+     * Call f for all records of the key, by
+     * binary search in each segment.
+     */
+    void
+    SidecarIndexBase::for_each_match(const void* key,
+                                     const std::function<void(const char* record)>& f) const
+    {
+        for (const segment& seg: m_segments)
+        {
+            const char* records = seg.file->data();
+
+            size_t lo {0};
+            size_t hi = seg.file->size() / m_record_size;
+
+            // first record not less than the key
+            while (lo < hi)
+            {
+                size_t mid = lo + (hi - lo) / 2;
+
+                if (memcmp(records + mid * m_record_size, key, m_key_size) < 0)
+                {
+                    lo = mid + 1;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+
+            size_t no_of_records = seg.file->size() / m_record_size;
+
+            for (size_t i = lo; i < no_of_records; ++i)
+            {
+                const char* record = records + i * m_record_size;
+
+                if (memcmp(record, key, m_key_size) != 0)
+                {
+                    break;
+                }
+
+                f(record);
+            }
+        }
+    }
+
+
+    void
+    SidecarIndexBase::for_each_record(const std::function<void(const char* record)>& f) const
+    {
+        for (const segment& seg: m_segments)
+        {
+            for (size_t offset = 0;
+                 offset + m_record_size <= seg.file->size();
+                 offset += m_record_size)
+            {
+                f(seg.file->data() + offset);
+            }
+        }
+    }
+
+
+    bool
+    SidecarIndexBase::append_sorted(uint64_t to_height,
+                                    const char* records,
+                                    size_t no_of_records)
+    {
+        if (to_height < height())
+        {
+            return false;
+        }
+
+        if (no_of_records > 0)
+        {
+            string new_path = segment_path(SEGMENT_FILE, height(), to_height);
+
+            ofstream out(new_path, ios::binary | ios::trunc);
+
+            out.write(records, no_of_records * m_record_size);
+
+            if (!out.flush())
+            {
+                cerr << "Cant write " << new_path << endl;
+                return false;
+            }
+        }
+
+        return add_segment(to_height, no_of_records > 0);
+    }
+
+
+    bool
+    SidecarIndexBase::map_segment(const uint64_t& h0, const uint64_t& h1)
+    {
+        m_segments.push_back(segment {h0, h1, unique_ptr<MappedFile> {new MappedFile()}});
+
+        string file_path = segment_path(SEGMENT_FILE, h0, h1);
+
+        if (!m_segments.back().file->open(file_path))
+        {
+            return false;
+        }
+
+        if (m_segments.back().file->size() % m_record_size != 0)
+        {
+            cerr << "Sidecar index segment " << file_path
+                 << " has partial record" << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Merge all segments into one. Of records with equal keys,
+     * ones from earlier segments go first, so they stay in height order.
+     */
+    bool
+    SidecarIndexBase::merge_segments(const uint64_t& h0, const uint64_t& h1) const
+    {
+        string merged_path = segment_path(SEGMENT_FILE, h0, h1);
+
+        vector<size_t> positions(m_segments.size(), 0);
+
+        ofstream out(merged_path, ios::binary | ios::trunc);
+
+        while (true)
+        {
+            const char* min_record {nullptr};
+            size_t min_seg {0};
+
+            for (size_t i = 0; i < m_segments.size(); ++i)
+            {
+                if (positions[i] >= m_segments[i].file->size())
+                {
+                    continue;
+                }
+
+                const char* record = m_segments[i].file->data() + positions[i];
+
+                if (min_record == nullptr || memcmp(record, min_record, m_key_size) < 0)
+                {
+                    min_record = record;
+                    min_seg    = i;
+                }
+            }
+
+            if (min_record == nullptr)
+            {
+                break;
+            }
+
+            out.write(min_record, m_record_size);
+
+            positions[min_seg] += m_record_size;
+        }
+
+        if (!out.flush())
+        {
+            cerr << "Cant write " << merged_path << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+}
@@ -0,0 +1,129 @@
+#ifndef XMREG01_SIDECARINDEX_H
+#define XMREG01_SIDECARINDEX_H
+
+#include "MappedFile.h"
+#include "SegmentedIndex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace std;
+
+    /**
+     * Index of fixed size key, value records found in blocks
+     * of heights [0, height()), looked up by key without reading
+     * the blockchain.
+     *
+     * Each segment is one file of records, sorted by key bytes
+     * and memory mapped for reading. Records of the same key
+     * are in height order.
+     */
+    class SidecarIndexBase : public SegmentedIndex
+    {
+    public:
+
+        SidecarIndexBase(size_t key_size, size_t record_size);
+
+        uint64_t
+        no_of_records() const;
+
+    protected:
+
+        void
+        for_each_match(const void* key,
+                       const std::function<void(const char* record)>& f) const;
+
+        void
+        for_each_record(const std::function<void(const char* record)>& f) const;
+
+        // records of blocks [height(), to_height), sorted by key
+        bool
+        append_sorted(uint64_t to_height, const char* records, size_t no_of_records);
+
+    private:
+
+        struct segment
+        {
+            uint64_t h0;
+            uint64_t h1;
+
+            unique_ptr<MappedFile> file;
+        };
+
+        bool
+        map_segment(const uint64_t& h0, const uint64_t& h1) override;
+
+        void
+        unmap_segments() override { m_segments.clear(); }
+
+        bool
+        merge_segments(const uint64_t& h0, const uint64_t& h1) const override;
+
+        vector<segment> m_segments;
+    };
+
+
+    /**
+     * Typed SidecarIndexBase. Key and Value must be
+     * plain structs without pointers, e.g., of crypto types.
+     */
+    template <typename Key, typename Value>
+    class SidecarIndex : public SidecarIndexBase
+    {
+    public:
+
+        struct record
+        {
+            Key key;
+            Value value;
+        };
+
+        static_assert(std::is_pod<record>::value,
+                      "sidecar index records are written as they are in memory");
+
+        SidecarIndex() : SidecarIndexBase(sizeof(Key), sizeof(record)) {}
+
+        void
+        find(const Key& key, vector<Value>& values) const
+        {
+            for_each_match(&key, [&](const char* rec)
+            {
+                values.push_back(reinterpret_cast<const record*>(rec)->value);
+            });
+        }
+
+        void
+        for_each(const std::function<void(const record&)>& f) const
+        {
+            for_each_record([&](const char* rec)
+            {
+                f(*reinterpret_cast<const record*>(rec));
+            });
+        }
+
+        // records are sorted here, keeping their order for equal keys
+        bool
+        append(uint64_t to_height, vector<record>& records)
+        {
+            std::stable_sort(records.begin(), records.end(),
+                             [](const record& a, const record& b)
+                             {
+                                 return memcmp(&a.key, &b.key, sizeof(Key)) < 0;
+                             });
+
+            return append_sorted(to_height,
+                                 reinterpret_cast<const char*>(records.data()),
+                                 records.size());
+        }
+    };
+
+}
+
+#endif //XMREG01_SIDECARINDEX_H
@@ -0,0 +1,626 @@
+#include "SyntheticChain.h"
+#include "tools.h"
+
+#include <algorithm>
+#include <random>
+
+namespace xmreg
+{
+
+namespace
+{
+    // amounts of non-coinbase outputs
+    const uint64_t DENOMINATIONS[] {10000000000ull,
+                                    100000000000ull,
+                                    1000000000000ull};
+
+    const uint64_t COINBASE_AMOUNT {10000000000000ull};
+
+    // outputs are not spent before this many blocks
+    const uint64_t SPENDABLE_AGE {10};
+
+    const uint64_t START_TIMESTAMP {1397818193}; // around monero's genesis
+
+
+    /**
+     * Check that blob parsers used by scans read tx, which has
+     * ring signatures, as cryptonote's parser does. Coinbase txs
+     * have no signatures, so they alone do not show it.
+     */
+    bool
+    check_tx_parsers(const transaction& tx)
+    {
+        blobdata tx_blob = tx_to_blob(tx);
+
+        blob_view view {tx_blob.data(), tx_blob.size()};
+
+        transaction_prefix prefix;
+        transaction parsed_tx;
+
+        if (!parse_tx_prefix_from_view(view, prefix)
+            || get_transaction_prefix_hash(prefix) != get_transaction_prefix_hash(tx))
+        {
+            cerr << "Tx prefix parsed from blob differs from the tx" << endl;
+            return false;
+        }
+
+        if (!parse_tx_from_view(view, parsed_tx)
+            || get_transaction_hash(parsed_tx) != get_transaction_hash(tx))
+        {
+            cerr << "Tx parsed from blob differs from the tx" << endl;
+            return false;
+        }
+
+        return true;
+    }
+
+
+    /**
+     * Builds the chain block by block, keeping track of all
+     * outputs and their secret keys so they can be spent later.
+     */
+    class SyntheticChainGenerator
+    {
+        struct gen_output
+        {
+            uint64_t amount;
+            uint64_t amount_index;
+            public_key pub;
+            secret_key sec;
+            uint64_t height;
+            bool spent;
+
+            // index in synthetic_chain::wallet_outputs, or -1
+            int64_t wallet_output;
+        };
+
+        const synthetic_chain_config& m_cfg;
+        MemoryBlockchainDB& m_db;
+        synthetic_chain& m_chain;
+
+        std::mt19937_64 m_rng;
+
+        vector<gen_output> m_outputs;
+
+        // indices in m_outputs, by amount and amount index
+        unordered_map<uint64_t, vector<size_t>> m_amount_outputs;
+
+        // outputs in m_outputs older than SPENDABLE_AGE
+        size_t m_no_spendable {0};
+
+        // m_outputs.size() after each block
+        vector<size_t> m_block_outputs_end;
+
+        vector<size_t> m_wallet_unspent;
+
+        uint64_t m_coins_generated {0};
+
+    public:
+        SyntheticChainGenerator(const synthetic_chain_config& cfg,
+                                MemoryBlockchainDB& db,
+                                synthetic_chain& chain)
+                : m_cfg {cfg}, m_db {db}, m_chain {chain}, m_rng {cfg.seed}
+        {}
+
+        bool
+        generate();
+
+    private:
+
+        // values are made from m_rng output directly, as output of
+        // std distributions differs between standard libraries, and
+        // the same seed must give the same chain everywhere.
+
+        // in [0, 1), from top 53 bits
+        double
+        random_fraction()
+        {
+            return static_cast<double>(m_rng() >> 11) * (1.0 / 9007199254740992.0);
+        }
+
+        // modulo bias is negligible for max much smaller than 2^64
+        uint64_t
+        random_below(uint64_t max)
+        {
+            return m_rng() % max;
+        }
+
+        secret_key
+        random_secret_key()
+        {
+            unsigned char tmp[64];
+
+            for (size_t i = 0; i < 8; ++i)
+            {
+                uint64_t r = m_rng();
+                memcpy(tmp + 8 * i, &r, 8);
+            }
+
+            sc_reduce(tmp);
+
+            secret_key sec;
+            memcpy(&sec, tmp, 32);
+
+            return sec;
+        }
+
+        keypair
+        random_keypair()
+        {
+            keypair kp;
+
+            kp.sec = random_secret_key();
+            secret_key_to_public_key(kp.sec, kp.pub);
+
+            return kp;
+        }
+
+        bool
+        pick_real_output(size_t& out_i);
+
+        bool
+        make_ring(size_t real_i,
+                  vector<uint64_t>& ring,
+                  size_t& real_pos);
+
+        bool
+        make_tx(uint64_t height, transaction& tx, crypto::hash& tx_hash);
+
+        transaction
+        make_miner_tx(uint64_t height);
+
+        void
+        add_outputs(const transaction& tx,
+                    const crypto::hash& tx_hash,
+                    uint64_t height,
+                    const keypair& tx_key,
+                    const vector<secret_key>& out_secs,
+                    bool pays_wallet);
+    };
+
+
+    bool
+    SyntheticChainGenerator::generate()
+    {
+        account_keys& wallet = m_chain.wallet;
+
+        keypair spend_keys = random_keypair();
+        keypair view_keys  = random_keypair();
+
+        wallet.m_account_address.m_spend_public_key = spend_keys.pub;
+        wallet.m_account_address.m_view_public_key  = view_keys.pub;
+        wallet.m_spend_secret_key = spend_keys.sec;
+        wallet.m_view_secret_key  = view_keys.sec;
+
+        m_chain.wallet_outputs.clear();
+
+        crypto::hash prev_id = null_hash;
+
+        vector<transaction> txs;
+
+        for (uint64_t height = 0; height < m_cfg.no_of_blocks; ++height)
+        {
+            // outputs old enough to be spent in this block
+            if (height >= SPENDABLE_AGE)
+            {
+                m_no_spendable = m_block_outputs_end[height - SPENDABLE_AGE];
+            }
+
+            block blk;
+
+            blk.major_version = 1;
+            blk.minor_version = 0;
+            blk.timestamp     = START_TIMESTAMP + height * DIFFICULTY_TARGET;
+            blk.prev_id       = prev_id;
+            blk.nonce         = 0;
+            blk.miner_tx      = make_miner_tx(height);
+
+            txs.clear();
+
+            size_t block_size = get_object_blobsize(blk.miner_tx);
+
+            for (size_t i = 0; i < m_cfg.txs_per_block; ++i)
+            {
+                transaction tx;
+                crypto::hash tx_hash;
+
+                // early blocks dont have enough outputs to spend
+                if (!make_tx(height, tx, tx_hash))
+                {
+                    break;
+                }
+
+                txs.push_back(tx);
+                blk.tx_hashes.push_back(tx_hash);
+
+                block_size += get_object_blobsize(tx);
+            }
+
+            // first tx of each block is enough
+            if (!txs.empty() && !check_tx_parsers(txs.front()))
+            {
+                return false;
+            }
+
+            m_coins_generated += COINBASE_AMOUNT;
+
+            try
+            {
+                m_db.add_block(blk, block_size, height + 1, m_coins_generated, txs);
+            }
+            catch (const std::exception& e)
+            {
+                cerr << "Cant add synthetic block " << height << ": " << e.what() << endl;
+                return false;
+            }
+
+            m_block_outputs_end.push_back(m_outputs.size());
+
+            prev_id = get_block_hash(blk);
+        }
+
+        return true;
+    }
+
+
+    transaction
+    SyntheticChainGenerator::make_miner_tx(uint64_t height)
+    {
+        transaction tx;
+
+        tx.version     = 1;
+        tx.unlock_time = height + CRYPTONOTE_MINED_MONEY_UNLOCK_WINDOW;
+
+        txin_gen in;
+        in.height = height;
+
+        tx.vin.push_back(in);
+
+        keypair tx_key = random_keypair();
+
+        add_tx_pub_key_to_extra(tx, tx_key.pub);
+
+        keypair out_key = random_keypair();
+
+        tx_out out;
+        out.amount = COINBASE_AMOUNT;
+        out.target = txout_to_key {out_key.pub};
+
+        tx.vout.push_back(out);
+
+        m_amount_outputs[COINBASE_AMOUNT].push_back(m_outputs.size());
+
+        m_outputs.push_back(gen_output {COINBASE_AMOUNT,
+                                        m_amount_outputs[COINBASE_AMOUNT].size() - 1,
+                                        out_key.pub, out_key.sec,
+                                        height, false, -1});
+
+        return tx;
+    }
+
+
+    /**
+     * Pick unspent, spendable output to be the real
+     * one in a ring. Test wallet's outputs are picked
+     * with wallet_spend_ratio chance.
+     */
+    bool
+    SyntheticChainGenerator::pick_real_output(size_t& out_i)
+    {
+        if (!m_wallet_unspent.empty() && random_fraction() < m_cfg.wallet_spend_ratio)
+        {
+            size_t w = random_below(m_wallet_unspent.size());
+
+            if (m_outputs[m_wallet_unspent[w]].height + SPENDABLE_AGE
+                <= m_db.height())
+            {
+                out_i = m_wallet_unspent[w];
+                m_wallet_unspent.erase(m_wallet_unspent.begin() + w);
+                return true;
+            }
+        }
+
+        if (m_no_spendable == 0)
+        {
+            return false;
+        }
+
+        // most outputs are unspent, so few tries are enough
+        for (size_t attempt = 0; attempt < 32; ++attempt)
+        {
+            size_t i = random_below(m_no_spendable);
+
+            if (!m_outputs[i].spent && m_outputs[i].wallet_output < 0)
+            {
+                out_i = i;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    /**
+     * Make sorted ring of amount indices with the real output
+     * and random decoys of the same amount.
+     */
+    bool
+    SyntheticChainGenerator::make_ring(size_t real_i,
+                                       vector<uint64_t>& ring,
+                                       size_t& real_pos)
+    {
+        const gen_output& real_out = m_outputs[real_i];
+
+        const vector<size_t>& amount_outputs = m_amount_outputs[real_out.amount];
+
+        // amount indices of spendable outputs of this amount
+        uint64_t no_of_candidates {0};
+
+        while (no_of_candidates < amount_outputs.size()
+               && amount_outputs[no_of_candidates] < m_no_spendable)
+        {
+            ++no_of_candidates;
+        }
+
+        no_of_candidates = std::max(no_of_candidates, real_out.amount_index + 1);
+
+        size_t ring_size = std::min<size_t>(m_cfg.ring_size, no_of_candidates);
+
+        ring.assign(1, real_out.amount_index);
+
+        while (ring.size() < ring_size)
+        {
+            uint64_t decoy = random_below(no_of_candidates);
+
+            if (std::find(ring.begin(), ring.end(), decoy) == ring.end())
+            {
+                ring.push_back(decoy);
+            }
+        }
+
+        std::sort(ring.begin(), ring.end());
+
+        real_pos = std::find(ring.begin(), ring.end(), real_out.amount_index)
+                   - ring.begin();
+
+        return true;
+    }
+
+
+    bool
+    SyntheticChainGenerator::make_tx(uint64_t height,
+                                     transaction& tx,
+                                     crypto::hash& tx_hash)
+    {
+        tx.version     = 1;
+        tx.unlock_time = 0;
+
+        keypair tx_key = random_keypair();
+
+        add_tx_pub_key_to_extra(tx, tx_key.pub);
+
+        // for signing: ring keys, real position and secret key of each input
+        vector<vector<const public_key*>> rings_keys;
+        vector<size_t> real_positions;
+        vector<size_t> real_outputs;
+
+        for (size_t i = 0; i < m_cfg.inputs_per_tx; ++i)
+        {
+            size_t real_i;
+
+            if (!pick_real_output(real_i))
+            {
+                break;
+            }
+
+            gen_output& real_out = m_outputs[real_i];
+
+            real_out.spent = true;
+
+            vector<uint64_t> ring;
+            size_t real_pos;
+
+            make_ring(real_i, ring, real_pos);
+
+            txin_to_key in;
+
+            in.amount = real_out.amount;
+            in.key_offsets = absolute_output_offsets_to_relative(ring);
+
+            generate_key_image(real_out.pub, real_out.sec, in.k_image);
+
+            tx.vin.push_back(in);
+
+            rings_keys.emplace_back();
+
+            for (const uint64_t& amount_index: ring)
+            {
+                const size_t& out_i = m_amount_outputs[real_out.amount][amount_index];
+                rings_keys.back().push_back(&m_outputs[out_i].pub);
+            }
+
+            real_positions.push_back(real_pos);
+            real_outputs.push_back(real_i);
+        }
+
+        if (tx.vin.empty())
+        {
+            return false;
+        }
+
+        bool pays_wallet = random_fraction() < m_cfg.wallet_receive_ratio;
+
+        crypto::key_derivation derivation;
+
+        generate_key_derivation(m_chain.wallet.m_account_address.m_view_public_key,
+                                tx_key.sec, derivation);
+
+        // secret keys of outputs not to the test wallet,
+        // so that they can be spent later
+        vector<secret_key> out_secs(m_cfg.outputs_per_tx);
+
+        for (size_t i = 0; i < m_cfg.outputs_per_tx; ++i)
+        {
+            tx_out out;
+
+            out.amount = DENOMINATIONS[random_below(3)];
+
+            public_key out_pub;
+
+            if (pays_wallet && i == 0)
+            {
+                derive_public_key(derivation, i,
+                                  m_chain.wallet.m_account_address.m_spend_public_key,
+                                  out_pub);
+            }
+            else
+            {
+                keypair out_key = random_keypair();
+
+                out_pub     = out_key.pub;
+                out_secs[i] = out_key.sec;
+            }
+
+            out.target = txout_to_key {out_pub};
+
+            tx.vout.push_back(out);
+        }
+
+        crypto::hash prefix_hash = get_transaction_prefix_hash(tx);
+
+        for (size_t i = 0; i < tx.vin.size(); ++i)
+        {
+            tx.signatures.emplace_back(rings_keys[i].size());
+
+            vector<signature>& sigs = tx.signatures.back();
+
+            if (m_cfg.valid_signatures)
+            {
+                const txin_to_key& in = boost::get<txin_to_key>(tx.vin[i]);
+
+                generate_ring_signature(prefix_hash, in.k_image,
+                                        rings_keys[i],
+                                        m_outputs[real_outputs[i]].sec,
+                                        real_positions[i],
+                                        sigs.data());
+            }
+            else
+            {
+                for (signature& sig: sigs)
+                {
+                    secret_key c = random_secret_key();
+                    secret_key r = random_secret_key();
+
+                    memcpy(&sig.c, &c, sizeof(sig.c));
+                    memcpy(&sig.r, &r, sizeof(sig.r));
+                }
+            }
+        }
+
+        tx_hash = get_transaction_hash(tx);
+
+        // mark test wallet's outputs spent in this tx
+        for (const size_t& real_i: real_outputs)
+        {
+            const gen_output& real_out = m_outputs[real_i];
+
+            if (real_out.wallet_output >= 0)
+            {
+                synthetic_output& wallet_out = m_chain.wallet_outputs[real_out.wallet_output];
+
+                wallet_out.spent            = true;
+                wallet_out.spending_tx_hash = tx_hash;
+                wallet_out.spending_height  = height;
+            }
+        }
+
+        add_outputs(tx, tx_hash, height, tx_key, out_secs, pays_wallet);
+
+        return true;
+    }
+
+
+    void
+    SyntheticChainGenerator::add_outputs(const transaction& tx,
+                                         const crypto::hash& tx_hash,
+                                         uint64_t height,
+                                         const keypair& tx_key,
+                                         const vector<secret_key>& out_secs,
+                                         bool pays_wallet)
+    {
+        const account_keys& wallet = m_chain.wallet;
+
+        for (size_t i = 0; i < tx.vout.size(); ++i)
+        {
+            const tx_out& out = tx.vout[i];
+
+            const public_key& out_pub = boost::get<txout_to_key>(out.target).key;
+
+            vector<size_t>& amount_outputs = m_amount_outputs[out.amount];
+
+            gen_output gen_out {out.amount, amount_outputs.size(),
+                                out_pub, out_secs[i],
+                                height, false, -1};
+
+            if (pays_wallet && i == 0)
+            {
+                // the wallet's side of it: derivation from tx public key
+                // and private view key, as wallets do
+                crypto::key_derivation derivation;
+
+                generate_key_derivation(tx_key.pub, wallet.m_view_secret_key, derivation);
+
+                derive_secret_key(derivation, i, wallet.m_spend_secret_key, gen_out.sec);
+
+                synthetic_output wallet_out;
+
+                wallet_out.tx_hash     = tx_hash;
+                wallet_out.height      = height;
+                wallet_out.index_in_tx = i;
+                wallet_out.amount      = out.amount;
+                wallet_out.pubkey      = out_pub;
+
+                xmreg::generate_key_image(derivation, i,
+                                          wallet.m_spend_secret_key,
+                                          wallet.m_account_address.m_spend_public_key,
+                                          wallet_out.k_image);
+
+                gen_out.wallet_output = m_chain.wallet_outputs.size();
+
+                m_chain.wallet_outputs.push_back(wallet_out);
+
+                m_wallet_unspent.push_back(m_outputs.size());
+            }
+
+            amount_outputs.push_back(m_outputs.size());
+            m_outputs.push_back(gen_out);
+        }
+    }
+
+} // namespace
+
+
+    /**
+     * Fill db with synthetic blockchain, deterministic for
+     * given cfg, and return the test wallet and its outputs.
+     *
+     * db should be empty.
+     */
+    bool
+    generate_synthetic_chain(const synthetic_chain_config& cfg,
+                             MemoryBlockchainDB& db,
+                             synthetic_chain& chain)
+    {
+        if (db.height() != 0)
+        {
+            cerr << "Synthetic chain can only be generated into an empty db" << endl;
+            return false;
+        }
+
+        SyntheticChainGenerator generator {cfg, db, chain};
+
+        return generator.generate();
+    }
+
+}
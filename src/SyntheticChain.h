@@ -0,0 +1,80 @@
+#ifndef XMREG01_SYNTHETICCHAIN_H
+#define XMREG01_SYNTHETICCHAIN_H
+
+#include "monero_headers.h"
+#include "MemoryBlockchainDB.h"
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    /**
+     * Shape of a synthetic blockchain.
+     *
+     * The same config, including seed, gives the same chain.
+     */
+    struct synthetic_chain_config
+    {
+        uint64_t no_of_blocks {1000};
+
+        size_t txs_per_block {10};
+        size_t inputs_per_tx {2};
+        size_t outputs_per_tx {2};
+
+        // number of outputs in each input's ring, i.e., mixin + 1
+        size_t ring_size {3};
+
+        // fraction of txs with an output to the test wallet
+        double wallet_receive_ratio {0.05};
+
+        // chance that an input spends one of the test wallet's
+        // outputs, if it has any unspent
+        double wallet_spend_ratio {0.2};
+
+        uint64_t seed {1};
+
+        // generate real ring signatures. these are much slower to
+        // make and use random nonces, so tx hashes are different
+        // between runs. otherwise signatures are just random bytes.
+        bool valid_signatures {false};
+    };
+
+
+    /**
+     * Output received by the test wallet, with its
+     * key image and spending tx, if it was spent.
+     */
+    struct synthetic_output
+    {
+        crypto::hash tx_hash;
+        uint64_t height {0};
+        size_t index_in_tx {0};
+        uint64_t amount {0};
+
+        public_key pubkey;
+        key_image k_image;
+
+        bool spent {false};
+        crypto::hash spending_tx_hash;
+        uint64_t spending_height {0};
+    };
+
+
+    struct synthetic_chain
+    {
+        account_keys wallet;
+
+        vector<synthetic_output> wallet_outputs;
+    };
+
+
+    bool
+    generate_synthetic_chain(const synthetic_chain_config& cfg,
+                             MemoryBlockchainDB& db,
+                             synthetic_chain& chain);
+
+}
+
+#endif //XMREG01_SYNTHETICCHAIN_H
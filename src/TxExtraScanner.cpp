@@ -0,0 +1,216 @@
+#include "TxExtraScanner.h"
+#include "tools.h"
+
+#include <cstring>
+
+namespace xmreg
+{
+
+namespace
+{
+    // first byte of extra nonce with 8 byte encrypted payment id
+    const uint8_t ENCRYPTED_PAYMENT_ID_NONCE {0x01};
+
+
+    // string of binary_archive: varint size and its bytes
+    bool
+    read_string(const uint8_t*& pos, const uint8_t* end,
+                const uint8_t*& data, size_t& size)
+    {
+        uint64_t str_size;
+
+        if (!read_varint(pos, end, str_size)
+            || str_size > static_cast<uint64_t>(end - pos))
+        {
+            return false;
+        }
+
+        data = pos;
+        size = str_size;
+
+        pos += str_size;
+
+        return true;
+    }
+
+
+    // tx_extra_padding: only zeros till the end,
+    // TX_EXTRA_PADDING_MAX_COUNT bytes at most with its tag
+    bool
+    read_padding(const uint8_t*& pos, const uint8_t* end)
+    {
+        size_t size;
+
+        for (size = 1; size <= TX_EXTRA_PADDING_MAX_COUNT; ++size)
+        {
+            if (pos == end)
+            {
+                break;
+            }
+
+            if (*pos++ != 0)
+            {
+                return false;
+            }
+        }
+
+        return size <= TX_EXTRA_PADDING_MAX_COUNT;
+    }
+
+
+    // tx_extra_merge_mining_tag: string holding varint depth
+    // and merkle root, and nothing else, as its parser requires
+    bool
+    read_merge_mining_tag(const uint8_t*& pos, const uint8_t* end)
+    {
+        const uint8_t* field;
+        size_t field_size;
+
+        if (!read_string(pos, end, field, field_size))
+        {
+            return false;
+        }
+
+        const uint8_t* field_end = field + field_size;
+
+        uint64_t depth;
+
+        return read_varint(field, field_end, depth)
+               && static_cast<size_t>(field_end - field) == sizeof(crypto::hash);
+    }
+}
+
+
+    bool
+    scan_tx_extra(const uint8_t* extra, size_t extra_size, tx_extra_view& view)
+    {
+        view.tx_pub_key = nullptr;
+        view.nonce      = nullptr;
+        view.nonce_size = 0;
+
+        const uint8_t* pos = extra;
+        const uint8_t* end = extra + extra_size;
+
+        while (pos < end)
+        {
+            uint8_t tag = *pos++;
+
+            switch (tag)
+            {
+                case TX_EXTRA_TAG_PADDING:
+                {
+                    if (!read_padding(pos, end))
+                    {
+                        return false;
+                    }
+
+                    break;
+                }
+                case TX_EXTRA_TAG_PUBKEY:
+                {
+                    if (static_cast<size_t>(end - pos) < sizeof(public_key))
+                    {
+                        return false;
+                    }
+
+                    if (view.tx_pub_key == nullptr)
+                    {
+                        view.tx_pub_key = reinterpret_cast<const public_key*>(pos);
+                    }
+
+                    pos += sizeof(public_key);
+
+                    break;
+                }
+                case TX_EXTRA_NONCE:
+                {
+                    const uint8_t* nonce;
+                    size_t nonce_size;
+
+                    if (!read_string(pos, end, nonce, nonce_size)
+                        || nonce_size > TX_EXTRA_NONCE_MAX_COUNT)
+                    {
+                        return false;
+                    }
+
+                    if (view.nonce == nullptr)
+                    {
+                        view.nonce      = nonce;
+                        view.nonce_size = nonce_size;
+                    }
+
+                    break;
+                }
+                case TX_EXTRA_MERGE_MINING_TAG:
+                {
+                    if (!read_merge_mining_tag(pos, end))
+                    {
+                        return false;
+                    }
+
+                    break;
+                }
+                case TX_EXTRA_MYSTERIOUS_MINERGATE_TAG:
+                {
+                    const uint8_t* data;
+                    size_t data_size;
+
+                    if (!read_string(pos, end, data, data_size))
+                    {
+                        return false;
+                    }
+
+                    break;
+                }
+                default:
+                    // variant tag parse_tx_extra does not know
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+
+    public_key
+    scan_tx_pub_key(const vector<uint8_t>& extra)
+    {
+        tx_extra_view view;
+
+        // key before a malformed field is still used
+        scan_tx_extra(extra.data(), extra.size(), view);
+
+        return view.tx_pub_key != nullptr ? *view.tx_pub_key : null_pkey;
+    }
+
+
+    bool
+    get_payment_id(const tx_extra_view& view, crypto::hash& payment_id)
+    {
+        if (view.nonce_size != sizeof(crypto::hash) + 1
+            || view.nonce[0] != TX_EXTRA_NONCE_PAYMENT_ID)
+        {
+            return false;
+        }
+
+        memcpy(&payment_id, view.nonce + 1, sizeof(crypto::hash));
+
+        return true;
+    }
+
+
+    bool
+    get_encrypted_payment_id(const tx_extra_view& view, short_payment_id& payment_id)
+    {
+        if (view.nonce_size != sizeof(short_payment_id) + 1
+            || view.nonce[0] != ENCRYPTED_PAYMENT_ID_NONCE)
+        {
+            return false;
+        }
+
+        memcpy(payment_id.data, view.nonce + 1, sizeof(short_payment_id));
+
+        return true;
+    }
+
+}
@@ -0,0 +1,66 @@
+#ifndef XMREG01_TXEXTRASCANNER_H
+#define XMREG01_TXEXTRASCANNER_H
+
+#include "monero_headers.h"
+
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    /**
+     * 8 byte payment id, which txs have encrypted
+     * with the key derivation of their receiver.
+     */
+    struct short_payment_id
+    {
+        unsigned char data[8];
+    };
+
+
+    /**
+     * Fields of tx extra, as found by scan_tx_extra. The first
+     * field of each type is kept, the same one find_tx_extra_field_by_type
+     * gives. Pointers point into the scanned extra bytes, or are
+     * nullptr if there is no such field.
+     */
+    struct tx_extra_view
+    {
+        const public_key* tx_pub_key;
+
+        const uint8_t* nonce;
+        size_t nonce_size;
+    };
+
+
+    /**
+     * Go over fields of tx extra without allocating
+     * or copying anything, as parse_tx_extra would do.
+     *
+     * Malformed extras are handled the same way: scan stops at the
+     * first field which parse_tx_extra can not parse and returns
+     * false, with fields before it still in view.
+     */
+    bool
+    scan_tx_extra(const uint8_t* extra, size_t extra_size, tx_extra_view& view);
+
+    /**
+     * Same result as get_tx_pub_key_from_extra,
+     * i.e., null_pkey if there is no tx public key.
+     */
+    public_key
+    scan_tx_pub_key(const vector<uint8_t>& extra);
+
+    // from nonce, as get_payment_id_from_tx_extra_nonce
+    bool
+    get_payment_id(const tx_extra_view& view, crypto::hash& payment_id);
+
+    bool
+    get_encrypted_payment_id(const tx_extra_view& view, short_payment_id& payment_id);
+
+}
+
+#endif //XMREG01_TXEXTRASCANNER_H
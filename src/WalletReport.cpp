@@ -0,0 +1,484 @@
+#include "WalletReport.h"
+#include "SearchCoordinator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace xmreg
+{
+
+namespace
+{
+    // average number of blocks scanned by a thread at a time
+    const uint64_t SCAN_CHUNK {1000};
+
+    // rows passed between stages at a time
+    const size_t ROW_BATCH {64};
+
+    // batches each queue can hold
+    const size_t QUEUE_CAPACITY {64};
+}
+
+
+    WalletReport::WalletReport(MicroCore& mcore,
+                               const account_keys& keys,
+                               bool find_spending_txs,
+                               bool show_progress,
+                               const ScanSidecar* sidecar)
+            : m_mcore {mcore},
+              m_keys {keys},
+              m_find_spending_txs {find_spending_txs},
+              m_show_progress {show_progress},
+              m_sidecar {sidecar}
+    {}
+
+
+    bool
+    WalletReport::run(uint64_t h0, uint64_t h1, vector<report_row>& rows)
+    {
+        BoundedQueue<row_batch> found_outputs  {QUEUE_CAPACITY};
+        BoundedQueue<row_batch> key_images     {QUEUE_CAPACITY};
+        BoundedQueue<row_batch> checked        {QUEUE_CAPACITY};
+        BoundedQueue<row_batch> spending_found {QUEUE_CAPACITY};
+
+        bool scanned_ok {false};
+        bool spent_ok {true};
+        bool found_ok {true};
+
+        const BlockSummary& block_summary = m_mcore.get_block_summary();
+
+        ScanProgress progress {block_summary, h0, h1, "scanned blocks", m_show_progress};
+
+        // ownership scan is done by threads of mcore's executor,
+        // while the other stages take outputs it found
+        thread scan_stage {[&]()
+        {
+            scanned_ok = m_mcore.get_executor().run(
+                    block_summary, h0, h1, SCAN_CHUNK,
+                    [&](size_t worker_i, uint64_t range_h0, uint64_t range_h1) -> bool
+                    {
+                        // blocks the sidecar has, and the rest
+                        uint64_t sidecar_h1 = m_sidecar != nullptr
+                                              ? std::min(range_h1, m_sidecar->height())
+                                              : range_h0;
+
+                        if (range_h0 < sidecar_h1)
+                        {
+                            scan_sidecar(range_h0, sidecar_h1, found_outputs);
+                        }
+
+                        if (!scan_blocks(std::max(range_h0, sidecar_h1), range_h1,
+                                         found_outputs))
+                        {
+                            return false;
+                        }
+
+                        progress.done(range_h0, range_h1);
+
+                        return true;
+                    });
+
+            progress.finish();
+
+            found_outputs.close();
+        }};
+
+        thread key_image_stage {&WalletReport::generate_key_images, this,
+                                std::ref(found_outputs), std::ref(key_images)};
+
+        thread spent_stage {&WalletReport::check_spent, this,
+                            std::ref(key_images), std::ref(checked),
+                            std::ref(spent_ok)};
+
+        thread spending_stage;
+
+        if (m_find_spending_txs)
+        {
+            spending_stage = thread {&WalletReport::find_spending_txs, this,
+                                     std::ref(checked), std::ref(spending_found),
+                                     std::ref(found_ok)};
+        }
+
+        BoundedQueue<row_batch>& last_stage = m_find_spending_txs
+                                              ? spending_found : checked;
+
+        row_batch batch;
+
+        while (last_stage.pop(batch))
+        {
+            rows.insert(rows.end(), batch.begin(), batch.end());
+        }
+
+        scan_stage.join();
+        key_image_stage.join();
+        spent_stage.join();
+
+        if (spending_stage.joinable())
+        {
+            spending_stage.join();
+        }
+
+        std::sort(rows.begin(), rows.end(),
+                  [](const report_row& a, const report_row& b)
+                  {
+                      if (a.output.height != b.output.height)
+                      {
+                          return a.output.height < b.output.height;
+                      }
+
+                      int cmp = memcmp(&a.output.tx_hash, &b.output.tx_hash,
+                                       sizeof(crypto::hash));
+
+                      if (cmp != 0)
+                      {
+                          return cmp < 0;
+                      }
+
+                      return a.output.index_in_tx < b.output.index_in_tx;
+                  });
+
+        return scanned_ok && spent_ok && found_ok;
+    }
+
+
+    /**
+     * Returns false if blocks could not be read, or a tx
+     * could not be parsed, as our outputs could be in it.
+     */
+    bool
+    WalletReport::scan_blocks(uint64_t h0, uint64_t h1, BoundedQueue<row_batch>& out)
+    {
+        const public_key& public_spend_key = m_keys.m_account_address.m_spend_public_key;
+
+        row_batch batch;
+
+        bool parse_failed {false};
+
+        // reused for each tx
+        transaction_prefix tx;
+
+        chain_scan_result scan = m_mcore.for_all_tx_blobs(
+                h0, h1,
+                [&](const uint64_t& height,
+                    const crypto::hash& tx_hash,
+                    const blob_view& tx_blob) -> bool
+                {
+                    if (!parse_tx_prefix_from_view(tx_blob, tx))
+                    {
+                        cerr << "Cant parse tx " << tx_hash << endl;
+                        parse_failed = true;
+                        return false;
+                    }
+
+                    public_key pub_tx_key = scan_tx_pub_key(tx.extra);
+
+                    key_derivation derivation;
+
+                    if (pub_tx_key == null_pkey
+                        || !generate_key_derivation(pub_tx_key, m_keys.m_view_secret_key,
+                                                    derivation))
+                    {
+                        return true;
+                    }
+
+                    for (size_t i = 0; i < tx.vout.size(); ++i)
+                    {
+                        if (tx.vout[i].target.type() != typeid(txout_to_key))
+                        {
+                            continue;
+                        }
+
+                        const public_key& out_key
+                                = boost::get<txout_to_key>(tx.vout[i].target).key;
+
+                        public_key pubkey;
+
+                        derive_public_key(derivation, i, public_spend_key, pubkey);
+
+                        if (out_key != pubkey)
+                        {
+                            continue;
+                        }
+
+                        report_row row;
+
+                        row.output     = owned_output {height, tx_hash, i,
+                                                       tx.vout[i].amount, out_key};
+                        row.derivation = derivation;
+
+                        batch.push_back(row);
+                    }
+
+                    if (batch.size() >= ROW_BATCH)
+                    {
+                        out.push(std::move(batch));
+                        batch.clear();
+                    }
+
+                    return true;
+                });
+
+        if (!batch.empty())
+        {
+            out.push(std::move(batch));
+        }
+
+        return scan.complete && !parse_failed;
+    }
+
+
+    void
+    WalletReport::scan_sidecar(uint64_t h0, uint64_t h1, BoundedQueue<row_batch>& out)
+    {
+        vector<key_derivation> derivations;
+
+        vector<owned_output> outputs = m_mcore.find_our_outputs(
+                *m_sidecar,
+                m_keys.m_view_secret_key,
+                m_keys.m_account_address.m_spend_public_key,
+                h0, h1, &derivations);
+
+        row_batch batch;
+
+        for (size_t i = 0; i < outputs.size(); ++i)
+        {
+            report_row row;
+
+            row.output     = outputs[i];
+            row.derivation = derivations[i];
+
+            batch.push_back(row);
+
+            if (batch.size() >= ROW_BATCH)
+            {
+                out.push(std::move(batch));
+                batch.clear();
+            }
+        }
+
+        if (!batch.empty())
+        {
+            out.push(std::move(batch));
+        }
+    }
+
+
+    void
+    WalletReport::generate_key_images(BoundedQueue<row_batch>& in,
+                                      BoundedQueue<row_batch>& out)
+    {
+        row_batch batch;
+
+        while (in.pop(batch))
+        {
+            for (report_row& row: batch)
+            {
+                if (!generate_key_image(row.derivation,
+                                        row.output.index_in_tx,
+                                        m_keys.m_spend_secret_key,
+                                        m_keys.m_account_address.m_spend_public_key,
+                                        row.k_image))
+                {
+                    cerr << "Cant generate key image for output: "
+                         << row.output.pubkey << endl;
+                }
+            }
+
+            out.push(std::move(batch));
+        }
+
+        out.close();
+    }
+
+
+    /**
+     * Check key images of each batch in one read transaction, in
+     * key order of the spent keys table, so lookups of a batch go
+     * through the same pages. Rows are sorted again at the end
+     * of run(), so their order in a batch does not matter.
+     */
+    void
+    WalletReport::check_spent(BoundedQueue<row_batch>& in,
+                              BoundedQueue<row_batch>& out,
+                              bool& spent_ok)
+    {
+        ChainReader::ReadTxn txn;
+
+        row_batch batch;
+
+        while (in.pop(batch))
+        {
+            std::sort(batch.begin(), batch.end(),
+                      [](const report_row& a, const report_row& b)
+                      {
+                          return memcmp(&a.k_image, &b.k_image, sizeof(key_image)) < 0;
+                      });
+
+            // rows whose key image could not be read stay unspent
+            if (!m_mcore.get_reader().begin_read(txn))
+            {
+                spent_ok = false;
+            }
+
+            for (size_t i = 0; i < batch.size() && txn.is_open(); ++i)
+            {
+                if (!txn.is_spent(batch[i].k_image, batch[i].spent))
+                {
+                    spent_ok = false;
+                }
+            }
+
+            // dont keep the snapshot while waiting for the next batch
+            txn.close();
+
+            out.push(std::move(batch));
+        }
+
+        out.close();
+    }
+
+
+    /**
+     * Find txs spending our spent outputs, with one search over all
+     * txs shared by key images of all batches. A batch is held
+     * until its key images are answered, and then passed on.
+     */
+    void
+    WalletReport::find_spending_txs(BoundedQueue<row_batch>& in,
+                                    BoundedQueue<row_batch>& out,
+                                    bool& found_ok)
+    {
+        struct pending_batch
+        {
+            row_batch rows;
+
+            // key images not answered yet
+            atomic<size_t> left {0};
+        };
+
+        SearchCoordinator search {m_mcore.get_reader()};
+
+        atomic<bool> all_found_ok {true};
+
+        // batches waiting for their key images
+        mutex pending_mutex;
+        condition_variable pending_cv;
+        size_t no_of_pending {0};
+
+        row_batch batch;
+
+        vector<key_image> spent_key_images;
+
+        while (in.pop(batch))
+        {
+            spent_key_images.clear();
+
+            for (const report_row& row: batch)
+            {
+                if (row.spent)
+                {
+                    spent_key_images.push_back(row.k_image);
+                }
+            }
+
+            if (spent_key_images.empty())
+            {
+                out.push(std::move(batch));
+                continue;
+            }
+
+            shared_ptr<pending_batch> pending = make_shared<pending_batch>();
+
+            pending->rows = std::move(batch);
+            pending->left = spent_key_images.size();
+
+            {
+                lock_guard<mutex> lock {pending_mutex};
+                ++no_of_pending;
+            }
+
+            // called from the search's scan thread
+            search.search(spent_key_images, [&, pending](const key_image& k_image,
+                                                         const crypto::hash& tx_hash,
+                                                         bool complete)
+            {
+                if (!complete)
+                {
+                    all_found_ok = false;
+                }
+
+                for (report_row& row: pending->rows)
+                {
+                    if (row.spent && row.k_image == k_image && tx_hash != null_hash)
+                    {
+                        row.spending_tx = tx_hash;
+
+                        m_mcore.get_tx_height(tx_hash, row.spent_height);
+                    }
+                }
+
+                if (--pending->left > 0)
+                {
+                    return;
+                }
+
+                out.push(std::move(pending->rows));
+
+                lock_guard<mutex> lock {pending_mutex};
+
+                --no_of_pending;
+
+                pending_cv.notify_all();
+            });
+
+            batch.clear();
+        }
+
+        {
+            unique_lock<mutex> lock {pending_mutex};
+            pending_cv.wait(lock, [&]{ return no_of_pending == 0; });
+        }
+
+        found_ok = all_found_ok;
+
+        out.close();
+    }
+
+
+    void
+    WalletReport::print_csv(const vector<report_row>& rows, ostream& out)
+    {
+        out << "height,tx_hash,output_index,amount,key_image,spent,spent_height,spending_tx\n";
+
+        for (const report_row& row: rows)
+        {
+            out << row.output.height
+                << "," << epee::string_tools::pod_to_hex(row.output.tx_hash)
+                << "," << row.output.index_in_tx
+                << "," << print_money(row.output.amount)
+                << "," << epee::string_tools::pod_to_hex(row.k_image)
+                << "," << (row.spent ? "true" : "false");
+
+            if (row.spending_tx != null_hash)
+            {
+                out << "," << row.spent_height
+                    << "," << epee::string_tools::pod_to_hex(row.spending_tx);
+            }
+            else
+            {
+                out << ",,";
+            }
+
+            out << "\n";
+        }
+
+        out.flush();
+    }
+
+}
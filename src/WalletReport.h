@@ -0,0 +1,108 @@
+#ifndef XMREG01_WALLETREPORT_H
+#define XMREG01_WALLETREPORT_H
+
+#include "MicroCore.h"
+#include "BoundedQueue.h"
+
+#include <iostream>
+#include <vector>
+
+namespace xmreg
+{
+    using namespace cryptonote;
+    using namespace crypto;
+    using namespace std;
+
+    /**
+     * Row of wallet report: one of our outputs
+     * and whether and where it was spent.
+     */
+    struct report_row
+    {
+        owned_output output;
+
+        // derivation found for the output in
+        // the scan, reused for its key image
+        key_derivation derivation;
+
+        key_image k_image;
+
+        bool spent {false};
+
+        // only if spending txs are looked for
+        crypto::hash spending_tx {null_hash};
+        uint64_t spent_height {0};
+    };
+
+
+    /**
+     * Spent status of all outputs of a wallet, made by
+     * stages running at the same time:
+     *
+     *  1. ownership scan of block ranges by threads of the executor,
+     *     using tx public keys and output keys of the scan sidecar,
+     *     if given, for blocks it has,
+     *  2. key image generation for outputs found,
+     *  3. spent check of the key images, a batch at a time in one
+     *     read transaction on the spent keys table,
+     *  4. optionally, search for txs spending the spent ones. Their
+     *     key images join a pass over all txs as they come, so it
+     *     runs together with the ownership scan.
+     *
+     * Stages pass batches of rows through bounded queues.
+     */
+    class WalletReport
+    {
+    public:
+
+        WalletReport(MicroCore& mcore,
+                     const account_keys& keys,
+                     bool find_spending_txs,
+                     bool show_progress = false,
+                     const ScanSidecar* sidecar = nullptr);
+
+        /**
+         * Report on outputs in blocks [h0, h1).
+         * Rows are sorted by height.
+         */
+        bool
+        run(uint64_t h0, uint64_t h1, vector<report_row>& rows);
+
+        static void
+        print_csv(const vector<report_row>& rows, ostream& out);
+
+    private:
+
+        using row_batch = vector<report_row>;
+
+        bool
+        scan_blocks(uint64_t h0, uint64_t h1, BoundedQueue<row_batch>& out);
+
+        void
+        scan_sidecar(uint64_t h0, uint64_t h1, BoundedQueue<row_batch>& out);
+
+        void
+        generate_key_images(BoundedQueue<row_batch>& in, BoundedQueue<row_batch>& out);
+
+        void
+        check_spent(BoundedQueue<row_batch>& in, BoundedQueue<row_batch>& out,
+                    bool& spent_ok);
+
+        void
+        find_spending_txs(BoundedQueue<row_batch>& in, BoundedQueue<row_batch>& out,
+                          bool& found_ok);
+
+        MicroCore& m_mcore;
+
+        account_keys m_keys;
+
+        bool m_find_spending_txs;
+
+        bool m_show_progress;
+
+        const ScanSidecar* m_sidecar;
+    };
+
+}
+
+#endif //XMREG01_WALLETREPORT_H
@@ -0,0 +1,347 @@
+#include "checkoutputs.h"
+
+#include "MicroCore.h"
+#include "SearchCoordinator.h"
+
+#include <cstring>
+#include <memory>
+
+// defined in main.cpp for the executable
+namespace epee {
+    unsigned int g_test_dbg_lock_sleep = 0;
+}
+
+
+struct checkoutputs_handle
+{
+    xmreg::MicroCore mcore;
+
+    std::unique_ptr<xmreg::SearchCoordinator> search;
+
+    // scratch memory reused by calls on the handle
+    cryptonote::transaction_prefix tx;
+    std::vector<crypto::public_key> output_keys;
+    std::vector<size_t> our_indices;
+};
+
+
+namespace
+{
+    using namespace xmreg;
+
+    template <typename T>
+    T
+    from_bytes(const uint8_t* bytes)
+    {
+        T value;
+        memcpy(&value, bytes, sizeof(T));
+        return value;
+    }
+
+
+    template <typename T>
+    void
+    to_bytes(const T& value, uint8_t* bytes)
+    {
+        memcpy(bytes, &value, sizeof(T));
+    }
+
+
+    /**
+     * Read tx prefix into handle's scratch tx,
+     * together with its output keys.
+     */
+    checkoutputs_status
+    read_tx(checkoutputs_handle* handle, const crypto::hash& tx_hash)
+    {
+        ChainReader::ReadTxn txn;
+
+        blob_view tx_blob;
+
+        if (!handle->mcore.get_reader().begin_read(txn))
+        {
+            return CHECKOUTPUTS_ERROR;
+        }
+
+        if (!txn.get_tx_blob(tx_hash, tx_blob))
+        {
+            return CHECKOUTPUTS_NOT_FOUND;
+        }
+
+        if (!parse_tx_prefix_from_view(tx_blob, handle->tx))
+        {
+            return CHECKOUTPUTS_ERROR;
+        }
+
+        handle->output_keys.clear();
+
+        for (const tx_out& out: handle->tx.vout)
+        {
+            handle->output_keys.push_back(out.target.type() == typeid(txout_to_key)
+                                          ? boost::get<txout_to_key>(out.target).key
+                                          : null_pkey);
+        }
+
+        return CHECKOUTPUTS_OK;
+    }
+}
+
+
+checkoutputs_handle*
+checkoutputs_open(const char* blockchain_path)
+{
+    if (!blockchain_path)
+    {
+        return nullptr;
+    }
+
+    try
+    {
+        std::unique_ptr<checkoutputs_handle> handle {new checkoutputs_handle()};
+
+        if (!handle->mcore.init(blockchain_path))
+        {
+            return nullptr;
+        }
+
+        handle->search.reset(new SearchCoordinator(handle->mcore.get_reader()));
+
+        return handle.release();
+    }
+    catch (const std::exception& e)
+    {
+        cerr << e.what() << endl;
+        return nullptr;
+    }
+}
+
+
+void
+checkoutputs_close(checkoutputs_handle* handle)
+{
+    delete handle;
+}
+
+
+checkoutputs_status
+checkoutputs_height(checkoutputs_handle* handle, uint64_t* height)
+{
+    if (!handle || !height)
+    {
+        return CHECKOUTPUTS_INVALID_ARGUMENT;
+    }
+
+    ChainReader::ReadTxn txn;
+
+    if (!handle->mcore.get_reader().begin_read(txn))
+    {
+        return CHECKOUTPUTS_ERROR;
+    }
+
+    *height = txn.height();
+
+    return CHECKOUTPUTS_OK;
+}
+
+
+checkoutputs_status
+checkoutputs_find_our_outputs(checkoutputs_handle* handle,
+                              const uint8_t* tx_hash,
+                              const uint8_t* private_view_key,
+                              const uint8_t* public_spend_key,
+                              checkoutputs_output* outputs,
+                              size_t capacity,
+                              size_t* no_of_outputs)
+{
+    if (!handle || !tx_hash || !private_view_key || !public_spend_key
+        || (!outputs && capacity > 0) || !no_of_outputs)
+    {
+        return CHECKOUTPUTS_INVALID_ARGUMENT;
+    }
+
+    try
+    {
+        crypto::hash hash = from_bytes<crypto::hash>(tx_hash);
+
+        checkoutputs_status st = read_tx(handle, hash);
+
+        if (st != CHECKOUTPUTS_OK)
+        {
+            return st;
+        }
+
+        uint64_t tx_height;
+
+        if (!handle->mcore.get_tx_height(hash, tx_height))
+        {
+            return CHECKOUTPUTS_NOT_FOUND;
+        }
+
+        vector<size_t>& our_indices = handle->our_indices;
+
+        get_belonging_output_indices(scan_tx_pub_key(handle->tx.extra),
+                                     handle->output_keys.data(),
+                                     handle->output_keys.size(),
+                                     from_bytes<secret_key>(private_view_key),
+                                     from_bytes<public_key>(public_spend_key),
+                                     our_indices);
+
+        *no_of_outputs = our_indices.size();
+
+        for (size_t i = 0; i < our_indices.size() && i < capacity; ++i)
+        {
+            size_t output_i = our_indices[i];
+
+            outputs[i].height      = tx_height;
+            outputs[i].index_in_tx = output_i;
+            outputs[i].amount      = handle->tx.vout[output_i].amount;
+
+            to_bytes(handle->output_keys[output_i], outputs[i].pubkey);
+        }
+
+        return our_indices.size() > capacity
+               ? CHECKOUTPUTS_BUFFER_TOO_SMALL : CHECKOUTPUTS_OK;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << e.what() << endl;
+        return CHECKOUTPUTS_ERROR;
+    }
+}
+
+
+checkoutputs_status
+checkoutputs_generate_key_image(checkoutputs_handle* handle,
+                                const uint8_t* tx_hash,
+                                uint64_t output_index,
+                                const uint8_t* private_view_key,
+                                const uint8_t* private_spend_key,
+                                const uint8_t* public_spend_key,
+                                uint8_t* key_image)
+{
+    if (!handle || !tx_hash || !private_view_key || !private_spend_key
+        || !public_spend_key || !key_image)
+    {
+        return CHECKOUTPUTS_INVALID_ARGUMENT;
+    }
+
+    try
+    {
+        checkoutputs_status st = read_tx(handle, from_bytes<crypto::hash>(tx_hash));
+
+        if (st != CHECKOUTPUTS_OK)
+        {
+            return st;
+        }
+
+        if (output_index >= handle->tx.vout.size())
+        {
+            return CHECKOUTPUTS_INVALID_ARGUMENT;
+        }
+
+        key_derivation derivation;
+
+        if (!generate_key_derivation(scan_tx_pub_key(handle->tx.extra),
+                                     from_bytes<secret_key>(private_view_key),
+                                     derivation))
+        {
+            return CHECKOUTPUTS_ERROR;
+        }
+
+        crypto::key_image k_image;
+
+        if (!generate_key_image(derivation, output_index,
+                                from_bytes<secret_key>(private_spend_key),
+                                from_bytes<public_key>(public_spend_key),
+                                k_image))
+        {
+            return CHECKOUTPUTS_ERROR;
+        }
+
+        to_bytes(k_image, key_image);
+
+        return CHECKOUTPUTS_OK;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << e.what() << endl;
+        return CHECKOUTPUTS_ERROR;
+    }
+}
+
+
+checkoutputs_status
+checkoutputs_is_spent(checkoutputs_handle* handle,
+                      const uint8_t* key_images,
+                      size_t no_of_key_images,
+                      uint8_t* spent)
+{
+    if (!handle || ((!key_images || !spent) && no_of_key_images > 0))
+    {
+        return CHECKOUTPUTS_INVALID_ARGUMENT;
+    }
+
+    try
+    {
+        Blockchain& core_storage = handle->mcore.get_core();
+
+        for (size_t i = 0; i < no_of_key_images; ++i)
+        {
+            crypto::key_image k_image = from_bytes<crypto::key_image>(
+                    key_images + i * CHECKOUTPUTS_KEY_SIZE);
+
+            spent[i] = core_storage.have_tx_keyimg_as_spent(k_image);
+        }
+
+        return CHECKOUTPUTS_OK;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << e.what() << endl;
+        return CHECKOUTPUTS_ERROR;
+    }
+}
+
+
+checkoutputs_status
+checkoutputs_find_spending_txs(checkoutputs_handle* handle,
+                               const uint8_t* key_images,
+                               size_t no_of_key_images,
+                               uint8_t* tx_hashes,
+                               uint8_t* found)
+{
+    if (!handle || ((!key_images || !tx_hashes || !found) && no_of_key_images > 0))
+    {
+        return CHECKOUTPUTS_INVALID_ARGUMENT;
+    }
+
+    static_assert(sizeof(crypto::key_image) == CHECKOUTPUTS_KEY_SIZE
+                  && sizeof(crypto::hash) == CHECKOUTPUTS_KEY_SIZE,
+                  "key images and hashes are not stored one after another");
+
+    try
+    {
+        // both are arrays of bytes, so buffers of the caller are
+        // used as they are, without copying key images or results.
+        // this function can run on many threads at once, so its
+        // scratch memory is the search's pool of waiters.
+        crypto::hash* hashes = reinterpret_cast<crypto::hash*>(tx_hashes);
+
+        bool complete = handle->search->find(
+                reinterpret_cast<const crypto::key_image*>(key_images),
+                no_of_key_images,
+                hashes);
+
+        for (size_t i = 0; i < no_of_key_images; ++i)
+        {
+            found[i] = hashes[i] != null_hash;
+        }
+
+        return complete ? CHECKOUTPUTS_OK : CHECKOUTPUTS_ERROR;
+    }
+    catch (const std::exception& e)
+    {
+        cerr << e.what() << endl;
+        return CHECKOUTPUTS_ERROR;
+    }
+}
@@ -0,0 +1,122 @@
+/*
+ * C interface of libcheckoutputs.so, for use of checkoutputs
+ * from other languages and programs without running it as a process.
+ *
+ * All keys, key images and hashes are 32 byte binary values.
+ * Results are written into buffers owned by the caller.
+ *
+ * A handle keeps the blockchain open and scratch memory reused by
+ * its calls. Calls on the same handle must not run concurrently,
+ * except checkoutputs_find_spending_txs, which can be called from
+ * many threads at once and then shares one blockchain pass.
+ */
+
+#ifndef XMREG01_CHECKOUTPUTS_H
+#define XMREG01_CHECKOUTPUTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CHECKOUTPUTS_KEY_SIZE 32
+
+typedef struct checkoutputs_handle checkoutputs_handle;
+
+typedef enum
+{
+    CHECKOUTPUTS_OK               = 0,
+    CHECKOUTPUTS_ERROR            = 1,
+    CHECKOUTPUTS_NOT_FOUND        = 2,
+    CHECKOUTPUTS_BUFFER_TOO_SMALL = 3,
+    CHECKOUTPUTS_INVALID_ARGUMENT = 4
+} checkoutputs_status;
+
+typedef struct
+{
+    uint64_t height;
+    uint64_t index_in_tx;
+    uint64_t amount;
+    uint8_t  pubkey[CHECKOUTPUTS_KEY_SIZE];
+} checkoutputs_output;
+
+
+/*
+ * Open lmdb blockchain in blockchain_path.
+ * Returns NULL on failure.
+ */
+checkoutputs_handle*
+checkoutputs_open(const char* blockchain_path);
+
+void
+checkoutputs_close(checkoutputs_handle* handle);
+
+checkoutputs_status
+checkoutputs_height(checkoutputs_handle* handle, uint64_t* height);
+
+/*
+ * Find outputs in tx_hash which belong to the address with
+ * the given private view key and public spend key.
+ *
+ * Up to capacity outputs are written to outputs, and their total
+ * number to no_of_outputs. If it is larger than capacity,
+ * CHECKOUTPUTS_BUFFER_TOO_SMALL is returned.
+ */
+checkoutputs_status
+checkoutputs_find_our_outputs(checkoutputs_handle* handle,
+                              const uint8_t* tx_hash,
+                              const uint8_t* private_view_key,
+                              const uint8_t* public_spend_key,
+                              checkoutputs_output* outputs,
+                              size_t capacity,
+                              size_t* no_of_outputs);
+
+/*
+ * Generate key image of output output_index of tx_hash.
+ */
+checkoutputs_status
+checkoutputs_generate_key_image(checkoutputs_handle* handle,
+                                const uint8_t* tx_hash,
+                                uint64_t output_index,
+                                const uint8_t* private_view_key,
+                                const uint8_t* private_spend_key,
+                                const uint8_t* public_spend_key,
+                                uint8_t* key_image);
+
+/*
+ * For each of no_of_key_images key images, stored one after
+ * another in key_images, set spent[i] to 1 if it is in the
+ * blockchain, 0 otherwise.
+ */
+checkoutputs_status
+checkoutputs_is_spent(checkoutputs_handle* handle,
+                      const uint8_t* key_images,
+                      size_t no_of_key_images,
+                      uint8_t* spent);
+
+/*
+ * Find txs spending the given key images in one blockchain pass.
+ *
+ * tx_hashes must have space for no_of_key_images hashes. found[i]
+ * is set to 1 if tx with key image i was found, and then its hash is
+ * i-th hash in tx_hashes. CHECKOUTPUTS_ERROR is returned if not all
+ * txs could be checked, e.g., one of them could not be parsed.
+ *
+ * Waiting key images are kept in memory of the handle, which grows
+ * to the most key images searched for at a time and is then reused,
+ * so after the first calls this function does not allocate.
+ */
+checkoutputs_status
+checkoutputs_find_spending_txs(checkoutputs_handle* handle,
+                               const uint8_t* key_images,
+                               size_t no_of_key_images,
+                               uint8_t* tx_hashes,
+                               uint8_t* found);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XMREG01_CHECKOUTPUTS_H */
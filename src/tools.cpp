@@ -344,4 +344,201 @@ namespace xmreg
 
 
 
+    /**
+     * Read-only streambuf over memory we dont own.
+     *
+     * binary_archive seeks to the end of its stream to find
+     * its size, so seeking must be supported.
+     */
+    class view_streambuf : public std::streambuf
+    {
+    public:
+        explicit view_streambuf(const blob_view& blob)
+        {
+            char* p = const_cast<char*>(blob.data);
+            setg(p, p, p + blob.size);
+        }
+
+        size_t
+        pos() const { return gptr() - eback(); }
+
+    protected:
+        pos_type
+        seekoff(off_type off, std::ios_base::seekdir dir,
+                std::ios_base::openmode which = std::ios_base::in) override
+        {
+            char* new_pos;
+
+            if (dir == std::ios_base::beg)
+                new_pos = eback() + off;
+            else if (dir == std::ios_base::cur)
+                new_pos = gptr() + off;
+            else
+                new_pos = egptr() + off;
+
+            if (!(which & std::ios_base::in)
+                || new_pos < eback() || new_pos > egptr())
+            {
+                return pos_type(off_type(-1));
+            }
+
+            setg(eback(), new_pos, egptr());
+
+            return pos_type(new_pos - eback());
+        }
+
+        pos_type
+        seekpos(pos_type pos,
+                std::ios_base::openmode which = std::ios_base::in) override
+        {
+            return seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+    };
+
+
+    /**
+     * Parse block straight from the memory pointed by blob,
+     * without copying it into blobdata first.
+     *
+     * If miner_tx_blob is given, it is set to the part of the
+     * blob holding the coinbase transaction.
+     */
+    bool
+    parse_block_from_view(const blob_view& blob,
+                          block& blk,
+                          blob_view* miner_tx_blob)
+    {
+        view_streambuf buf {blob};
+        std::istream is {&buf};
+
+        binary_archive<false> ar {is};
+
+        // same fields, in the same order, as in block::do_serialize
+        if (!::do_serialize(ar, static_cast<block_header&>(blk)))
+        {
+            return false;
+        }
+
+        size_t miner_tx_start = buf.pos();
+
+        if (!::do_serialize(ar, blk.miner_tx))
+        {
+            return false;
+        }
+
+        if (miner_tx_blob)
+        {
+            *miner_tx_blob = blob_view {blob.data + miner_tx_start,
+                                        buf.pos() - miner_tx_start};
+        }
+
+        if (!::do_serialize(ar, blk.tx_hashes))
+        {
+            return false;
+        }
+
+        return ::serialization::check_stream_state(ar);
+    }
+
+
+    bool
+    parse_tx_from_view(const blob_view& blob, transaction& tx)
+    {
+        view_streambuf buf {blob};
+        std::istream is {&buf};
+
+        binary_archive<false> ar {is};
+
+        return ::serialization::serialize(ar, tx);
+    }
+
+
+    /**
+     * Parse only the prefix of a transaction, i.e., its inputs,
+     * outputs and extra, skipping ring signatures.
+     *
+     * This is all what ownership and key image scans need, and
+     * signatures make up most of a tx's size.
+     *
+     * Signatures are left unread, so the stream is only checked
+     * for errors, not for being at its end, as serialize() does.
+     */
+    bool
+    parse_tx_prefix_from_view(const blob_view& blob, transaction_prefix& tx_prefix)
+    {
+        view_streambuf buf {blob};
+        std::istream is {&buf};
+
+        binary_archive<false> ar {is};
+
+        if (!::do_serialize(ar, tx_prefix))
+        {
+            return false;
+        }
+
+        return ar.stream().good();
+    }
+
+
+    /**
+     * Hash of a transaction is just hash of its blob
+     */
+    crypto::hash
+    get_tx_hash_from_view(const blob_view& blob)
+    {
+        return crypto::cn_fast_hash(blob.data, blob.size);
+    }
+
+
+    /**
+     * Read varint as tools::read_varint does into uint64_t,
+     * without a stream, and advance pos past it.
+     *
+     * Fails on overflow, end of data, or non-canonical
+     * encoding, i.e., with trailing zero bytes.
+     */
+    bool
+    read_varint(const uint8_t*& pos, const uint8_t* end, uint64_t& value)
+    {
+        value = 0;
+
+        for (int shift = 0; pos < end; shift += 7)
+        {
+            uint8_t byte = *pos++;
+
+            if (shift + 7 >= 64 && byte >= (1 << (64 - shift)))
+            {
+                return false;
+            }
+
+            if (byte == 0 && shift != 0)
+            {
+                return false;
+            }
+
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+
+            if (!(byte & 0x80))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+
+    // as tools::write_varint, appending to out
+    void
+    write_varint(string& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+
+        out.push_back(static_cast<char>(value));
+    }
+
 }
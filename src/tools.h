@@ -117,6 +117,46 @@ namespace xmreg
     }
 
 
+    /**
+     * Non-owning view of a serialized block or transaction,
+     * e.g., pointing directly into the lmdb memory map.
+     */
+    struct blob_view
+    {
+        const char* data {nullptr};
+        size_t size {0};
+
+        blob_view() = default;
+
+        blob_view(const char* _data, size_t _size)
+                : data {_data}, size {_size}
+        {}
+
+        blobdata
+        to_blobdata() const { return blobdata(data, size); }
+    };
+
+    bool
+    parse_block_from_view(const blob_view& blob,
+                          block& blk,
+                          blob_view* miner_tx_blob = nullptr);
+
+    bool
+    parse_tx_from_view(const blob_view& blob, transaction& tx);
+
+    bool
+    parse_tx_prefix_from_view(const blob_view& blob, transaction_prefix& tx_prefix);
+
+    crypto::hash
+    get_tx_hash_from_view(const blob_view& blob);
+
+    bool
+    read_varint(const uint8_t*& pos, const uint8_t* end, uint64_t& value);
+
+    void
+    write_varint(string& out, uint64_t value);
+
+
     /* generate a random 32-byte (256-bit) integer and copy it to res */
     static inline void random_scalar(ec_scalar &res) {
         unsigned char tmp[64];
@@ -56,7 +56,7 @@ namespace xmreg
 
 
         // get transaction's public key
-        public_key pub_tx_key = get_tx_pub_key_from_extra(tx);
+        public_key pub_tx_key = scan_tx_pub_key(tx.extra);
 
         // check if transaction has valid public key
         // if no, then skip
@@ -144,6 +144,76 @@ namespace xmreg
 
 
 
+    /**
+     * Same as get_belonging_outputs, but only with the
+     * tx public key and output keys, as kept in a scan sidecar.
+     *
+     * Returns indices of our outputs in the tx.
+     */
+    vector<size_t>
+    get_belonging_output_indices(const public_key& pub_tx_key,
+                                 const public_key* output_keys,
+                                 size_t no_of_outputs,
+                                 const secret_key& private_view_key,
+                                 const public_key& public_spend_key)
+    {
+        vector<size_t> our_outputs;
+
+        get_belonging_output_indices(pub_tx_key, output_keys, no_of_outputs,
+                                     private_view_key, public_spend_key,
+                                     our_outputs);
+
+        return our_outputs;
+    }
+
+
+    /**
+     * Same as above, but indices are written to our_indices,
+     * so that scans can reuse its memory between txs.
+     */
+    void
+    get_belonging_output_indices(const public_key& pub_tx_key,
+                                 const public_key* output_keys,
+                                 size_t no_of_outputs,
+                                 const secret_key& private_view_key,
+                                 const public_key& public_spend_key,
+                                 vector<size_t>& our_indices)
+    {
+        our_indices.clear();
+
+        if (pub_tx_key == null_pkey || no_of_outputs == 0)
+        {
+            return;
+        }
+
+        key_derivation derivation;
+
+        if (!generate_key_derivation(pub_tx_key, private_view_key, derivation))
+        {
+            cerr << "Cant get dervied key for: "  << "\n"
+                 << "pub_tx_key: " << pub_tx_key  << " and "
+                 << "prv_view_key" << private_view_key << endl;
+            return;
+        }
+
+        for (size_t i = 0; i < no_of_outputs; ++i)
+        {
+            public_key pubkey;
+
+            derive_public_key(derivation,
+                              i,
+                              public_spend_key,
+                              pubkey);
+
+            if (output_keys[i] == pubkey)
+            {
+                our_indices.push_back(i);
+            }
+        }
+    }
+
+
+
     /**
      * Check if given output (specified by output_index)
      * belongs is ours based
@@ -156,7 +226,7 @@ namespace xmreg
                    const public_key& public_spend_key)
     {
         // get transaction's public key
-        public_key pub_tx_key = get_tx_pub_key_from_extra(tx);
+        public_key pub_tx_key = scan_tx_pub_key(tx.extra);
 
         // check if transaction has valid public key
         // if no, then skip
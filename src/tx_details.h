@@ -11,6 +11,7 @@
 
 #include "monero_headers.h"
 #include "tools.h"
+#include "TxExtraScanner.h"
 
 namespace xmreg
 {
@@ -38,6 +39,20 @@ namespace xmreg
     operator<<(ostream& os, const transfer_details& dt);
 
 
+    /**
+     * Output found to be ours in a scan sidecar,
+     * so without the full tx it is in.
+     */
+    struct owned_output
+    {
+        uint64_t height;
+        crypto::hash tx_hash;
+        size_t index_in_tx;
+        uint64_t amount;
+        public_key pubkey;
+    };
+
+
     vector<xmreg::transfer_details>
     get_belonging_outputs(const block& blk,
                           const transaction& tx,
@@ -45,6 +60,21 @@ namespace xmreg
                           const public_key& public_spend_key,
                           uint64_t block_height = 0);
 
+    vector<size_t>
+    get_belonging_output_indices(const public_key& pub_tx_key,
+                                 const public_key* output_keys,
+                                 size_t no_of_outputs,
+                                 const secret_key& private_view_key,
+                                 const public_key& public_spend_key);
+
+    void
+    get_belonging_output_indices(const public_key& pub_tx_key,
+                                 const public_key* output_keys,
+                                 size_t no_of_outputs,
+                                 const secret_key& private_view_key,
+                                 const public_key& public_spend_key,
+                                 vector<size_t>& our_indices);
+
     bool
     is_output_ours(const size_t& output_index,
                    const transaction& tx,